@@ -0,0 +1,46 @@
+#ifndef __BENCHMARK_H__
+#define __BENCHMARK_H__ 1
+
+#include <chrono>
+#include <cstdint>
+
+namespace RR {
+namespace Benchmark {
+// Average milliseconds of one call of function over repetitions calls,
+// one untimed call first so caches and lazy allocations are warm
+template <typename F>
+double Measure(uint32_t repetitions, F function) {
+  function();
+
+  std::chrono::time_point<std::chrono::steady_clock> start =
+      std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < repetitions; i++) {
+    function();
+  }
+
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         repetitions;
+}
+
+// Milliseconds of a single call, for work that can't be repeated as is
+template <typename F>
+double MeasureOnce(F function) {
+  std::chrono::time_point<std::chrono::steady_clock> start =
+      std::chrono::steady_clock::now();
+  function();
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Every suite prints its own table, returns 0 on success
+int RunEcs();
+int RunTransforms();
+int RunSnapshot();
+int RunOcclusion();
+}
+}
+
+#endif  // !__BENCHMARK_H__
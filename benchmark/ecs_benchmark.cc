@@ -0,0 +1,133 @@
+#include <stdio.h>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "benchmark.h"
+#include "renderer/world.h"
+#include "renderer/common.hpp"
+#include "renderer/components/local_transform_component.h"
+#include "renderer/components/world_transform_component.h"
+#include "renderer/components/renderer_component.h"
+
+// Storage the world replaced, a list of shared entities each holding a
+// map of shared components
+struct LegacyEntity {
+  std::map<uint32_t, std::shared_ptr<RR::EntityComponent>> components;
+};
+
+typedef std::list<std::shared_ptr<LegacyEntity>> LegacyWorld;
+
+static const uint32_t kEntityCounts[] = {10000, 100000, 1000000};
+static const uint32_t kRendererEvery = 4;
+
+static uint32_t EntityComponents(uint32_t i) {
+  uint32_t components = RR::kComponentType_LocalTransform |
+                        RR::kComponentType_WorldTransform;
+  if (i % kRendererEvery == 0) {
+    components |= RR::kComponentType_Renderer;
+  }
+
+  return components;
+}
+
+static void CreateLegacy(uint32_t count, LegacyWorld* world) {
+  for (uint32_t i = 0; i < count; i++) {
+    std::shared_ptr<LegacyEntity> entity = std::make_shared<LegacyEntity>();
+    entity->components[RR::kComponentType_LocalTransform] =
+        std::make_shared<RR::LocalTransform>();
+    entity->components[RR::kComponentType_WorldTransform] =
+        std::make_shared<RR::WorldTransform>();
+    if (EntityComponents(i) & RR::kComponentType_Renderer) {
+      entity->components[RR::kComponentType_Renderer] =
+          std::make_shared<RR::RendererComponent>();
+    }
+
+    world->push_back(entity);
+  }
+}
+
+// Same work per entity on both layouts, what the transform and culling
+// passes read: the local position and the world translation
+static float WalkWorld(RR::World* world) {
+  float sum = 0.0f;
+  const std::vector<uint32_t>& matches = world->Query(
+      RR::LocalTransform::kType | RR::WorldTransform::kType);
+  for (size_t a = 0; a < matches.size(); a++) {
+    RR::Archetype& archetype = world->archetypes()[matches[a]];
+    std::vector<RR::LocalTransform>& locals =
+        archetype.Column<RR::LocalTransform>();
+    std::vector<RR::WorldTransform>& worlds =
+        archetype.Column<RR::WorldTransform>();
+
+    for (size_t row = 0; row < locals.size(); row++) {
+      sum += locals[row].position().x + worlds[row].world._41;
+    }
+  }
+
+  return sum;
+}
+
+static float WalkLegacy(LegacyWorld* world) {
+  float sum = 0.0f;
+  for (LegacyWorld::iterator i = world->begin(); i != world->end(); i++) {
+    std::map<uint32_t, std::shared_ptr<RR::EntityComponent>>& components =
+        (*i)->components;
+    std::map<uint32_t, std::shared_ptr<RR::EntityComponent>>::iterator local =
+        components.find(RR::kComponentType_LocalTransform);
+    std::map<uint32_t, std::shared_ptr<RR::EntityComponent>>::iterator world =
+        components.find(RR::kComponentType_WorldTransform);
+    if (local == components.end() || world == components.end()) {
+      continue;
+    }
+
+    sum += static_cast<RR::LocalTransform*>(local->second.get())->position().x +
+           static_cast<RR::WorldTransform*>(world->second.get())->world._41;
+  }
+
+  return sum;
+}
+
+int RR::Benchmark::RunEcs() {
+  printf("%10s %12s %14s %10s %12s %9s\n", "entities", "create ms",
+         "legacy create", "walk ms", "legacy walk", "speedup");
+
+  volatile float sink = 0.0f;
+  for (size_t c = 0; c < sizeof(kEntityCounts) / sizeof(kEntityCounts[0]);
+       c++) {
+    uint32_t count = kEntityCounts[c];
+    uint32_t repetitions = count >= 1000000 ? 5 : 20;
+
+    std::unique_ptr<World> world = std::make_unique<World>();
+    std::vector<Entity> entities;
+    double create = MeasureOnce([&world, &entities, count]() {
+      uint32_t with_renderer = (count + kRendererEvery - 1) / kRendererEvery;
+      world->CreateEntities(count - with_renderer,
+                            EntityComponents(1), &entities);
+      world->CreateEntities(with_renderer, EntityComponents(0), &entities);
+    });
+
+    if (world->EntityCount() != count) {
+      printf("created %u of %u entities\n", world->EntityCount(), count);
+      return 1;
+    }
+
+    LegacyWorld legacy;
+    double legacy_create =
+        MeasureOnce([&legacy, count]() { CreateLegacy(count, &legacy); });
+
+    double walk = Measure(repetitions, [&world, &sink]() {
+      sink = sink + WalkWorld(world.get());
+    });
+    double legacy_walk = Measure(repetitions, [&legacy, &sink]() {
+      sink = sink + WalkLegacy(&legacy);
+    });
+
+    printf("%10u %12.2f %14.2f %10.3f %12.3f %8.1fx\n", count, create,
+           legacy_create, walk, legacy_walk, legacy_walk / walk);
+  }
+
+  return 0;
+}
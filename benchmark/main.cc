@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "benchmark.h"
+
+struct Suite {
+  const char* name;
+  int (*run)();
+};
+
+static const Suite kSuites[] = {
+    {"ecs", RR::Benchmark::RunEcs},
+    {"transforms", RR::Benchmark::RunTransforms},
+    {"snapshot", RR::Benchmark::RunSnapshot},
+    {"occlusion", RR::Benchmark::RunOcclusion},
+};
+
+static const size_t kSuiteCount = sizeof(kSuites) / sizeof(kSuites[0]);
+
+// Runs the suites named in the arguments, every suite without arguments
+int main(int argc, char** argv) {
+  int failed = 0;
+  for (size_t i = 0; i < kSuiteCount; i++) {
+    bool selected = argc < 2;
+    for (int a = 1; a < argc && !selected; a++) {
+      selected = strcmp(argv[a], kSuites[i].name) == 0;
+    }
+
+    if (!selected) {
+      continue;
+    }
+
+    printf("\n== %s\n", kSuites[i].name);
+    if (kSuites[i].run() != 0) {
+      printf("%s failed\n", kSuites[i].name);
+      failed++;
+    }
+  }
+
+  return failed != 0 ? 1 : 0;
+}
@@ -0,0 +1,165 @@
+#include <stdio.h>
+
+#include <atomic>
+#include <random>
+#include <vector>
+
+#include "benchmark.h"
+#include "renderer/bounds.h"
+#include "renderer/occlusion_culler.h"
+#include "renderer/thread_pool.h"
+
+static const uint32_t kBoundsCounts[] = {10000, 100000, 1000000};
+static const uint32_t kBuildingCount = 12;
+static const uint32_t kRepetitions = 10;
+// Same chunk the renderer tests bounds in
+static const uint32_t kChunkSize = 256;
+
+// Unit cube, four floats per vertex to exercise the stride
+static const float kCubeVertices[] = {
+    -0.5f, -0.5f, -0.5f, 0.0f, 0.5f, -0.5f, -0.5f, 0.0f,
+    0.5f,  0.5f,  -0.5f, 0.0f, -0.5f, 0.5f, -0.5f, 0.0f,
+    -0.5f, -0.5f, 0.5f,  0.0f, 0.5f, -0.5f, 0.5f,  0.0f,
+    0.5f,  0.5f,  0.5f,  0.0f, -0.5f, 0.5f, 0.5f,  0.0f,
+};
+static const uint32_t kCubeIndices[] = {
+    0, 2, 1, 0, 3, 2, 4, 5, 6, 4, 6, 7, 0, 1, 5, 0, 5, 4,
+    3, 6, 2, 3, 7, 6, 0, 4, 7, 0, 7, 3, 1, 2, 6, 1, 6, 5,
+};
+static const uint32_t kCubeStride = 4;
+static const uint32_t kCubeVertexCount = 8;
+static const uint32_t kCubeIndexCount = 36;
+
+static DirectX::XMFLOAT4X4 BoxWorld(float x, float y, float z, float width,
+                                    float height, float depth) {
+  DirectX::XMFLOAT4X4 world;
+  DirectX::XMStoreFloat4x4(
+      &world,
+      DirectX::XMMatrixMultiply(DirectX::XMMatrixScaling(width, height, depth),
+                                DirectX::XMMatrixTranslation(x, y, z)));
+  return world;
+}
+
+// A street seen from one end, buildings on both sides and across the
+// far end hide most of the props scattered behind them
+static void BuildScene(uint32_t bounds_count,
+                       std::vector<DirectX::XMFLOAT4X4>* buildings,
+                       std::vector<RR::Bounds>* bounds) {
+  for (uint32_t i = 0; i < kBuildingCount / 2; i++) {
+    float z = 15.0f + i * 12.0f;
+    buildings->push_back(BoxWorld(-14.0f, 10.0f, z, 16.0f, 20.0f, 10.0f));
+    buildings->push_back(BoxWorld(14.0f, 10.0f, z, 16.0f, 20.0f, 10.0f));
+  }
+  buildings->back() = BoxWorld(0.0f, 10.0f, 90.0f, 60.0f, 20.0f, 4.0f);
+
+  std::mt19937 random(bounds_count);
+  std::uniform_real_distribution<float> x(-80.0f, 80.0f);
+  std::uniform_real_distribution<float> y(0.0f, 6.0f);
+  std::uniform_real_distribution<float> z(5.0f, 200.0f);
+  std::uniform_real_distribution<float> size(0.3f, 2.0f);
+
+  RR::Bounds cube =
+      RR::ComputeBounds(kCubeVertices, kCubeVertexCount, kCubeStride);
+  for (uint32_t i = 0; i < bounds_count; i++) {
+    float extent = size(random);
+    bounds->push_back(RR::TransformBounds(
+        cube, BoxWorld(x(random), y(random), z(random), extent, extent,
+                       extent)));
+  }
+}
+
+static void Rasterize(RR::OcclusionCuller* culler, RR::ThreadPool* pool,
+                      const DirectX::XMFLOAT4X4& view_projection,
+                      const std::vector<DirectX::XMFLOAT4X4>& buildings) {
+  culler->Begin(view_projection);
+  for (size_t i = 0; i < buildings.size(); i++) {
+    culler->AddOccluder(buildings[i], kCubeVertices, kCubeStride,
+                        kCubeVertexCount, kCubeIndices, kCubeIndexCount);
+  }
+  culler->Rasterize(pool);
+}
+
+static uint32_t TestSerial(const RR::OcclusionCuller& culler,
+                           const std::vector<RR::Bounds>& bounds,
+                           bool coarse) {
+  uint32_t hidden = 0;
+  for (size_t i = 0; i < bounds.size(); i++) {
+    hidden += culler.IsOccluded(bounds[i], coarse) ? 1 : 0;
+  }
+
+  return hidden;
+}
+
+int RR::Benchmark::RunOcclusion() {
+  ThreadPool pool;
+  pool.Init();
+
+  DirectX::XMMATRIX view = DirectX::XMMatrixLookToLH(
+      DirectX::XMVectorSet(0.0f, 2.0f, 0.0f, 1.0f),
+      DirectX::XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f),
+      DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+  DirectX::XMMATRIX projection = DirectX::XMMatrixPerspectiveFovLH(
+      1.0f, (float)OcclusionCuller::kWidth / OcclusionCuller::kHeight, 0.1f,
+      500.0f);
+  DirectX::XMFLOAT4X4 view_projection;
+  DirectX::XMStoreFloat4x4(&view_projection,
+                           DirectX::XMMatrixMultiply(view, projection));
+
+  printf("%u workers, %u building occluders\n", pool.thread_count(),
+         kBuildingCount);
+  printf("%10s %10s %10s %10s %12s %8s %8s\n", "bounds", "raster ms",
+         "full ms", "coarse ms", "parallel ms", "hidden", "coarse");
+
+  int result = 0;
+  for (size_t c = 0; c < sizeof(kBoundsCounts) / sizeof(kBoundsCounts[0]);
+       c++) {
+    uint32_t count = kBoundsCounts[c];
+
+    std::vector<DirectX::XMFLOAT4X4> buildings;
+    std::vector<Bounds> bounds;
+    BuildScene(count, &buildings, &bounds);
+
+    OcclusionCuller culler;
+    double raster = Measure(kRepetitions, [&]() {
+      Rasterize(&culler, &pool, view_projection, buildings);
+    });
+
+    uint32_t hidden = 0;
+    uint32_t coarse_hidden = 0;
+    double full = Measure(kRepetitions, [&]() {
+      hidden = TestSerial(culler, bounds, false);
+    });
+    double coarse = Measure(kRepetitions, [&]() {
+      coarse_hidden = TestSerial(culler, bounds, true);
+    });
+
+    std::atomic<uint32_t> parallel_hidden(0);
+    double parallel = Measure(kRepetitions, [&]() {
+      parallel_hidden = 0;
+      pool.ParallelFor(count, kChunkSize,
+                       [&](uint32_t begin, uint32_t end) {
+                         uint32_t chunk_hidden = 0;
+                         for (uint32_t i = begin; i < end; i++) {
+                           chunk_hidden += culler.IsOccluded(bounds[i]) ? 1 : 0;
+                         }
+                         parallel_hidden += chunk_hidden;
+                       });
+    });
+
+    printf("%10u %10.3f %10.3f %10.3f %12.3f %7.1f%% %7.1f%%\n", count,
+           raster, full, coarse, parallel, 100.0 * hidden / count,
+           100.0 * coarse_hidden / count);
+
+    // The tile level may only miss hidden bounds, never add some, and the
+    // threads have to agree with the serial test
+    if (coarse_hidden > hidden || parallel_hidden != hidden || hidden == 0) {
+      printf("inconsistent results, full %u coarse %u parallel %u\n", hidden,
+             coarse_hidden, parallel_hidden.load());
+      result = 1;
+      break;
+    }
+  }
+
+  pool.Release();
+  return result;
+}
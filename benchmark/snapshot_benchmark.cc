@@ -0,0 +1,231 @@
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "OpenFBX/ofbx.h"
+#include "renderer/world.h"
+#include "renderer/world_snapshot.h"
+#include "renderer/fbx_mesh.h"
+#include "renderer/common.hpp"
+#include "renderer/components/local_transform_component.h"
+
+// Same scene the project loads, relative to build/benchmark
+static const char* kSceneFile = "../../resources/Helmets.fbx";
+static const char* kSnapshotFile = "benchmark.rrws";
+static const uint32_t kRepetitions = 5;
+
+static const uint32_t kMeshComponents = RR::kComponentType_LocalTransform |
+                                        RR::kComponentType_WorldTransform |
+                                        RR::kComponentType_Renderer;
+
+struct LoadedMesh {
+  uint32_t geometry_type;
+  // One per material, like the geometries of a MeshData
+  std::vector<RR::GeometryData> geometries;
+  DirectX::XMFLOAT3 position;
+  DirectX::XMFLOAT3 rotation;
+  DirectX::XMFLOAT3 scale;
+};
+
+// CPU half of Renderer::LoadFBXScene: parsing plus the same vertex
+// expansion. Textures and the GPU upload are left out of both paths
+static int LoadFbx(const char* filename, std::vector<LoadedMesh>* meshes) {
+  FILE* file = fopen(filename, "rb");
+  if (!file) {
+    printf("couldn't open %s\n", filename);
+    return 1;
+  }
+
+  fseek(file, 0, SEEK_END);
+  long file_size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  std::vector<ofbx::u8> content(file_size);
+  fread(content.data(), 1, file_size, file);
+  fclose(file);
+
+  ofbx::IScene* scene = ofbx::load(content.data(), file_size,
+                                   (ofbx::u64)ofbx::LoadFlags::TRIANGULATE);
+  if (scene == nullptr) {
+    printf("couldn't parse %s\n", filename);
+    return 1;
+  }
+
+  std::vector<RR::FbxSubmesh> submeshes;
+  meshes->resize(scene->getMeshCount());
+  for (int i = 0; i < scene->getMeshCount(); i++) {
+    const ofbx::Mesh& mesh = *scene->getMesh(i);
+    LoadedMesh& loaded = (*meshes)[i];
+
+    submeshes.clear();
+    loaded.geometry_type =
+        RR::ExpandFbxGeometry(*mesh.getGeometry(), &submeshes);
+    for (size_t j = 0; j < submeshes.size(); j++) {
+      loaded.geometries.push_back(std::move(submeshes[j].data));
+    }
+
+    ofbx::Vec3 position = mesh.getLocalTranslation();
+    ofbx::Vec3 rotation = mesh.getLocalRotation();
+    ofbx::Vec3 scale = mesh.getLocalScaling();
+    loaded.position = DirectX::XMFLOAT3((float)position.x, (float)position.y,
+                                        (float)position.z);
+    loaded.rotation = DirectX::XMFLOAT3((float)rotation.x, (float)rotation.y,
+                                        (float)rotation.z);
+    loaded.scale =
+        DirectX::XMFLOAT3((float)scale.x, (float)scale.y, (float)scale.z);
+  }
+
+  scene->destroy();
+  return 0;
+}
+
+// What the project does with the meshes LoadFBXScene returns
+static int LoadFbxWorld(const char* filename, RR::World* world) {
+  std::vector<LoadedMesh> meshes;
+  if (LoadFbx(filename, &meshes) != 0) {
+    return 1;
+  }
+
+  std::vector<RR::Entity> entities;
+  world->CreateEntities(meshes.size(), kMeshComponents, &entities);
+  for (size_t i = 0; i < entities.size(); i++) {
+    RR::LocalTransform* transform =
+        world->GetComponent<RR::LocalTransform>(entities[i]);
+    transform->SetPosition(meshes[i].position);
+    transform->SetRotation(meshes[i].rotation);
+    transform->SetScale(meshes[i].scale);
+  }
+
+  return 0;
+}
+
+// CPU half of Renderer::LoadSnapshot, geometry is copied out of the
+// mapping the same way CreateGeometry receives it
+static int LoadSnapshotWorld(const char* filename, RR::World* world) {
+  RR::WorldSnapshot snapshot;
+  if (snapshot.Map(filename, kSceneFile) != 0) {
+    return 1;
+  }
+
+  const RR::WorldSnapshot::Header* header = snapshot.header();
+  std::vector<RR::GeometryData> geometries(header->geometry_count);
+  for (uint32_t i = 0; i < header->geometry_count; i++) {
+    const RR::WorldSnapshot::GeometryRecord& record = snapshot.geometries()[i];
+    geometries[i].vertex_data.assign(
+        record.vertices.data, record.vertices.data + record.vertex_count);
+    geometries[i].index_data.assign(
+        record.indices.data, record.indices.data + record.index_count);
+  }
+
+  const RR::WorldSnapshot::EntityRecord* records = snapshot.entities();
+  std::vector<RR::Entity> entities;
+  uint32_t first = 0;
+  while (first < header->entity_count) {
+    uint32_t last = first + 1;
+    while (last < header->entity_count &&
+           records[last].components == records[first].components) {
+      last++;
+    }
+
+    world->CreateEntities(last - first, records[first].components, &entities);
+    first = last;
+  }
+
+  for (uint32_t i = 0; i < entities.size(); i++) {
+    RR::LocalTransform* transform =
+        world->GetComponent<RR::LocalTransform>(entities[i]);
+    if (transform != nullptr) {
+      transform->SetPosition(records[i].position);
+      transform->SetQuaternion(records[i].rotation);
+      transform->SetScale(records[i].scale);
+    }
+
+    if (records[i].parent != -1) {
+      world->SetParent(entities[i], entities[records[i].parent]);
+    }
+  }
+
+  snapshot.Unmap();
+  return 0;
+}
+
+// Same scene as a snapshot, one entity per mesh and one slot per geometry
+static int WriteSnapshot(const char* filename,
+                         const std::vector<LoadedMesh>& meshes) {
+  std::vector<RR::WorldSnapshot::EntityRecord> entities(meshes.size());
+  std::vector<RR::WorldSnapshot::SlotRecord> slots;
+  std::vector<uint32_t> geometry_types;
+  std::vector<const RR::GeometryData*> geometry_data;
+
+  for (size_t i = 0; i < meshes.size(); i++) {
+    // Same quaternion LoadFbxWorld ends up with
+    RR::LocalTransform transform;
+    transform.SetRotation(meshes[i].rotation);
+
+    RR::WorldSnapshot::EntityRecord& entity = entities[i];
+    entity = {};
+    entity.components = kMeshComponents;
+    entity.parent = -1;
+    entity.pipeline_type = RR::kPipelineType_PBR;
+    entity.first_slot = slots.size();
+    entity.slot_count = meshes[i].geometries.size();
+    entity.position = meshes[i].position;
+    entity.rotation = transform.quaternion();
+    entity.scale = meshes[i].scale;
+
+    for (size_t j = 0; j < meshes[i].geometries.size(); j++) {
+      RR::WorldSnapshot::SlotRecord slot = {};
+      slot.geometry = geometry_data.size();
+      slot.textures.pbr_textures = {-1, -1, -1, -1, -1};
+      slots.push_back(slot);
+
+      geometry_types.push_back(meshes[i].geometry_type);
+      geometry_data.push_back(&meshes[i].geometries[j]);
+    }
+  }
+
+  return RR::WorldSnapshot::Write(filename, entities, slots, geometry_types,
+                                  geometry_data, std::vector<std::wstring>(),
+                                  kSceneFile);
+}
+
+int RR::Benchmark::RunSnapshot() {
+  std::vector<LoadedMesh> meshes;
+  if (LoadFbx(kSceneFile, &meshes) != 0 ||
+      WriteSnapshot(kSnapshotFile, meshes) != 0) {
+    return 1;
+  }
+
+  size_t vertex_floats = 0;
+  for (size_t i = 0; i < meshes.size(); i++) {
+    for (size_t j = 0; j < meshes[i].geometries.size(); j++) {
+      vertex_floats += meshes[i].geometries[j].vertex_data.size();
+    }
+  }
+  printf("%s: %u meshes, %.1f MB of vertices\n", kSceneFile,
+         (uint32_t)meshes.size(),
+         vertex_floats * sizeof(float) / (1024.0 * 1024.0));
+
+  // A new world per load, destroying it is part of both timings
+  int failed = 0;
+  double fbx = Measure(kRepetitions, [&failed]() {
+    std::unique_ptr<World> world = std::make_unique<World>();
+    failed |= LoadFbxWorld(kSceneFile, world.get());
+  });
+  double snapshot = Measure(kRepetitions, [&failed]() {
+    std::unique_ptr<World> world = std::make_unique<World>();
+    failed |= LoadSnapshotWorld(kSnapshotFile, world.get());
+  });
+
+  remove(kSnapshotFile);
+  if (failed != 0) {
+    return 1;
+  }
+
+  printf("%12s %14s %9s\n", "fbx ms", "snapshot ms", "speedup");
+  printf("%12.2f %14.2f %8.1fx\n", fbx, snapshot, fbx / snapshot);
+
+  return 0;
+}
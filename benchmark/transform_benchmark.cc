@@ -0,0 +1,215 @@
+#include <stdio.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "benchmark.h"
+#include "renderer/transform_kernel.h"
+
+static const uint32_t kTransformCounts[] = {1024, 16384, 262144};
+// Children share parents the way props share a level in the hierarchy
+static const uint32_t kChildrenPerParent = 8;
+
+// One hierarchy level with its parent level already built. Rotations are
+// kept both as the euler angles the renderer used to apply and as the
+// quaternions the kernel reads
+struct TransformLevel {
+  std::vector<float> position_x;
+  std::vector<float> position_y;
+  std::vector<float> position_z;
+  std::vector<float> euler_x;
+  std::vector<float> euler_y;
+  std::vector<float> euler_z;
+  std::vector<float> rotation_x;
+  std::vector<float> rotation_y;
+  std::vector<float> rotation_z;
+  std::vector<float> rotation_w;
+  std::vector<float> scale_x;
+  std::vector<float> scale_y;
+  std::vector<float> scale_z;
+  std::vector<uint8_t> dirty;
+  std::vector<uint32_t> parents;
+  std::vector<DirectX::XMFLOAT4X4> parent_worlds;
+  std::vector<DirectX::XMFLOAT4X4> worlds;
+
+  RR::TransformStreams Streams() {
+    RR::TransformStreams streams;
+    streams.position_x = position_x.data();
+    streams.position_y = position_y.data();
+    streams.position_z = position_z.data();
+    streams.rotation_x = rotation_x.data();
+    streams.rotation_y = rotation_y.data();
+    streams.rotation_z = rotation_z.data();
+    streams.rotation_w = rotation_w.data();
+    streams.scale_x = scale_x.data();
+    streams.scale_y = scale_y.data();
+    streams.scale_z = scale_z.data();
+    streams.dirty = dirty.data();
+    streams.parents = parents.data();
+    streams.parent_worlds = parent_worlds.data();
+    streams.worlds = worlds.data();
+    return streams;
+  }
+};
+
+static void BuildLevel(uint32_t count, TransformLevel* level) {
+  std::mt19937 random(count);
+  std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+  std::uniform_real_distribution<float> angle(-DirectX::XM_PI, DirectX::XM_PI);
+  std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+  for (uint32_t i = 0; i < count; i++) {
+    level->position_x.push_back(position(random));
+    level->position_y.push_back(position(random));
+    level->position_z.push_back(position(random));
+    level->euler_x.push_back(angle(random));
+    level->euler_y.push_back(angle(random));
+    level->euler_z.push_back(angle(random));
+    level->scale_x.push_back(scale(random));
+    level->scale_y.push_back(scale(random));
+    level->scale_z.push_back(scale(random));
+
+    // Same x then y then z order as LocalTransform::SetRotation
+    DirectX::XMVECTOR x = DirectX::XMQuaternionRotationNormal(
+        DirectX::XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), level->euler_x[i]);
+    DirectX::XMVECTOR y = DirectX::XMQuaternionRotationNormal(
+        DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), level->euler_y[i]);
+    DirectX::XMVECTOR z = DirectX::XMQuaternionRotationNormal(
+        DirectX::XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), level->euler_z[i]);
+    DirectX::XMVECTOR rotation =
+        DirectX::XMQuaternionMultiply(DirectX::XMQuaternionMultiply(x, y), z);
+    DirectX::XMFLOAT4 quaternion;
+    DirectX::XMStoreFloat4(&quaternion, rotation);
+    level->rotation_x.push_back(quaternion.x);
+    level->rotation_y.push_back(quaternion.y);
+    level->rotation_z.push_back(quaternion.z);
+    level->rotation_w.push_back(quaternion.w);
+
+    level->dirty.push_back(1);
+    level->parents.push_back(i / kChildrenPerParent);
+  }
+
+  uint32_t parent_count =
+      (count + kChildrenPerParent - 1) / kChildrenPerParent;
+  for (uint32_t i = 0; i < parent_count; i++) {
+    DirectX::XMFLOAT4X4 parent;
+    DirectX::XMStoreFloat4x4(
+        &parent,
+        DirectX::XMMatrixMultiply(
+            DirectX::XMMatrixRotationY(angle(random)),
+            DirectX::XMMatrixTranslation(position(random), position(random),
+                                         position(random))));
+    level->parent_worlds.push_back(parent);
+  }
+
+  level->worlds.resize(count);
+}
+
+// What every entity paid before the kernel, one matrix per step
+static void ComputeEuler(TransformLevel* level) {
+  for (size_t i = 0; i < level->worlds.size(); i++) {
+    DirectX::XMMATRIX world = DirectX::XMMatrixScaling(
+        level->scale_x[i], level->scale_y[i], level->scale_z[i]);
+    world = DirectX::XMMatrixMultiply(
+        world, DirectX::XMMatrixRotationX(level->euler_x[i]));
+    world = DirectX::XMMatrixMultiply(
+        world, DirectX::XMMatrixRotationY(level->euler_y[i]));
+    world = DirectX::XMMatrixMultiply(
+        world, DirectX::XMMatrixRotationZ(level->euler_z[i]));
+    world = DirectX::XMMatrixMultiply(
+        world,
+        DirectX::XMMatrixTranslation(level->position_x[i],
+                                     level->position_y[i],
+                                     level->position_z[i]));
+    world = DirectX::XMMatrixMultiply(
+        world, DirectX::XMLoadFloat4x4(
+                   &level->parent_worlds[level->parents[i]]));
+    DirectX::XMStoreFloat4x4(&level->worlds[i], world);
+  }
+}
+
+// Same per entity path with the quaternion the kernel reads
+static void ComputeQuaternion(TransformLevel* level) {
+  for (size_t i = 0; i < level->worlds.size(); i++) {
+    DirectX::XMMATRIX world = DirectX::XMMatrixScaling(
+        level->scale_x[i], level->scale_y[i], level->scale_z[i]);
+    world = DirectX::XMMatrixMultiply(
+        world, DirectX::XMMatrixRotationQuaternion(DirectX::XMVectorSet(
+                   level->rotation_x[i], level->rotation_y[i],
+                   level->rotation_z[i], level->rotation_w[i])));
+    world = DirectX::XMMatrixMultiply(
+        world,
+        DirectX::XMMatrixTranslation(level->position_x[i],
+                                     level->position_y[i],
+                                     level->position_z[i]));
+    world = DirectX::XMMatrixMultiply(
+        world, DirectX::XMLoadFloat4x4(
+                   &level->parent_worlds[level->parents[i]]));
+    DirectX::XMStoreFloat4x4(&level->worlds[i], world);
+  }
+}
+
+static float MaxError(const std::vector<DirectX::XMFLOAT4X4>& a,
+                      const std::vector<DirectX::XMFLOAT4X4>& b) {
+  float error = 0.0f;
+  for (size_t i = 0; i < a.size(); i++) {
+    for (uint32_t r = 0; r < 4; r++) {
+      for (uint32_t c = 0; c < 4; c++) {
+        float difference = std::fabs(a[i].m[r][c] - b[i].m[r][c]) /
+                           (1.0f + std::fabs(b[i].m[r][c]));
+        error = difference > error ? difference : error;
+      }
+    }
+  }
+
+  return error;
+}
+
+int RR::Benchmark::RunTransforms() {
+  printf("kernel width %u, every transform dirty with a parent\n",
+         TransformKernelWidth());
+  printf("%10s %12s %12s %12s %12s %9s\n", "transforms", "euler ms",
+         "quat ms", "scalar ms", "kernel ms", "speedup");
+
+  for (size_t c = 0;
+       c < sizeof(kTransformCounts) / sizeof(kTransformCounts[0]); c++) {
+    uint32_t count = kTransformCounts[c];
+    uint32_t repetitions = 4194304 / count;
+
+    TransformLevel level;
+    BuildLevel(count, &level);
+    TransformStreams streams = level.Streams();
+
+    double euler =
+        Measure(repetitions, [&level]() { ComputeEuler(&level); });
+    std::vector<DirectX::XMFLOAT4X4> reference = level.worlds;
+
+    double quaternion =
+        Measure(repetitions, [&level]() { ComputeQuaternion(&level); });
+    float quaternion_error = MaxError(level.worlds, reference);
+
+    double scalar = Measure(repetitions, [&streams, count]() {
+      ComputeWorldMatricesScalar(streams, 0, count);
+    });
+    float scalar_error = MaxError(level.worlds, reference);
+
+    double kernel = Measure(repetitions, [&streams, count]() {
+      ComputeWorldMatrices(streams, 0, count);
+    });
+    float kernel_error = MaxError(level.worlds, reference);
+
+    printf("%10u %12.3f %12.3f %12.3f %12.3f %8.1fx\n", count, euler,
+           quaternion, scalar, kernel, euler / kernel);
+
+    // Every path has to build the same matrices
+    if (quaternion_error > 1e-4f || scalar_error > 1e-4f ||
+        kernel_error > 1e-4f) {
+      printf("results differ, quat %g scalar %g kernel %g\n",
+             quaternion_error, scalar_error, kernel_error);
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -84,3 +84,74 @@ solution "GraduationProject"
 	configuration "Shipping"
 	    targetdir "bin/project/shipping"
  	    kind "WindowedApp"
+
+    -- Console runs of the engine systems that need no GPU, see benchmark/
+    project "Benchmark"
+		location "build/benchmark"
+		kind "ConsoleApp"
+		objdir "build/benchmark/obj"
+
+		files {
+			"benchmark/**.cc",
+			"benchmark/**.h",
+			"src/renderer/archetype.cc",
+			"src/renderer/bounds.cc",
+			"src/renderer/fbx_mesh.cc",
+			"src/renderer/logger.cc",
+			"src/renderer/occlusion_culler.cc",
+			"src/renderer/thread_pool.cc",
+			"src/renderer/transform_hierarchy.cc",
+			"src/renderer/transform_kernel.cc",
+			"src/renderer/world.cc",
+			"src/renderer/world_snapshot.cc",
+			"src/renderer/components/camera_component.cc",
+			"src/renderer/components/local_transform_component.cc",
+			"src/renderer/components/world_transform_component.cc",
+			"deps/src/Minitrace/minitrace.c",
+			"deps/src/OpenFBX/miniz.c",
+			"deps/src/OpenFBX/ofbx.cpp",
+		}
+
+		includedirs {
+			"include",
+			"deps/include"
+		}
+
+	configuration "Debug"
+	    targetdir "bin/benchmark/debug"
+
+	configuration "Release"
+	    targetdir "bin/benchmark/release"
+
+	configuration "Shipping"
+	    targetdir "bin/benchmark/shipping"
+
+    -- Unit tests of the engine code that needs no GPU, see tests/
+    project "Tests"
+		location "build/tests"
+		kind "ConsoleApp"
+		objdir "build/tests/obj"
+
+		files {
+			"tests/**.cc",
+			"tests/**.h",
+			"src/renderer/bounding_volume_hierarchy.cc",
+			"src/renderer/bounds.cc",
+			"src/renderer/descriptor_allocator.cc",
+			"src/renderer/frustum_culling.cc",
+			"src/renderer/transform_kernel.cc",
+		}
+
+		includedirs {
+			"include",
+			"deps/include"
+		}
+
+	configuration "Debug"
+	    targetdir "bin/tests/debug"
+
+	configuration "Release"
+	    targetdir "bin/tests/release"
+
+	configuration "Shipping"
+	    targetdir "bin/tests/shipping"
@@ -0,0 +1,86 @@
+#ifndef __ARCHETYPE_H__
+#define __ARCHETYPE_H__ 1
+
+#include <cstdint>
+#include <vector>
+
+#include "renderer/entity.h"
+#include "renderer/components/camera_component.h"
+#include "renderer/components/renderer_component.h"
+#include "renderer/components/local_transform_component.h"
+#include "renderer/components/world_transform_component.h"
+
+namespace RR {
+class EntityComponent;
+
+// Every entity with the exact same component mask lives in the same
+// archetype, each component type is packed in its own array so systems
+// can walk them linearly. Row i of every array belongs to entities[i]
+class Archetype {
+ public:
+  Archetype(uint32_t components);
+  ~Archetype() = default;
+
+  uint32_t components() const;
+  uint32_t size() const;
+
+  void Reserve(uint32_t count);
+  uint32_t Add(Entity entity);
+
+  // Swap removes the row, returns the entity that was moved into it
+  // or kInvalidEntity if the row was the last one
+  Entity Remove(uint32_t row);
+
+  // Moves the shared components of the row to destination, returns
+  // the row in destination. The row is not removed from this archetype
+  uint32_t CopyTo(uint32_t row, Archetype* destination);
+
+  EntityComponent* Component(uint32_t component_type, uint32_t row);
+
+  // Typed access, T is one of the component classes
+  template <typename T>
+  std::vector<T>& Column();
+  template <typename T>
+  T* Get(uint32_t row);
+
+  std::vector<Entity> entities;
+  std::vector<LocalTransform> local_transforms;
+  std::vector<WorldTransform> world_transforms;
+  std::vector<RendererComponent> renderers;
+  std::vector<Camera> cameras;
+
+ private:
+  uint32_t _components = 0U;
+};
+
+template <>
+inline std::vector<LocalTransform>& Archetype::Column<LocalTransform>() {
+  return local_transforms;
+}
+
+template <>
+inline std::vector<WorldTransform>& Archetype::Column<WorldTransform>() {
+  return world_transforms;
+}
+
+template <>
+inline std::vector<RendererComponent>& Archetype::Column<RendererComponent>() {
+  return renderers;
+}
+
+template <>
+inline std::vector<Camera>& Archetype::Column<Camera>() {
+  return cameras;
+}
+
+template <typename T>
+inline T* Archetype::Get(uint32_t row) {
+  if ((_components & T::kType) == 0 || row >= entities.size()) {
+    return nullptr;
+  }
+
+  return &Column<T>()[row];
+}
+}
+
+#endif  // !__ARCHETYPE_H__
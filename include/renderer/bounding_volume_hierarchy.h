@@ -0,0 +1,100 @@
+#ifndef __BOUNDING_VOLUME_HIERARCHY_H__
+#define __BOUNDING_VOLUME_HIERARCHY_H__ 1
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "renderer/bounds.h"
+#include "renderer/entity.h"
+
+namespace RR {
+struct Frustum;
+
+// Dynamic AABB tree over entity world bounds. Leaves store the bounds
+// enlarged by a margin, moving inside it doesn't touch the tree. When a
+// leaf leaves its box it is reinserted and only its ancestors are refit
+// and rebalanced. Queries reject whole subtrees and test the exact
+// bounds at the leaves
+class BoundingVolumeHierarchy {
+ public:
+  BoundingVolumeHierarchy() = default;
+
+  BoundingVolumeHierarchy(const BoundingVolumeHierarchy&) = delete;
+  BoundingVolumeHierarchy(BoundingVolumeHierarchy&&) = delete;
+
+  void operator=(const BoundingVolumeHierarchy&) = delete;
+  void operator=(BoundingVolumeHierarchy&&) = delete;
+
+  ~BoundingVolumeHierarchy() = default;
+
+  // Inserts entity or moves it to its new bounds, empty bounds remove it.
+  // Returns true when the tree structure changed
+  bool Update(Entity entity, const Bounds& bounds);
+  void Remove(Entity entity);
+  void Clear();
+  bool Contains(Entity entity) const;
+
+  // Queries append the matching entities
+  void QueryFrustum(const Frustum& frustum,
+                    std::vector<Entity>* entities) const;
+  // direction doesn't need to be normalized, max_distance is measured in
+  // direction lengths
+  void QueryRay(const DirectX::XMFLOAT3& origin,
+                const DirectX::XMFLOAT3& direction, float max_distance,
+                std::vector<Entity>* entities) const;
+  void QuerySphere(const DirectX::XMFLOAT3& center, float radius,
+                   std::vector<Entity>* entities) const;
+
+  uint32_t size() const;
+  // Longest path from the root to a leaf, 0 when empty
+  uint32_t height() const;
+
+  // Checks the parent links and heights of every node, that each box
+  // encloses its children and that every leaf is findable. For tests
+  bool Validate() const;
+
+ private:
+  static const int32_t kNullNode = -1;
+  // Fraction of the extents leaves are enlarged by
+  static const float kMargin;
+
+  struct Node {
+    // Enlarged box for leaves, union of the children otherwise
+    DirectX::XMFLOAT3 min;
+    DirectX::XMFLOAT3 max;
+    // Exact bounds, only leaves
+    DirectX::XMFLOAT3 tight_min;
+    DirectX::XMFLOAT3 tight_max;
+    // Next free node while in the free list
+    int32_t parent;
+    int32_t left;
+    int32_t right;
+    // Leaves are 0, -1 while free
+    int32_t height;
+    Entity entity;
+  };
+
+  std::vector<Node> _nodes;
+  int32_t _root = kNullNode;
+  int32_t _free_nodes = kNullNode;
+  // Leaf of every entity, indexed by EntityIndex()
+  std::vector<int32_t> _leaves;
+  uint32_t _leaf_count = 0U;
+
+  int32_t AllocateNode();
+  void FreeNode(int32_t node);
+  int32_t FindLeaf(Entity entity) const;
+  void InsertLeaf(int32_t leaf);
+  void RemoveLeaf(int32_t leaf);
+  // Fixes boxes and heights from node up to the root
+  void Refit(int32_t node);
+  // AVL rotation when the children heights differ by more than one,
+  // returns the node now at the position of node
+  int32_t Balance(int32_t node);
+  void AppendSubtree(int32_t node, std::vector<Entity>* entities) const;
+};
+}
+
+#endif  // !__BOUNDING_VOLUME_HIERARCHY_H__
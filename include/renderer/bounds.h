@@ -0,0 +1,32 @@
+#ifndef __BOUNDS_H__
+#define __BOUNDS_H__ 1
+
+#include <DirectXMath.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace RR {
+// Axis aligned box plus a sphere enclosing the same points. Empty bounds
+// have min above max and a negative radius
+struct Bounds {
+  DirectX::XMFLOAT3 min;
+  DirectX::XMFLOAT3 max;
+  DirectX::XMFLOAT3 center;
+  float radius;
+};
+
+Bounds EmptyBounds();
+bool IsEmpty(const Bounds& bounds);
+
+// Bounds of interleaved vertex data whose first three floats are the
+// position, stride is the vertex size in floats
+Bounds ComputeBounds(const float* vertex_data, size_t vertex_count,
+                     uint32_t stride);
+Bounds MergeBounds(const Bounds& a, const Bounds& b);
+// world is an affine row vector matrix, like WorldTransform::world
+Bounds TransformBounds(const Bounds& bounds,
+                       const DirectX::XMFLOAT4X4& world);
+}
+
+#endif  // !__BOUNDS_H__
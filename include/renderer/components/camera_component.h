@@ -7,11 +7,12 @@
 #include "renderer/components/entity_component.h"
 
 namespace RR {
-class Entity;
 class EntityComponent;
 
 class Camera : public EntityComponent {
  public:
+  static const uint32_t kType = kComponentType_Camera;
+
   Camera();
   ~Camera() = default;
 
@@ -2,6 +2,9 @@
 #define __ENTITY_COMPONENT_H__ 1
 
 namespace RR {
+// Base of every component. Each derived component declares
+// static const uint32_t kType with its ComponentTypes bit so typed
+// accessors resolve it at compile time
 class EntityComponent {};
 }
 
@@ -1,31 +1,49 @@
 #ifndef __LOCAL_TRANSFORM_COMPONENT_H__
 #define __LOCAL_TRANSFORM_COMPONENT_H__ 1
 
-#include <memory>
-
 #include "renderer/common.hpp"
+#include "renderer/entity.h"
 #include "renderer/components/entity_component.h"
 
 namespace RR {
-class Entity;
 class EntityComponent;
 
 class LocalTransform : public EntityComponent {
  public:
+  static const uint32_t kType = kComponentType_LocalTransform;
+
   LocalTransform();
   ~LocalTransform() = default;
 
-  void SetParent(std::shared_ptr<Entity> parent);
-
-  DirectX::XMFLOAT3 position;
-  DirectX::XMFLOAT3 rotation;
-  DirectX::XMFLOAT3 scale;
+  const DirectX::XMFLOAT3& position() const;
+  // Euler angles in degrees, applied x then y then z. Kept for the editor,
+  // derived from the quaternion when it was set directly
+  const DirectX::XMFLOAT3& rotation() const;
+  const DirectX::XMFLOAT4& quaternion() const;
+  const DirectX::XMFLOAT3& scale() const;
+
+  // Setters flag the transform so its world matrix gets rebuilt,
+  // untouched transforms are skipped by the renderer
+  void SetPosition(const DirectX::XMFLOAT3& position);
+  void SetRotation(const DirectX::XMFLOAT3& rotation);
+  // Stored normalized so accumulated rotations don't drift
+  void SetQuaternion(const DirectX::XMFLOAT4& quaternion);
+  void SetScale(const DirectX::XMFLOAT3& scale);
 
   friend class Renderer;
   friend class Editor;
+  friend class World;
  private:
-  uint32_t level;
-  std::shared_ptr<Entity> parent;
+  DirectX::XMFLOAT3 _position;
+  DirectX::XMFLOAT4 _quaternion;
+  DirectX::XMFLOAT3 _scale;
+
+  mutable DirectX::XMFLOAT3 _rotation;
+  mutable bool _rotation_outdated = false;
+
+  Entity parent;
+
+  bool _dirty = true;
 };
 }
 
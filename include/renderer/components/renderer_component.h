@@ -5,49 +5,68 @@
 
 #include "renderer/common.hpp"
 #include "renderer/components/entity_component.h"
-
-struct ID3D12Resource;
-struct ID3D12DescriptorHeap;
-struct ID3D12Device;
-struct D3D12_GPU_DESCRIPTOR_HANDLE;
+#include "renderer/material_registry.h"
 
 namespace RR {
-namespace GFX {
-class Texture;
-}
-
-struct MVPStruct {
-  DirectX::XMFLOAT4X4 model;
-  DirectX::XMFLOAT4X4 view;
-  DirectX::XMFLOAT4X4 projection;
-};
-
 class Renderer;
 class RendererComponent : public EntityComponent {
  public:
+  static const uint32_t kType = kComponentType_Renderer;
+
   RendererComponent() = default;
   ~RendererComponent() = default;
 
-  void Init(const Renderer* renderer, uint32_t pipeline_type, uint32_t geometries);
+  void Init(uint32_t pipeline_type, uint32_t geometries);
+  // Gives the materials of every geometry back to the registry
+  void Release();
+
+  uint32_t pipeline_type() const;
+  // Registry handle of the material of geometry, kInvalidMaterial until
+  // the geometry is first drawn
+  MaterialHandle material(uint32_t geometry) const;
+
+  const std::vector<int32_t>& geometries() const;
+  // Invalidates the world bounds so they are rebuilt around the new
+  // geometry, slots past the ones given to Init are ignored
+  void SetGeometry(uint32_t slot, int32_t geometry);
 
-  // This is dangerous, client can resize
-  std::vector<int32_t> geometries;
   std::vector<MaterialSettings> settings;
   std::vector<TextureSettings> textureSettings;
+  // Rasterized into the occlusion buffer to hide what is behind it, keep
+  // it for a few large, simple meshes
+  bool occluder = false;
  private:
   uint32_t _pipeline_type = 0U;
   bool _initialized = false;
 
-  ID3D12Resource* _mvp_constant_buffers;
-  ID3D12Resource* _material_constant_buffers;
-  std::vector<ID3D12DescriptorHeap*> _srv_descriptor_heaps;
-  
-  void SetMVP(const MVPStruct& mvp);
-  void Update(ID3D12Device* device, std::vector<GFX::Texture>& textures, uint32_t geometry);
+  std::vector<int32_t> _geometries;
+
+  // Material of every geometry slot as last resolved, the handle shares
+  // its GPU constants and descriptors with every equal material
+  struct MaterialState {
+    MaterialSettings settings;
+    TextureSettings textures;
+    MaterialHandle handle;
+  };
+  std::vector<MaterialState> _materials;
+  MaterialRegistry* _material_registry = nullptr;
+
+  // WorldTransform version the world bounds were built for
+  uint32_t _bounds_version = 0U;
+
+  // Occlusion history, the last frame the component was tested, the
+  // bounds and culler versions of its last full test and the last result
+  uint32_t _occlusion_frame = 0U;
+  uint32_t _occlusion_bounds_version = 0U;
+  uint32_t _occlusion_culler_version = 0U;
+  bool _occluded = false;
 
-  uint64_t MVPConstantBufferView(); 
-  uint64_t MaterialConstantBufferView();
-  ID3D12DescriptorHeap* SRVDescriptorHeap(uint32_t index);
+  // Resolves the material handle of geometry again when its settings
+  // changed since the last call, unchanged materials cost a compare.
+  // Returns 0 on success
+  int Update(MaterialRegistry* registry,
+             const std::vector<uint32_t>& texture_descriptors,
+             uint32_t geometry);
 
   friend class Renderer;
   friend class Editor;
@@ -3,15 +3,17 @@
 
 #include <memory>
 
+#include "renderer/bounds.h"
 #include "renderer/common.hpp"
 #include "renderer/components/entity_component.h"
 
 namespace RR {
-class Entity;
 class EntityComponent;
 
 class WorldTransform : public EntityComponent {
  public:
+  static const uint32_t kType = kComponentType_WorldTransform;
+
   WorldTransform();
   ~WorldTransform() = default;
 
@@ -20,6 +22,15 @@ class WorldTransform : public EntityComponent {
   DirectX::XMFLOAT3 up();
 
   DirectX::XMFLOAT4X4 world;
+  // World space bounds of the renderer component geometries, empty for
+  // entities without one. Refreshed by the renderer when world changes
+  Bounds bounds;
+
+  friend class Renderer;
+  friend class World;
+ private:
+  // Bumped every time world is rebuilt
+  uint32_t _version = 1U;
 };
 }  // namespace RR
 
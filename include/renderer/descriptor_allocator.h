@@ -0,0 +1,46 @@
+#ifndef __DESCRIPTOR_ALLOCATOR_H__
+#define __DESCRIPTOR_ALLOCATOR_H__ 1
+
+#include <cstdint>
+#include <map>
+
+namespace RR {
+// Hands out ranges of consecutive slots of a fixed size descriptor heap.
+// Free ranges are kept sorted by first slot, allocation takes the first
+// range big enough and freed ranges merge with their neighbours. Only
+// deals with indices, the owner maps them to its GPU heap
+class DescriptorAllocator {
+ public:
+  static const uint32_t kInvalidDescriptor = 0xFFFFFFFF;
+
+  DescriptorAllocator() = default;
+
+  DescriptorAllocator(const DescriptorAllocator&) = delete;
+  DescriptorAllocator(DescriptorAllocator&&) = delete;
+
+  void operator=(const DescriptorAllocator&) = delete;
+  void operator=(DescriptorAllocator&&) = delete;
+
+  ~DescriptorAllocator() = default;
+
+  void Init(uint32_t capacity);
+
+  // Returns the first slot of count free slots, kInvalidDescriptor if no
+  // free range is big enough
+  uint32_t Allocate(uint32_t count = 1);
+  // first and count must match an allocation
+  void Free(uint32_t first, uint32_t count = 1);
+
+  uint32_t capacity() const;
+  // Slots handed out and not freed
+  uint32_t allocated() const;
+
+ private:
+  uint32_t _capacity = 0U;
+  uint32_t _allocated = 0U;
+  // First slot to slot count of every free range
+  std::map<uint32_t, uint32_t> _free_ranges;
+};
+}
+
+#endif  // !__DESCRIPTOR_ALLOCATOR_H__
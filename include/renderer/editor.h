@@ -6,12 +6,12 @@
 #include <memory>
 #include <map>
 
-
-
+#include "renderer/entity.h"
 
 namespace RR {
-class Entity;
+class World;
 class Renderer;
+class OcclusionCuller;
 
 namespace GFX {
 class Texture;
@@ -26,13 +26,16 @@ class Editor {
 
   void Init() {};
 
-  void ShowEditor(std::list<std::shared_ptr<RR::Entity>>* entities,
+  void ShowEditor(RR::World* world,
                   std::map<uint32_t, GFX::Pipeline>* pipelines,
                   const std::vector<GFX::Geometry>* geometries,
-                  const std::vector<GFX::Texture>* textures);
+                  const std::vector<GFX::Texture>* textures,
+                  OcclusionCuller* occlusion_culler);
 
  private:
-  std::shared_ptr<RR::Entity> _selected_entity = nullptr;;
+  RR::Entity _selected_entity = kInvalidEntity;
+  // Occlusion buffer view, farthest depth per tile or every pixel
+  bool _show_occlusion_pixels = false;
 };
 }
 
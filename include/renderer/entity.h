@@ -1,33 +1,39 @@
 #ifndef __ENTITY_H__
 #define __ENTITY_H__ 1
 
-#include <map>
-#include <memory>
+#include <cstdint>
 
 namespace RR {
-class EntityComponent;
-class Renderer;
-
-class Entity {
- public:  
-  Entity() = default;
-  Entity(uint32_t components);
-
-  Entity(Entity&&) = delete;
-  void operator=(Entity&&) = delete;
-
-  void AddComponents(uint32_t components);
-  std::shared_ptr<EntityComponent> GetComponent(uint32_t component_type) const;
-
-
-  ~Entity() = default;
+// Entities are plain handles, their components live inside the world
+// archetypes, see: renderer/world.h
+//
+// The low bits index the world entity records, the high bits store the
+// generation of that record so handles to destroyed entities are detected
+typedef uint32_t Entity;
+
+static const uint32_t kEntityIndexBits = 22U;
+static const uint32_t kEntityIndexMask = (1U << kEntityIndexBits) - 1U;
+static const uint32_t kEntityGenerationMask = (1U << (32U - kEntityIndexBits)) - 1U;
+static const uint32_t kMaxEntities = kEntityIndexMask;
+
+static const Entity kInvalidEntity = 0xFFFFFFFF;
+
+// Never given to a live entity, marks handles returned by an
+// EntityCommandBuffer that are only resolved when it is played back
+static const uint32_t kPendingEntityGeneration = kEntityGenerationMask;
+
+inline uint32_t EntityIndex(Entity entity) {
+  return entity & kEntityIndexMask;
+}
 
-  friend class Renderer;
-  friend class LocalTransform;
+inline uint32_t EntityGeneration(Entity entity) {
+  return entity >> kEntityIndexBits;
+}
 
- private:
-  std::map<uint32_t, std::shared_ptr<EntityComponent>> _components;
-};
+inline Entity MakeEntity(uint32_t index, uint32_t generation) {
+  return (generation & kEntityGenerationMask) << kEntityIndexBits |
+         (index & kEntityIndexMask);
+}
 }
 
 #endif  // !__ENTITY_H__
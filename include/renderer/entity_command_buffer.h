@@ -0,0 +1,68 @@
+#ifndef __ENTITY_COMMAND_BUFFER_H__
+#define __ENTITY_COMMAND_BUFFER_H__ 1
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "renderer/entity.h"
+
+namespace RR {
+class Renderer;
+
+// Records structural changes so they can be requested while systems
+// iterate the world, from the client update or from worker threads.
+// Nothing touches the world until Playback, which the renderer calls
+// once per frame after the client update
+class EntityCommandBuffer {
+ public:
+  EntityCommandBuffer() = default;
+
+  EntityCommandBuffer(const EntityCommandBuffer&) = delete;
+  EntityCommandBuffer(EntityCommandBuffer&&) = delete;
+
+  void operator=(const EntityCommandBuffer&) = delete;
+  void operator=(EntityCommandBuffer&&) = delete;
+
+  ~EntityCommandBuffer() = default;
+
+  // The returned handle can only be used in later commands of this
+  // buffer, it becomes a real entity on playback
+  Entity CreateEntity(uint32_t component_types);
+  void DestroyEntity(Entity entity);
+  void AddComponents(Entity entity, uint32_t component_types);
+  void SetParent(Entity entity, Entity parent);
+
+  // Applies and clears every recorded command. They are sorted so the
+  // result doesn't depend on which thread recorded first: creations in
+  // recording order, then component additions, parenting and finally
+  // destructions, each group ordered by entity
+  void Playback(Renderer* renderer);
+
+  uint32_t size();
+
+ private:
+  enum CommandType : uint32_t {
+    kCommandType_Create = 0U,
+    kCommandType_AddComponents = 1U,
+    kCommandType_SetParent = 2U,
+    kCommandType_Destroy = 3U,
+  };
+
+  struct Command {
+    uint32_t type;
+    uint32_t sequence;
+    Entity entity;
+    // Component mask or parent entity
+    uint32_t argument;
+  };
+
+  std::mutex _mutex;
+  std::vector<Command> _commands;
+  uint32_t _pending_entities = 0U;
+
+  void Push(uint32_t type, Entity entity, uint32_t argument);
+};
+}
+
+#endif  // !__ENTITY_COMMAND_BUFFER_H__
@@ -0,0 +1,28 @@
+#ifndef __FBX_MESH_H__
+#define __FBX_MESH_H__ 1
+
+#include <cstdint>
+#include <vector>
+
+#include "renderer/common.hpp"
+
+namespace ofbx {
+struct Geometry;
+}
+
+namespace RR {
+// Triangles of an FBX geometry that share one material
+struct FbxSubmesh {
+  int32_t material;
+  GeometryData data;
+};
+
+// Expands the FBX geometry into unindexed interleaved vertices, one
+// submesh per run of triangles with the same material. Tangents are
+// generated per triangle when the file has uvs but no tangents. Returns
+// the geometry type every submesh is laid out as
+uint32_t ExpandFbxGeometry(const ofbx::Geometry& geometry,
+                           std::vector<FbxSubmesh>* submeshes);
+}
+
+#endif  // !__FBX_MESH_H__
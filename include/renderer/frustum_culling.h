@@ -0,0 +1,41 @@
+#ifndef __FRUSTUM_CULLING_H__
+#define __FRUSTUM_CULLING_H__ 1
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+
+namespace RR {
+// Normalized planes with the normal pointing inside, a point p is inside
+// a plane when dot(plane.xyz, p) + plane.w >= 0
+struct Frustum {
+  DirectX::XMFLOAT4 planes[6];
+};
+
+// Structure of arrays boxes, one entry per box. Boxes with negative
+// extents are always culled
+struct BoxStreams {
+  const float* center_x;
+  const float* center_y;
+  const float* center_z;
+  const float* extent_x;
+  const float* extent_y;
+  const float* extent_z;
+};
+
+// view_projection is a row vector matrix with a [0, 1] depth range, as
+// built by XMMatrixPerspectiveFovLH
+Frustum ExtractFrustum(const DirectX::XMFLOAT4X4& view_projection);
+
+// Writes the index of every box in [begin, end) that touches the frustum
+// to visible, in order, and returns how many were written. visible must
+// have room for end - begin indices. Tests 8 (AVX2) or 4 (SSE) boxes at
+// once when the cpu supports them
+uint32_t CullBoxes(const Frustum& frustum, const BoxStreams& boxes,
+                   uint32_t begin, uint32_t end, uint32_t* visible);
+
+uint32_t CullBoxesScalar(const Frustum& frustum, const BoxStreams& boxes,
+                         uint32_t begin, uint32_t end, uint32_t* visible);
+}
+
+#endif  // !__FRUSTUM_CULLING_H__
@@ -0,0 +1,67 @@
+#ifndef __CONSTANT_POOL_H__
+#define __CONSTANT_POOL_H__ 1
+
+#include <cstdint>
+#include <vector>
+
+struct ID3D12Device;
+struct ID3D12Resource;
+
+namespace RR {
+namespace GFX {
+// Long lived constant buffer blocks of one size inside persistently mapped
+// upload pages. Pages are never moved or shrunk, freed blocks are reused.
+// The pool doesn't track the GPU, blocks must only be written or freed
+// once no frame in flight reads them
+class ConstantPool {
+ public:
+  // Constant buffer views must start at 256 bytes
+  static const uint32_t kAlignment = 256;
+  static const uint32_t kInvalidBlock = 0xFFFFFFFF;
+
+  ConstantPool() = default;
+
+  ConstantPool(const ConstantPool&) = delete;
+  ConstantPool(ConstantPool&&) = delete;
+
+  void operator=(const ConstantPool&) = delete;
+  void operator=(ConstantPool&&) = delete;
+
+  ~ConstantPool();
+
+  // block_size is rounded up to kAlignment
+  int Init(ID3D12Device* device, uint32_t block_size,
+           uint32_t blocks_per_page);
+  void Release();
+
+  // Returns kInvalidBlock if a new page couldn't be created
+  uint32_t Allocate();
+  void Free(uint32_t block);
+
+  void* Data(uint32_t block) const;
+  uint64_t GPUAddress(uint32_t block) const;
+
+  uint32_t block_size() const;
+  // Blocks handed out and not freed
+  uint32_t allocated() const;
+
+ private:
+  struct Page {
+    ID3D12Resource* resource;
+    uint8_t* data;
+    uint64_t gpu_address;
+  };
+
+  int AddPage();
+
+  ID3D12Device* _device = nullptr;
+  uint32_t _block_size = 0U;
+  uint32_t _blocks_per_page = 0U;
+  uint32_t _allocated = 0U;
+  std::vector<Page> _pages;
+  std::vector<uint32_t> _free_blocks;
+};
+}
+}
+
+#endif  // !__CONSTANT_POOL_H__
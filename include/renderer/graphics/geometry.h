@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <memory>
 
+#include "renderer/bounds.h"
 #include "renderer/graphics/graphic_resource.h"
 
 struct ID3D12Device;
@@ -25,9 +26,12 @@ class Geometry : public GraphicResource {
   uint32_t Type() const;
   const D3D12_VERTEX_BUFFER_VIEW* VertexView() const;
   const D3D12_INDEX_BUFFER_VIEW* IndexView() const;
+  // Local space bounds of the vertices, computed by Init
+  const Bounds& bounds() const;
 
+  // Copies data, the caller keeps it
   int Init(ID3D12Device* device, uint32_t geometry_type,
-           std::unique_ptr<GeometryData>&& data);
+           const GeometryData& data);
   int Update(ID3D12GraphicsCommandList* command_list);
 
   void Release() override;
@@ -35,6 +39,7 @@ class Geometry : public GraphicResource {
  private:
   uint32_t _type = 0U;
   uint32_t _indices = 0U;
+  Bounds _bounds = EmptyBounds();
   std::unique_ptr<GeometryData> _new_data = nullptr;
 
   ID3D12Resource* _vertex_default_buffer = nullptr;
@@ -1,6 +1,8 @@
 #ifndef __PIPELINE_H__
 #define __PIPELINE_H__ 1
 
+#include <DirectXMath.h>
+
 #include <cstdint>
 
 #include "renderer/graphics/graphic_resource.h"
@@ -11,12 +13,20 @@ struct ID3D12Device;
 
 namespace RR {
 namespace GFX {
+// Constant buffer b0 of every pipeline, written once per frame. Matrices
+// are stored transposed for HLSL column major packing
+struct FrameConstants {
+  DirectX::XMFLOAT4X4 view;
+  DirectX::XMFLOAT4X4 projection;
+  DirectX::XMFLOAT4X4 view_projection;
+  DirectX::XMFLOAT3 camera_position;
+  float pad0;
+};
+
 struct PBRConstants {
   float elapsed_time;
   float ambient_intensity;
   float pad0[2];
-  float camera_position[3];
-  float pad1;
   float directional_light_position[3];
 };
 
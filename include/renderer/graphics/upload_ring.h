@@ -0,0 +1,60 @@
+#ifndef __UPLOAD_RING_H__
+#define __UPLOAD_RING_H__ 1
+
+#include <cstdint>
+#include <vector>
+
+struct ID3D12Device;
+struct ID3D12Resource;
+
+namespace RR {
+namespace GFX {
+// Persistently mapped upload buffer for the data of one frame in flight.
+// Allocations are 256 byte aligned slices taken with a bump pointer and
+// stay valid until Reset, which must wait for the frame fence. When full
+// a buffer twice as big takes over and the old one is kept until Reset
+class UploadRing {
+ public:
+  // Constant buffer views must start at 256 bytes
+  static const uint64_t kAlignment = 256;
+
+  UploadRing() = default;
+
+  UploadRing(const UploadRing&) = delete;
+  UploadRing(UploadRing&&) = delete;
+
+  void operator=(const UploadRing&) = delete;
+  void operator=(UploadRing&&) = delete;
+
+  ~UploadRing();
+
+  int Init(ID3D12Device* device, uint64_t size);
+  void Release();
+
+  // Returns where to write size bytes and their GPU address, nullptr if
+  // a new buffer couldn't be created
+  void* Allocate(uint64_t size, uint64_t* gpu_address);
+  // Every allocation is given back, call once the GPU is done with them
+  void Reset();
+
+  // Bytes allocated since the last Reset
+  uint64_t used() const;
+  uint64_t size() const;
+
+ private:
+  int CreateBuffer(uint64_t size);
+
+  ID3D12Device* _device = nullptr;
+  ID3D12Resource* _buffer = nullptr;
+  uint8_t* _data = nullptr;
+  uint64_t _gpu_address = 0U;
+  uint64_t _size = 0U;
+  uint64_t _offset = 0U;
+  uint64_t _used = 0U;
+  // Outgrown buffers the frame may still read from
+  std::vector<ID3D12Resource*> _retired;
+};
+}
+}
+
+#endif  // !__UPLOAD_RING_H__
@@ -0,0 +1,108 @@
+#ifndef __MATERIAL_REGISTRY_H__
+#define __MATERIAL_REGISTRY_H__ 1
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "renderer/common.hpp"
+#include "renderer/descriptor_allocator.h"
+
+struct ID3D12Device;
+
+namespace RR {
+namespace GFX {
+class ConstantPool;
+}
+
+// Materials are plain handles into the MaterialRegistry
+typedef uint32_t MaterialHandle;
+
+static const MaterialHandle kInvalidMaterial = 0xFFFFFFFF;
+
+// True once texture has a view in the global SRV heap, see
+// Renderer::LoadTexture
+inline bool HasTextureDescriptor(
+    int32_t texture, const std::vector<uint32_t>& texture_descriptors) {
+  return texture >= 0 && texture < (int32_t)texture_descriptors.size() &&
+         texture_descriptors[texture] !=
+             DescriptorAllocator::kInvalidDescriptor;
+}
+
+// Unique materials of every renderer component. Equal pipeline type,
+// settings and textures resolve to the same reference counted handle,
+// which owns one constant block with a copy per frame in flight. PBR
+// constants carry the bindless descriptor index of each texture.
+// Unreferenced materials are freed once the frame that released them is
+// recorded again
+class MaterialRegistry {
+ public:
+  static const uint32_t kMaxMaterials = 4096;
+
+  MaterialRegistry() = default;
+
+  MaterialRegistry(const MaterialRegistry&) = delete;
+  MaterialRegistry(MaterialRegistry&&) = delete;
+
+  void operator=(const MaterialRegistry&) = delete;
+  void operator=(MaterialRegistry&&) = delete;
+
+  ~MaterialRegistry();
+
+  int Init(ID3D12Device* device, uint16_t frame_count);
+  void Release();
+
+  // Frees the materials released the last time frame was recorded, call
+  // once its fence has retired and before recording it again
+  void BeginFrame(uint16_t frame);
+
+  // Returns the handle of an equal material, or creates it. Textures are
+  // resolved through texture_descriptors, their index in the global SRV
+  // heap. Textures without one point at slot 0 and must have their flag
+  // cleared in settings. Returns kInvalidMaterial when the registry is full
+  MaterialHandle Acquire(uint32_t pipeline_type,
+                         const MaterialSettings& settings,
+                         const TextureSettings& texture_settings,
+                         const std::vector<uint32_t>& texture_descriptors);
+  void Release(MaterialHandle handle);
+
+  // Writes the constant copy of frame if the material is newer
+  void Update(MaterialHandle handle, uint16_t frame);
+  uint64_t ConstantBufferView(MaterialHandle handle, uint16_t frame) const;
+
+  // Materials with references
+  uint32_t material_count() const;
+
+ private:
+  struct Material {
+    uint64_t hash;
+    uint32_t pipeline_type;
+    MaterialSettings settings;
+    TextureSettings texture_settings;
+    // Global SRV heap index of every PBR texture, pbr.frag.hlsl order
+    uint32_t texture_descriptors[5];
+    uint32_t references;
+    uint32_t constant_block;
+    // Frame copies of the constants still holding older settings
+    uint32_t stale_frames;
+    // Frame whose retired list frees the material, -1 while referenced
+    int32_t retired_frame;
+  };
+
+  ID3D12Device* _device = nullptr;
+  uint16_t _frame_count = 0;
+  uint16_t _frame = 0;
+  uint32_t _material_count = 0U;
+
+  std::unique_ptr<GFX::ConstantPool> _constants;
+  std::vector<Material> _materials;
+  std::vector<MaterialHandle> _free_handles;
+  // Content hash to handle, several materials can share a hash
+  std::multimap<uint64_t, MaterialHandle> _lookup;
+  // Unreferenced materials per frame, waiting for its fence
+  std::vector<std::vector<MaterialHandle>> _retired;
+};
+}
+
+#endif  // !__MATERIAL_REGISTRY_H__
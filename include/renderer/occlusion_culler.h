@@ -0,0 +1,102 @@
+#ifndef __OCCLUSION_CULLER_H__
+#define __OCCLUSION_CULLER_H__ 1
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "renderer/bounds.h"
+
+namespace RR {
+class ThreadPool;
+
+// Software occlusion culling. Every frame a few occluder meshes are
+// rasterized into a small depth buffer, split in rows of tiles across the
+// worker threads, and the farthest depth of each tile is kept as a
+// coarser level. Bounds are tested against the tiles first and only
+// against the pixels of tiles that can't reject them
+class OcclusionCuller {
+ public:
+  static const uint32_t kWidth = 320;
+  static const uint32_t kHeight = 192;
+  static const uint32_t kTileSize = 8;
+  static const uint32_t kTilesX = kWidth / kTileSize;
+  static const uint32_t kTilesY = kHeight / kTileSize;
+
+  bool enabled = true;
+  // Frames between two full tests of one renderer while the camera and
+  // the occluders hold still. In between renderers hidden last frame stay
+  // hidden and visible ones only get the tile test. Renderers are spread
+  // over the frames, 1 tests all every frame
+  uint32_t retest_interval = 4;
+
+  OcclusionCuller();
+
+  OcclusionCuller(const OcclusionCuller&) = delete;
+  OcclusionCuller(OcclusionCuller&&) = delete;
+
+  void operator=(const OcclusionCuller&) = delete;
+  void operator=(OcclusionCuller&&) = delete;
+
+  ~OcclusionCuller() = default;
+
+  // Clears the depth buffer and drops the queued occluders.
+  // view_projection is a row vector matrix with a [0, 1] depth range
+  void Begin(const DirectX::XMFLOAT4X4& view_projection);
+  // Queues the triangles of an occluder mesh, stride is the vertex size
+  // in floats and the position the first three floats of each vertex
+  void AddOccluder(const DirectX::XMFLOAT4X4& world, const float* vertex_data,
+                   uint32_t stride, uint32_t vertex_count,
+                   const uint32_t* indices, uint32_t index_count);
+  // Rasterizes the queued occluders and builds the tile level
+  void Rasterize(ThreadPool* thread_pool);
+  // True when bounds are completely behind the rasterized occluders.
+  // coarse only looks at the tile level, it misses some hidden bounds but
+  // is much cheaper. Safe to call from several threads after Rasterize
+  bool IsOccluded(const Bounds& bounds, bool coarse = false) const;
+
+  uint32_t triangle_count() const;
+  // Bumped by Rasterize whenever the view projection or the occluder
+  // triangles differ from the previous call, results tested against an
+  // older version can't be reused
+  uint32_t version() const;
+  // kWidth * kHeight depths, row major from the top left pixel
+  const float* depth() const;
+  // Farthest depth of every tile, kTilesX * kTilesY
+  const float* tile_depth() const;
+
+ private:
+  // Screen space triangle, edge i is opposite vertex i. Edge functions
+  // are positive inside and depth is a plane over the screen
+  struct Triangle {
+    float edge_a[3];
+    float edge_b[3];
+    float edge_c[3];
+    float depth_a;
+    float depth_b;
+    float depth_c;
+    int32_t min_x;
+    int32_t max_x;
+    int32_t min_y;
+    int32_t max_y;
+  };
+
+  DirectX::XMFLOAT4X4 _view_projection;
+  std::vector<Triangle> _triangles;
+  std::vector<DirectX::XMFLOAT4> _clip_vertices;
+  std::vector<float> _depth;
+  std::vector<float> _tile_depth;
+
+  // What the last version rasterized, to detect changes
+  DirectX::XMFLOAT4X4 _previous_view_projection;
+  std::vector<Triangle> _previous_triangles;
+  uint32_t _version = 0U;
+
+  void AddTriangle(const DirectX::XMFLOAT4 clip[3]);
+  void AddScreenTriangle(const DirectX::XMFLOAT4 clip[3]);
+  void RasterizeRows(uint32_t first_row, uint32_t last_row);
+};
+}
+
+#endif  // !__OCCLUSION_CULLER_H__
@@ -0,0 +1,53 @@
+#ifndef __PREFAB_H__
+#define __PREFAB_H__ 1
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "renderer/common.hpp"
+#include "renderer/entity.h"
+#include "renderer/components/camera_component.h"
+
+namespace RR {
+class World;
+
+// Copy of the component data of an entity subtree, instantiated with
+// Renderer::Instantiate. Geometries and textures are stored by index so
+// every instance shares them
+class Prefab {
+ public:
+  // Nodes are stored parents first
+  struct Node {
+    uint32_t components;
+    // Index of the parent node, -1 for the root
+    int32_t parent;
+
+    DirectX::XMFLOAT3 position;
+    DirectX::XMFLOAT4 rotation;
+    DirectX::XMFLOAT3 scale;
+
+    Camera camera;
+
+    uint32_t pipeline_type;
+    std::vector<int32_t> geometries;
+    std::vector<MaterialSettings> settings;
+    std::vector<TextureSettings> texture_settings;
+    bool occluder;
+  };
+
+  Prefab() = default;
+  ~Prefab() = default;
+
+  // Captures root and all its descendants, returns 0 on success
+  int Capture(World* world, Entity root);
+
+  const std::vector<Node>& nodes() const;
+
+ private:
+  std::vector<Node> _nodes;
+};
+}
+
+#endif  // !__PREFAB_H__
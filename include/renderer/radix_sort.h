@@ -0,0 +1,42 @@
+#ifndef __RADIX_SORT_H__
+#define __RADIX_SORT_H__ 1
+
+#include <cstdint>
+#include <vector>
+
+namespace RR {
+class ThreadPool;
+
+// Stable LSD radix sort of 64 bit keys, one byte per pass. Every pass
+// counts digits per chunk and scatters the chunks in parallel, bytes all
+// keys share are skipped. Scratch memory is kept between sorts
+class RadixSorter {
+ public:
+  static const uint32_t kChunkSize = 4096;
+
+  RadixSorter() = default;
+
+  RadixSorter(const RadixSorter&) = delete;
+  RadixSorter(RadixSorter&&) = delete;
+
+  void operator=(const RadixSorter&) = delete;
+  void operator=(RadixSorter&&) = delete;
+
+  ~RadixSorter() = default;
+
+  // Sorts keys ascending, values[i] follows keys[i]. Both must have the
+  // same size
+  void Sort(ThreadPool* thread_pool, std::vector<uint64_t>* keys,
+            std::vector<uint32_t>* values);
+
+ private:
+  std::vector<uint64_t> _scratch_keys;
+  std::vector<uint32_t> _scratch_values;
+  // 256 counters per chunk, turned into scatter offsets
+  std::vector<uint32_t> _histograms;
+  // Bits where a chunk differs from the first key
+  std::vector<uint64_t> _chunk_bits;
+};
+}
+
+#endif  // !__RADIX_SORT_H__
@@ -6,9 +6,12 @@
 #include <map>
 #include <list>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "common.hpp"
+#include "renderer/entity.h"
+#include "renderer/thread_pool.h"
 
 struct ID3D12Device;
 struct IDXGISwapChain3;
@@ -30,15 +33,28 @@ struct ID3D12DebugDevice;
 
 namespace RR {
 class Window;
-class Entity;
+class World;
+class EntityCommandBuffer;
+class Prefab;
+class LocalTransform;
 class Camera;
+class RendererComponent;
 class Input;
 struct GeometryData;
 class Editor;
+class Archetype;
+class BoundingVolumeHierarchy;
+class OcclusionCuller;
+class RadixSorter;
+class MaterialRegistry;
+class DescriptorAllocator;
+class WorldTransform;
+struct Frustum;
 namespace GFX {
 class Texture;
 class Pipeline;
 class Geometry;
+class UploadRing;
 }
 
 class Renderer {
@@ -56,18 +72,61 @@ class Renderer {
 
   ~Renderer();
 
-  int Init(void* user_data, void (*update)(void*));
+  // worker_threads sizes the pool used to split per frame work, the
+  // default leaves one hardware thread for the main thread
+  int Init(void* user_data, void (*update)(void*),
+           uint32_t worker_threads = ThreadPool::kDefaultThreadCount);
   void Start();
   void Stop();
   void Resize();
 
   bool initialized() const;
 
-  std::shared_ptr<Entity> MainCamera() const;
-  std::shared_ptr<Entity> RegisterEntity(uint32_t component_types);
+  World* world() const;
+  // Structural changes recorded here are applied after the client update,
+  // safe to use from worker threads and while iterating the world
+  EntityCommandBuffer* commands() const;
+  ThreadPool* thread_pool() const;
+  // World bounds of every drawable entity, for frustum, ray and sphere
+  // queries. Kept in sync after the transform update of every frame
+  const BoundingVolumeHierarchy* spatial_index() const;
+  // Software depth buffer visible renderers are tested against after
+  // frustum culling. Renderers flagged as occluder are rasterized into it
+  OcclusionCuller* occlusion_culler() const;
+  Entity MainCamera() const;
+  Entity RegisterEntity(uint32_t component_types);
+  // Creates count entities with the same components at once. With a
+  // renderer component and a pipeline type, entity i gets
+  // geometry_counts[i] geometries. Their GPU materials are shared with
+  // every equal material through the material registry
+  std::vector<Entity> RegisterEntities(
+      uint32_t count, uint32_t component_types,
+      uint32_t pipeline_type = kPipelineType_None,
+      const uint32_t* geometry_counts = nullptr);
+  // The only way to destroy an entity. Its renderer materials are
+  // released once the frame it was destroyed in is no longer in flight
+  void DestroyEntity(Entity entity);
+  // Spawns count copies of prefab, returns their roots. transforms
+  // overrides the root local transform of each copy when not null.
+  // Every prefab node is created as one batch under the copies of its
+  // parent and its components are range copied into the new rows
+  std::vector<Entity> Instantiate(const Prefab& prefab, uint32_t count,
+                                  const LocalTransform* transforms = nullptr);
   int32_t CreateGeometry(uint32_t geometry_type, std::unique_ptr<GeometryData>&& data);
   int32_t LoadTexture(const wchar_t* file_name);
   std::shared_ptr<std::vector<MeshData>> LoadFBXScene(const char* filename);
+  // Writes every entity with its components, hierarchy, geometries and
+  // texture names to a WorldSnapshot file, returns 0 on success. The
+  // snapshot is stamped with source_filename when the world was imported
+  // from it
+  int SaveSnapshot(const char* filename,
+                   const char* source_filename = nullptr);
+  // Recreates the entities of a snapshot next to the existing ones, the
+  // main camera record is applied to the current main camera. roots gets
+  // the loaded entities without parent. Fails when source_filename changed
+  // since the snapshot was saved
+  int LoadSnapshot(const char* filename, std::vector<Entity>* roots = nullptr,
+                   const char* source_filename = nullptr);
 
   // input
   void CaptureMouse();
@@ -80,20 +139,88 @@ class Renderer {
   // This should be private but windowproc needs acces to it
  private:
   static const uint16_t kSwapchainBufferCount = 3;
+  static const uint32_t kBoundsChunkSize = 1024;
+  static const uint32_t kCullingChunkSize = 2048;
+  // Past this many drawables culling walks the spatial index instead of
+  // testing every bounds
+  static const uint32_t kSpatialCullingThreshold = 16384;
+  static const uint32_t kOcclusionChunkSize = 256;
+  // Starting size of every upload ring, they grow when a frame needs more
+  static const uint64_t kUploadRingSize = 4 * 1024 * 1024;
+  // Slots of the shader visible heap every texture and ImGui live in
+  static const uint32_t kDescriptorHeapSize = 16384;
 
   std::unique_ptr<RR::Window> _window = nullptr;
   std::unique_ptr<RR::Editor> _editor = nullptr;
-  std::shared_ptr<Entity> _main_camera = nullptr;
+  std::unique_ptr<RR::World> _world = nullptr;
+  std::unique_ptr<RR::ThreadPool> _thread_pool = nullptr;
+  std::unique_ptr<RR::EntityCommandBuffer> _commands = nullptr;
+  std::unique_ptr<RR::BoundingVolumeHierarchy> _spatial_index = nullptr;
+  std::unique_ptr<RR::OcclusionCuller> _occlusion_culler = nullptr;
+  std::unique_ptr<RR::RadixSorter> _draw_sorter = nullptr;
+  Entity _main_camera = kInvalidEntity;
   std::unique_ptr<RR::Input> _input = nullptr;
 
   std::vector<GFX::Geometry> _geometries;
   std::vector<GFX::Texture> _textures;
+  // Global heap slot of every texture, written once when it is loaded
+  std::vector<uint32_t> _texture_descriptors;
+  // Source of every geometry and texture, kept for SaveSnapshot
+  std::vector<std::unique_ptr<GeometryData>> _geometry_data;
+  std::vector<std::wstring> _texture_files;
   std::map<uint32_t, GFX::Pipeline> _pipelines;
 
-  // This is memory acces mayhem, 0 cache hits
-  // specially when accessing entity components,
-  // See: BadBay game engine ECS
-  std::list<std::shared_ptr<Entity>> _entities;
+  // GPU resources of destroyed entities, released once the frame
+  // they were destroyed in is no longer in flight
+  std::vector<RendererComponent> _destroyed_renderers[kSwapchainBufferCount];
+
+  // Culling input and output of one archetype, reused every frame.
+  // Box streams are the world bounds of every row, visible holds rows
+  struct CullingScratch {
+    std::vector<float> center_x;
+    std::vector<float> center_y;
+    std::vector<float> center_z;
+    std::vector<float> extent_x;
+    std::vector<float> extent_y;
+    std::vector<float> extent_z;
+    std::vector<uint32_t> visible;
+    std::vector<uint32_t> chunk_visible;
+    // Rows with nothing to draw, never tested
+    std::vector<uint32_t> chunk_skipped;
+  };
+  CullingScratch _culling;
+  std::vector<Entity> _visible_entities;
+
+  // Renderers that survived culling this frame, in render list order
+  struct VisibleRenderer {
+    Entity entity;
+    RendererComponent* renderer;
+    WorldTransform* world_transform;
+  };
+  std::vector<VisibleRenderer> _visible_renderers;
+  std::vector<uint8_t> _occluded;
+  // Counts UpdatePipeline calls, stamps the occlusion history
+  uint32_t _culling_frame = 0U;
+
+  // One geometry slot of a visible renderer. Packets are drawn in the
+  // order of their keys, _draw_order holds the sorted packet indices
+  struct DrawPacket {
+    const DirectX::XMFLOAT4X4* world;
+    uint32_t pipeline_type;
+    int32_t geometry;
+    uint32_t material;
+  };
+  std::vector<DrawPacket> _draw_packets;
+  std::vector<uint64_t> _draw_keys;
+  std::vector<uint32_t> _draw_order;
+
+  // Per frame memory for instance matrices and draw constants, one ring
+  // per swapchain frame, reset once that frame's fence has retired
+  std::unique_ptr<GFX::UploadRing> _upload_rings[kSwapchainBufferCount];
+  // Unique materials of every renderer component with their constants
+  std::unique_ptr<RR::MaterialRegistry> _material_registry = nullptr;
+  // Slots of _srv_descriptor_heap
+  std::unique_ptr<RR::DescriptorAllocator> _descriptor_allocator = nullptr;
 
   uint16_t _current_frame = 0;
   bool _running = true;
@@ -105,7 +232,9 @@ class Renderer {
   IDXGISwapChain3* _swap_chain = nullptr;
   ID3D12CommandQueue* _command_queue = nullptr;
   ID3D12DescriptorHeap* _rt_descriptor_heap = nullptr;
-  ID3D12DescriptorHeap* _imgui_descriptor_heap = nullptr;
+  // Bindless heap, shaders index it with the slots stored in materials
+  ID3D12DescriptorHeap* _srv_descriptor_heap = nullptr;
+  uint32_t _srv_descriptor_size = 0U;
   ID3D12Resource* _render_targets[kSwapchainBufferCount] = {0};
   ID3D12CommandAllocator* _command_allocators[kSwapchainBufferCount] = {0};
   ID3D12GraphicsCommandList* _command_list = nullptr;
@@ -121,7 +250,20 @@ class Renderer {
  #endif
 
   void UpdateGraphicResources();
+  void ReleaseDestroyedResources(uint16_t frame);
   void InternalUpdate();
+  // Rebuilds the world bounds of drawables whose transform changed and
+  // moves them in the spatial index, returns how many were rebuilt
+  uint32_t UpdateBounds();
+  // Frustum culls the drawables of archetype, returns how many rows are
+  // visible. Those rows are stored at the front of _culling.visible and
+  // culled is increased by the rows the frustum rejected
+  uint32_t CullArchetype(Archetype& archetype, const Frustum& frustum,
+                         uint32_t* culled);
+  // Rasterizes the visible occluders and drops the visible renderers
+  // hidden behind them, returns how many were dropped. Renderers tested
+  // last frame reuse their result until their staggered full test
+  uint32_t CullOccluded(const DirectX::XMFLOAT4X4& view_projection);
   void UpdatePipeline();
   void Render();
   void Cleanup();
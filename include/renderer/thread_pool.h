@@ -0,0 +1,62 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__ 1
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RR {
+// Fixed set of worker threads used to split data parallel work in chunks.
+// The calling thread also runs chunks, so with 0 workers every job simply
+// runs inline
+class ThreadPool {
+ public:
+  ThreadPool() = default;
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool(ThreadPool&&) = delete;
+
+  void operator=(const ThreadPool&) = delete;
+  void operator=(ThreadPool&&) = delete;
+
+  ~ThreadPool();
+
+  // kDefaultThreadCount uses one worker less than hardware threads
+  static const uint32_t kDefaultThreadCount = 0xFFFFFFFF;
+
+  void Init(uint32_t thread_count = kDefaultThreadCount);
+  void Release();
+
+  // Calls task(begin, end) over [0, count) in chunks of chunk_size and
+  // returns once every chunk has finished, so consecutive calls are
+  // separated by a barrier. Must not be called from inside a task
+  void ParallelFor(uint32_t count, uint32_t chunk_size,
+                   const std::function<void(uint32_t, uint32_t)>& task);
+
+  uint32_t thread_count() const;
+
+ private:
+  std::vector<std::thread> _threads;
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::condition_variable _done;
+  bool _quit = false;
+
+  // Current job, guarded by _mutex
+  const std::function<void(uint32_t, uint32_t)>* _task = nullptr;
+  uint64_t _generation = 0;
+  uint32_t _count = 0;
+  uint32_t _chunk_size = 0;
+  uint32_t _chunk_count = 0;
+  uint32_t _next_chunk = 0;
+  uint32_t _pending_chunks = 0;
+
+  void WorkerLoop();
+  void RunChunks(std::unique_lock<std::mutex>& lock, uint64_t generation);
+};
+}
+
+#endif  // !__THREAD_POOL_H__
@@ -0,0 +1,127 @@
+#ifndef __TRANSFORM_HIERARCHY_H__
+#define __TRANSFORM_HIERARCHY_H__ 1
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "renderer/entity.h"
+
+namespace RR {
+class ThreadPool;
+
+// Persistent copy of every local transform sorted by depth, parents are
+// always stored in the level before their children so world matrices can
+// be built in one linear pass. Kept up to date incrementally by the world
+// when entities are created, destroyed or reparented
+class TransformHierarchy {
+ public:
+  // Ends a child or sibling list
+  static const uint32_t kNoNode = 0xFFFFFFFF;
+
+  // Components kept in separate streams so the transform kernel can
+  // load several consecutive nodes per instruction
+  struct Float3Stream {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+
+    DirectX::XMFLOAT3 Get(size_t index) const;
+    void Set(size_t index, const DirectX::XMFLOAT3& value);
+    void Push(const DirectX::XMFLOAT3& value);
+    void Pop();
+  };
+
+  struct Float4Stream {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> w;
+
+    DirectX::XMFLOAT4 Get(size_t index) const;
+    void Set(size_t index, const DirectX::XMFLOAT4& value);
+    void Push(const DirectX::XMFLOAT4& value);
+    void Pop();
+  };
+
+  // Nodes of the same depth, row i of every array belongs to entities[i].
+  // parents[i] indexes the previous level. Children of a node are linked,
+  // first_children[i] indexes the next level and the sibling links this
+  // one, so walking them never scans a whole level
+  struct Level {
+    std::vector<Entity> entities;
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> first_children;
+    std::vector<uint32_t> next_siblings;
+    std::vector<uint32_t> previous_siblings;
+    Float3Stream positions;
+    // Unit quaternions
+    Float4Stream rotations;
+    Float3Stream scales;
+    std::vector<DirectX::XMFLOAT4X4> worlds;
+    std::vector<uint8_t> dirty;
+  };
+
+  TransformHierarchy() = default;
+  ~TransformHierarchy() = default;
+
+  // Room for count more nodes at depth
+  void Reserve(uint32_t count, uint32_t depth = 0);
+  // Inserted straight at the level below parent, as a root when parent
+  // isn't in the hierarchy
+  void Insert(Entity entity, Entity parent = kInvalidEntity);
+  // Direct children of the removed node become roots, they are
+  // appended to orphans so the caller can update their components
+  void Remove(Entity entity, std::vector<Entity>* orphans);
+
+  // Moves the whole subtree under parent, kInvalidEntity makes it a root.
+  // Fails if any of them is unknown or parent is a descendant of entity
+  bool SetParent(Entity entity, Entity parent);
+  bool IsDescendant(Entity entity, Entity ancestor) const;
+
+  bool Contains(Entity entity) const;
+  Entity Parent(Entity entity) const;
+  // Appends the direct children of entity
+  void Children(Entity entity, std::vector<Entity>* children) const;
+  uint32_t Depth(Entity entity) const;
+
+  void SetLocal(Entity entity, const DirectX::XMFLOAT3& position,
+                const DirectX::XMFLOAT4& rotation,
+                const DirectX::XMFLOAT3& scale);
+
+  // Rebuilds the world matrix of dirty nodes and their descendants,
+  // returns how many were rebuilt. Dirty flags stay set until ClearDirty
+  // so the caller can copy the results out. Levels are split in chunks
+  // over thread_pool when given
+  uint32_t Update(ThreadPool* thread_pool = nullptr);
+  void ClearDirty();
+
+  uint32_t size() const;
+  std::vector<Level>& levels();
+
+ private:
+  static const uint32_t kNoLevel = 0xFFFFFFFF;
+  // Multiple of the widest kernel batch so only the level tail goes scalar
+  static const uint32_t kUpdateChunkSize = 2048;
+
+  struct Slot {
+    uint32_t level;
+    uint32_t index;
+  };
+
+  std::vector<Level> _levels;
+  // Indexed by EntityIndex()
+  std::vector<Slot> _slots;
+  uint32_t _size = 0U;
+
+  const Slot* Find(Entity entity) const;
+  void Push(Entity entity, Entity parent, const DirectX::XMFLOAT3& position,
+            const DirectX::XMFLOAT4& rotation, const DirectX::XMFLOAT3& scale);
+  // Points the parent, siblings and children of the node at its row
+  void Link(uint32_t level, uint32_t index);
+  void Erase(uint32_t level, uint32_t index);
+};
+}
+
+#endif  // !__TRANSFORM_HIERARCHY_H__
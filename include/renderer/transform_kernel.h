@@ -0,0 +1,46 @@
+#ifndef __TRANSFORM_KERNEL_H__
+#define __TRANSFORM_KERNEL_H__ 1
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+
+namespace RR {
+// Structure of arrays input of the batched TRS kernel. Every stream has
+// one entry per transform, rotations are unit quaternions
+struct TransformStreams {
+  const float* position_x;
+  const float* position_y;
+  const float* position_z;
+  const float* rotation_x;
+  const float* rotation_y;
+  const float* rotation_z;
+  const float* rotation_w;
+  const float* scale_x;
+  const float* scale_y;
+  const float* scale_z;
+
+  // Only transforms with a non zero flag are written
+  const uint8_t* dirty;
+
+  // Row of the parent in parent_worlds, both nullptr for roots
+  const uint32_t* parents;
+  const DirectX::XMFLOAT4X4* parent_worlds;
+
+  DirectX::XMFLOAT4X4* worlds;
+};
+
+// Builds scale * rotation * translation * parent for the dirty transforms
+// in [begin, end). Uses 8 (AVX2) or 4 (SSE) wide batches when the cpu
+// supports them, falls back to the scalar path
+void ComputeWorldMatrices(const TransformStreams& streams, uint32_t begin,
+                          uint32_t end);
+
+void ComputeWorldMatricesScalar(const TransformStreams& streams,
+                                uint32_t begin, uint32_t end);
+
+// Lanes used by ComputeWorldMatrices on this machine: 8, 4 or 1
+uint32_t TransformKernelWidth();
+}
+
+#endif  // !__TRANSFORM_KERNEL_H__
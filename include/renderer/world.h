@@ -0,0 +1,108 @@
+#ifndef __WORLD_H__
+#define __WORLD_H__ 1
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "renderer/entity.h"
+#include "renderer/archetype.h"
+#include "renderer/transform_hierarchy.h"
+
+namespace RR {
+class EntityComponent;
+class ThreadPool;
+
+class World {
+ public:
+  World() = default;
+
+  World(const World&) = delete;
+  World(World&&) = delete;
+
+  void operator=(const World&) = delete;
+  void operator=(World&&) = delete;
+
+  ~World() = default;
+
+  // Entities with a local transform are created as children of parent
+  // when it has one too, without passing through the roots
+  Entity CreateEntity(uint32_t component_types,
+                      Entity parent = kInvalidEntity);
+  // Reserves storage for the whole batch before creating the entities,
+  // handles are appended to entities. parents[i] is the parent of the
+  // i-th new entity when not null. Rows are appended to one archetype, so
+  // a batch occupies consecutive rows
+  void CreateEntities(uint32_t count, uint32_t component_types,
+                      std::vector<Entity>* entities,
+                      const Entity* parents = nullptr);
+  void AddComponents(Entity entity, uint32_t component_types);
+  void SetParent(Entity entity, Entity parent);
+
+  // Pushes changed local transforms through the hierarchy and writes the
+  // rebuilt world matrices back, returns how many were rebuilt.
+  // Both steps are split over thread_pool when given
+  uint32_t UpdateTransforms(ThreadPool* thread_pool = nullptr);
+
+  // Returned pointers are invalidated by any structural change
+  // (creating or destroying entities, adding components).
+  // T is a component class, its bit comes from T::kType
+  template <typename T>
+  T* GetComponent(Entity entity);
+  // Same for component types only known at runtime
+  EntityComponent* GetComponent(Entity entity, uint32_t component_type);
+  uint32_t Components(Entity entity) const;
+  bool IsValid(Entity entity) const;
+  uint32_t EntityCount() const;
+
+  // Indices of the archetypes holding at least every component in
+  // component_types. Entities move between archetypes when components are
+  // added or removed, so the set only changes when an archetype is
+  // created; it is cached per mask and extended then
+  const std::vector<uint32_t>& Query(uint32_t component_types);
+
+  std::vector<Archetype>& archetypes();
+  const TransformHierarchy& hierarchy() const;
+
+  friend class Renderer;
+ private:
+  static const uint32_t kNoArchetype = 0xFFFFFFFF;
+  static const uint32_t kScatterChunkSize = 4096;
+
+  // Sparse side of the storage, indexed by EntityIndex(), points to the
+  // dense archetype row. Destroyed records go to the free list
+  struct EntityRecord {
+    uint32_t archetype;
+    uint32_t row;
+    uint32_t generation;
+  };
+
+  std::vector<EntityRecord> _records;
+  std::vector<uint32_t> _free_records;
+  uint32_t _entity_count = 0U;
+  std::vector<Archetype> _archetypes;
+  std::map<uint32_t, uint32_t> _archetype_indices;
+  std::map<uint32_t, std::vector<uint32_t>> _queries;
+
+  TransformHierarchy _hierarchy;
+
+  // Only reached through Renderer::DestroyEntity, which first hands the
+  // GPU resources of the entity to the frame fences and drops it from
+  // the spatial index
+  void DestroyEntity(Entity entity);
+
+  uint32_t FindOrCreateArchetype(uint32_t component_types);
+};
+
+template <typename T>
+inline T* World::GetComponent(Entity entity) {
+  if (!IsValid(entity)) {
+    return nullptr;
+  }
+
+  const EntityRecord& record = _records[EntityIndex(entity)];
+  return _archetypes[record.archetype].Get<T>(record.row);
+}
+}
+
+#endif  // !__WORLD_H__
@@ -0,0 +1,137 @@
+#ifndef __WORLD_SNAPSHOT_H__
+#define __WORLD_SNAPSHOT_H__ 1
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "renderer/common.hpp"
+
+namespace RR {
+// Binary image of a world, written by Renderer::SaveSnapshot and read back
+// by Renderer::LoadSnapshot. The file is mapped copy on write and the
+// offsets stored in it are patched into pointers once, so loading does
+// no parsing. Entities are stored parents first and reference geometries,
+// textures and each other by their index in the file
+class WorldSnapshot {
+ public:
+  static const uint32_t kMagic = 0x53575252;  // "RRWS"
+  // Bump whenever any record layout changes, older files are rejected
+  static const uint32_t kVersion = 2;
+
+  // Entity flags
+  static const uint32_t kEntityFlag_MainCamera = 0x1;
+  static const uint32_t kEntityFlag_Occluder = 0x2;
+
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entity_count;
+    uint32_t slot_count;
+    uint32_t geometry_count;
+    uint32_t texture_count;
+    uint64_t entities;
+    uint64_t slots;
+    uint64_t geometries;
+    uint64_t textures;
+    uint64_t file_size;
+    // Size and last write time of the file the world was imported from,
+    // 0 when it wasn't given to Write
+    uint64_t source_size;
+    uint64_t source_time;
+  };
+
+  struct EntityRecord {
+    uint32_t components;
+    uint32_t flags;
+    // Index of the parent record, -1 for roots
+    int32_t parent;
+    uint32_t pipeline_type;
+    // Range in the slot array, one slot per geometry
+    uint32_t first_slot;
+    uint32_t slot_count;
+    DirectX::XMFLOAT3 position;
+    DirectX::XMFLOAT4 rotation;
+    DirectX::XMFLOAT3 scale;
+    float fov;
+    float near_z;
+    float far_z;
+    float clear_color[4];
+  };
+
+  // Texture handles in textures are indices into the texture records
+  struct SlotRecord {
+    int32_t geometry;
+    MaterialSettings settings;
+    TextureSettings textures;
+  };
+
+  // Stored as offsets, patched into pointers when mapped
+  struct GeometryRecord {
+    uint32_t type;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t padding;
+    union {
+      uint64_t offset;
+      const float* data;
+    } vertices;
+    union {
+      uint64_t offset;
+      const uint32_t* data;
+    } indices;
+  };
+
+  // Null terminated file name
+  struct TextureRecord {
+    union {
+      uint64_t offset;
+      const wchar_t* data;
+    } name;
+  };
+
+  WorldSnapshot() = default;
+
+  WorldSnapshot(const WorldSnapshot&) = delete;
+  WorldSnapshot(WorldSnapshot&&) = delete;
+
+  void operator=(const WorldSnapshot&) = delete;
+  void operator=(WorldSnapshot&&) = delete;
+
+  ~WorldSnapshot();
+
+  // geometry_data[i] holds the vertices and indices of geometry i.
+  // source_filename is stamped in the header when not null
+  static int Write(const char* filename,
+                   const std::vector<EntityRecord>& entities,
+                   const std::vector<SlotRecord>& slots,
+                   const std::vector<uint32_t>& geometry_types,
+                   const std::vector<const GeometryData*>& geometry_data,
+                   const std::vector<std::wstring>& textures,
+                   const char* source_filename = nullptr);
+
+  // Returns 0 on success, the records stay valid until Unmap. With a
+  // source_filename the snapshot is rejected when that file changed since
+  // it was written, a missing source is not checked
+  int Map(const char* filename, const char* source_filename = nullptr);
+  void Unmap();
+
+  const Header* header() const;
+  const EntityRecord* entities() const;
+  const SlotRecord* slots() const;
+  const GeometryRecord* geometries() const;
+  const TextureRecord* textures() const;
+
+ private:
+  // Checks every section and reference lies inside the file
+  bool Validate(uint64_t file_size) const;
+
+  void* _file = nullptr;
+  void* _mapping = nullptr;
+  uint8_t* _view = nullptr;
+};
+}
+
+#endif  // !__WORLD_SNAPSHOT_H__
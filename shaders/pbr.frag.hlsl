@@ -1,12 +1,15 @@
-Texture2D textures[5] : register(t0);
+// Global descriptor heap, materials index it
+Texture2D textures[] : register(t0);
 SamplerState s1 : register(s0);
 
 static const float PI = 3.14159265359f;
 
-cbuffer MVP : register(b0) {
-  float4x4 model;
+// Written once per frame, every draw of the frame reads it
+cbuffer Frame : register(b0) {
   float4x4 view;
   float4x4 projection;
+  float4x4 viewProjection;
+  float3 cameraPos;
 };
 
 cbuffer MaterialParameters : register(b1) {
@@ -21,12 +24,18 @@ cbuffer MaterialParameters : register(b1) {
   bool metallicTexture;
   bool roughnessTexture;
   bool reflectanceTexture;
+
+  // Slots of the material textures in the global heap
+  uint baseColorIndex;
+  uint metallicIndex;
+  uint normalIndex;
+  uint roughnessIndex;
+  uint reflectanceIndex;
 };
 
 cbuffer Constants : register(b2) {
   float elapsedTime;
   float ambientIntensity;
-  float3 cameraPos;
   float3 lightPos;
 };
 
@@ -37,6 +46,7 @@ struct VertexOutput {
   float3 worldNormal : WORLD_NORMAL;
   float2 uv : UV;
   float3x3 tbn : TBN;
+  nointerpolation float4x4 model : MODEL;
 };
 
 // GGX Normal distribution function (NDF)
@@ -99,31 +109,31 @@ float4 main(VertexOutput input) : SV_TARGET {
   // Material parameters remap
   float4 realBaseColor = baseColor;
   if (baseColorTexture) {
-    realBaseColor = textures[0].Sample(s1, input.uv);
+    realBaseColor = textures[baseColorIndex].Sample(s1, input.uv);
     float3 correct = pow(realBaseColor.rgb, 2.2f);
     realBaseColor = float4(correct.rgb, realBaseColor.a);
   }
 
   float realMetallic = metallic;
   if (metallicTexture) {
-    realMetallic = pow(textures[1].Sample(s1, input.uv), 2.2f).r;
+    realMetallic = pow(textures[metallicIndex].Sample(s1, input.uv), 2.2f).r;
   }
 
   float realperceptualRoughness = perceptualRoughness;
   if (roughnessTexture) {
-    realperceptualRoughness = pow(textures[3].Sample(s1, input.uv), 2.2f).r;
+    realperceptualRoughness = pow(textures[roughnessIndex].Sample(s1, input.uv), 2.2f).r;
   }
 
   float realReflectance = reflectance;
   if (reflectanceTexture) {
-    realReflectance = pow(textures[4].Sample(s1, input.uv), 2.2f).r;
+    realReflectance = pow(textures[reflectanceIndex].Sample(s1, input.uv), 2.2f).r;
   }
 
   float3 N;
   if (normalTexture) {
-    N = textures[2].Sample(s1, input.uv).xyz * 2.0f - 1.0f;
+    N = textures[normalIndex].Sample(s1, input.uv).xyz * 2.0f - 1.0f;
     N = mul(input.tbn, N);
-    N = mul(transpose(model), float4(N, 1.0f)).xyz;
+    N = mul(transpose(input.model), float4(N, 1.0f)).xyz;
   } else {
     N = input.worldNormal;
   }
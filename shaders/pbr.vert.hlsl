@@ -1,7 +1,9 @@
-cbuffer MVP : register(b0) { 
-  float4x4 model;
+// Written once per frame, every draw of the frame reads it
+cbuffer Frame : register(b0) {
   float4x4 view;
   float4x4 projection;
+  float4x4 viewProjection;
+  float3 cameraPos;
 };
 
 struct VertexInput {
@@ -9,6 +11,11 @@ struct VertexInput {
   float3 normal : NORMAL;
   float3 tangent : TANGENT;
   float2 uv : UV;
+  // World matrix rows, one per instance
+  float4 model0 : MODEL0;
+  float4 model1 : MODEL1;
+  float4 model2 : MODEL2;
+  float4 model3 : MODEL3;
 };
 
 struct VertexOutput {
@@ -18,13 +25,16 @@ struct VertexOutput {
   float3 worldNormal : WORLD_NORMAL;
   float2 uv : UV;
   float3x3 tbn : TBN;
+  nointerpolation float4x4 model : MODEL;
 };
 
 VertexOutput main(VertexInput input) {
+  float4x4 world = float4x4(input.model0, input.model1, input.model2, input.model3);
+
   VertexOutput output;
-  output.position = mul(float4(input.position, 1.0f), mul(model, mul(view, projection)));
-  output.worldPos = mul(model, float4(input.position, 1.0f));
-  output.worldNormal = normalize(mul(transpose(model), float4(input.normal, 1.0f)).xyz);
+  output.position = mul(float4(input.position, 1.0f), mul(world, viewProjection));
+  output.worldPos = mul(world, float4(input.position, 1.0f));
+  output.worldNormal = normalize(mul(transpose(world), float4(input.normal, 1.0f)).xyz);
   output.normal = input.normal;
   output.uv = input.uv;
   output.tbn = float3x3(
@@ -33,5 +43,6 @@ VertexOutput main(VertexInput input) {
     normalize(input.normal)
   );
   output.tbn = transpose(output.tbn);
+  output.model = world;
   return output;
 }
\ No newline at end of file
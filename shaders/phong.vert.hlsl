@@ -1,13 +1,20 @@
-cbuffer MVP : register(b0) {
-  float4x4 model;
+// Written once per frame, every draw of the frame reads it
+cbuffer Frame : register(b0) {
   float4x4 view;
   float4x4 projection;
+  float4x4 viewProjection;
+  float3 cameraPos;
 };
 
 struct VertexInput {
   float3 position : POSITION;
   float3 normal : NORMAL;
   float2 uv : UV;
+  // World matrix rows, one per instance
+  float4 model0 : MODEL0;
+  float4 model1 : MODEL1;
+  float4 model2 : MODEL2;
+  float4 model3 : MODEL3;
 };
 
 struct VertexOutput {
@@ -16,8 +23,10 @@ struct VertexOutput {
 };
 
 VertexOutput main(VertexInput input) {
+  float4x4 world = float4x4(input.model0, input.model1, input.model2, input.model3);
+
   VertexOutput output;
-  output.position = mul(float4(input.position, 1.0f), mul(model, mul(view, projection)));
+  output.position = mul(float4(input.position, 1.0f), mul(world, viewProjection));
   output.normal = input.normal;
   return output;
 }
\ No newline at end of file
@@ -1,6 +1,9 @@
 #include "renderer/renderer.h"
 
+#include <chrono>
+
 #include "renderer/input.h"
+#include "renderer/world.h"
 #include "renderer/entity.h"
 #include "renderer/logger.h"
 #include "renderer/common.hpp"
@@ -10,29 +13,44 @@
 #include "renderer/components/renderer_component.h"
 #include "renderer/components/camera_component.h"
 
+static const char* kSceneFile = "../../resources/Helmets.fbx";
+static const char* kSnapshotFile = "../../resources/Helmets.rrws";
+
 struct UserData {
   RR::Renderer* renderer;
-  std::shared_ptr<RR::Entity> parent;
+  RR::Entity parent;
 };
 
 static void update(void* user_data) { 
   UserData* data = (UserData*) user_data;
 
   // UPDATE CAMERA
-  std::shared_ptr<RR::LocalTransform> transform =
-      std::static_pointer_cast<RR::LocalTransform>(
-          data->renderer->MainCamera()->GetComponent(
-              RR::kComponentType_LocalTransform));
-
-  std::shared_ptr<RR::WorldTransform> world =
-      std::static_pointer_cast<RR::WorldTransform>(
-          data->renderer->MainCamera()->GetComponent(
-              RR::kComponentType_WorldTransform));
-
-  transform->rotation.y += data->renderer->MouseXAxis() * 16.0f;
-  transform->rotation.x += data->renderer->MouseYAxis() * 8.0f;
-
-  DirectX::XMVECTOR traslation = DirectX::XMLoadFloat3(&transform->position);
+  RR::World* entities = data->renderer->world();
+
+  RR::LocalTransform* transform =
+      entities->GetComponent<RR::LocalTransform>(data->renderer->MainCamera());
+
+  RR::WorldTransform* world =
+      entities->GetComponent<RR::WorldTransform>(data->renderer->MainCamera());
+
+  // Pitch is applied before the current rotation and yaw after it,
+  // same as adding to the x and y euler angles
+  DirectX::XMVECTOR pitch = DirectX::XMQuaternionRotationNormal(
+      DirectX::XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f),
+      DirectX::XMConvertToRadians(data->renderer->MouseYAxis() * 8.0f));
+  DirectX::XMVECTOR yaw = DirectX::XMQuaternionRotationNormal(
+      DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f),
+      DirectX::XMConvertToRadians(data->renderer->MouseXAxis() * 16.0f));
+
+  DirectX::XMFLOAT4 rotation;
+  DirectX::XMStoreFloat4(
+      &rotation,
+      DirectX::XMQuaternionMultiply(
+          pitch, DirectX::XMQuaternionMultiply(
+                     DirectX::XMLoadFloat4(&transform->quaternion()), yaw)));
+  transform->SetQuaternion(rotation);
+
+  DirectX::XMVECTOR traslation = DirectX::XMLoadFloat3(&transform->position());
   DirectX::XMFLOAT3 delta = world->forward();
 
   traslation = DirectX::XMVectorAdd(
@@ -57,12 +75,21 @@ static void update(void* user_data) {
       DirectX::XMVectorScale(DirectX::XMLoadFloat3(&delta),
                              -0.05f * data->renderer->IsKeyDown('A')));
 
-  DirectX::XMStoreFloat3(&transform->position, traslation);
+  DirectX::XMFLOAT3 position;
+  DirectX::XMStoreFloat3(&position, traslation);
+  transform->SetPosition(position);
 
   // UPDATE SCENE
-  transform = std::static_pointer_cast<RR::LocalTransform>(
-      data->parent->GetComponent(RR::kComponentType_LocalTransform));
-  transform->rotation.y += data->renderer->delta_time * 0.05f;  
+  transform = entities->GetComponent<RR::LocalTransform>(data->parent);
+  yaw = DirectX::XMQuaternionRotationNormal(
+      DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f),
+      DirectX::XMConvertToRadians(data->renderer->delta_time * 0.05f));
+
+  DirectX::XMStoreFloat4(
+      &rotation,
+      DirectX::XMQuaternionMultiply(
+          DirectX::XMLoadFloat4(&transform->quaternion()), yaw));
+  transform->SetQuaternion(rotation);
 }
 
 int main(int argc, char** argv) {
@@ -76,52 +103,69 @@ int main(int argc, char** argv) {
 
   data.renderer = &renderer;
 
+  RR::World* world = renderer.world();
+
+  RR::LocalTransform* transform =
+      world->GetComponent<RR::LocalTransform>(renderer.MainCamera());
   
-  std::shared_ptr<RR::LocalTransform> transform = std::static_pointer_cast<RR::LocalTransform>(
-      renderer.MainCamera()->GetComponent(RR::kComponentType_LocalTransform));
-  
-  std::shared_ptr<RR::Camera> camera = std::static_pointer_cast<RR::Camera>(
-      renderer.MainCamera()->GetComponent(RR::kComponentType_Camera));
+  RR::Camera* camera = world->GetComponent<RR::Camera>(renderer.MainCamera());
 
   camera->farZ = 500.0f;
   camera->nearZ = 0.001f;
 
-  transform->position = {4.996f, 2.5f, 0.0f};
-  transform->rotation = {15.0f, -90.0f, 0.0f};
+  transform->SetPosition({4.996f, 2.5f, 0.0f});
+  transform->SetRotation({15.0f, -90.0f, 0.0f});
+
+  // The snapshot is written the first time the FBX is imported, later
+  // runs load it instead until the FBX changes. Both paths log how long
+  // they took
+  std::vector<RR::Entity> roots;
+  if (renderer.LoadSnapshot(kSnapshotFile, &roots, kSceneFile) == 0 &&
+      !roots.empty()) {
+    data.parent = roots[0];
+    renderer.Start();
+    return 0;
+  }
+
+  std::chrono::time_point<std::chrono::steady_clock> import_start =
+      std::chrono::steady_clock::now();
 
   std::shared_ptr<std::vector<RR::MeshData>> meshes =
-    renderer.LoadFBXScene("../../resources/Helmets.fbx");
+    renderer.LoadFBXScene(kSceneFile);
 
   data.parent = renderer.RegisterEntity(
       RR::ComponentTypes::kComponentType_LocalTransform |
       RR::ComponentTypes::kComponentType_WorldTransform);
 
-  for (int i = 0; i < meshes.get()->size(); i++) {
-    RR::MeshData* mesh = &meshes.get()->at(i);
+  std::vector<uint32_t> geometry_counts(meshes.get()->size());
+  for (size_t i = 0; i < geometry_counts.size(); i++) {
+    geometry_counts[i] = meshes.get()->at(i).geometries.size();
+  }
 
-    std::shared_ptr<RR::Entity> ent = renderer.RegisterEntity(
-        RR::ComponentTypes::kComponentType_Renderer |
-        RR::ComponentTypes::kComponentType_WorldTransform | 
-        RR::ComponentTypes::kComponentType_LocalTransform);
+  std::vector<RR::Entity> entities = renderer.RegisterEntities(
+      meshes.get()->size(),
+      RR::ComponentTypes::kComponentType_Renderer |
+      RR::ComponentTypes::kComponentType_WorldTransform |
+      RR::ComponentTypes::kComponentType_LocalTransform,
+      RR::PipelineTypes::kPipelineType_PBR, geometry_counts.data());
 
-    std::shared_ptr<RR::LocalTransform> transform =
-        std::static_pointer_cast<RR::LocalTransform>(ent.get()->GetComponent(
-            RR::ComponentTypes::kComponentType_LocalTransform));
+  for (size_t i = 0; i < entities.size(); i++) {
+    RR::MeshData* mesh = &meshes.get()->at(i);
+    RR::Entity ent = entities[i];
 
-    std::shared_ptr<RR::RendererComponent> renderer_c =
-        std::static_pointer_cast<RR::RendererComponent>(ent.get()->GetComponent(
-            RR::ComponentTypes::kComponentType_Renderer));
+    RR::LocalTransform* transform = world->GetComponent<RR::LocalTransform>(ent);
 
-    renderer_c->Init(&renderer, RR::PipelineTypes::kPipelineType_PBR, mesh->geometries.size());
+    RR::RendererComponent* renderer_c =
+        world->GetComponent<RR::RendererComponent>(ent);
 
-    transform->position = mesh->position;
-    transform->rotation = mesh->rotation;
-    transform->scale = mesh->scale;
+    transform->SetPosition(mesh->position);
+    transform->SetRotation(mesh->rotation);
+    transform->SetScale(mesh->scale);
 
-    transform->SetParent(data.parent);
+    world->SetParent(ent, data.parent);
 
     for (int j = 0; j < mesh->geometries.size(); j++) {  
-      renderer_c->geometries[j] = mesh->geometries[j];
+      renderer_c->SetGeometry(j, mesh->geometries[j]);
       renderer_c->settings[j].pbr_settings = mesh->settings[j];
       renderer_c->textureSettings[j].pbr_textures = mesh->textures[j];
     }
@@ -129,6 +173,13 @@ int main(int argc, char** argv) {
 
   meshes = nullptr;
 
+  LOG_DEBUG("Main", "Imported %s in %.2f ms", kSceneFile,
+            std::chrono::duration<float, std::milli>(
+                std::chrono::steady_clock::now() - import_start)
+                .count());
+
+  renderer.SaveSnapshot(kSnapshotFile, kSceneFile);
+
   renderer.Start();
 
   return 0;
@@ -0,0 +1,126 @@
+#include "renderer/archetype.h"
+
+#include <utility>
+
+#include "renderer/common.hpp"
+#include "renderer/components/entity_component.h"
+
+RR::Archetype::Archetype(uint32_t components) : _components(components) {}
+
+uint32_t RR::Archetype::components() const { return _components; }
+
+uint32_t RR::Archetype::size() const { return entities.size(); }
+
+void RR::Archetype::Reserve(uint32_t count) {
+  entities.reserve(count);
+
+  if (_components & kComponentType_LocalTransform) {
+    local_transforms.reserve(count);
+  }
+
+  if (_components & kComponentType_WorldTransform) {
+    world_transforms.reserve(count);
+  }
+
+  if (_components & kComponentType_Renderer) {
+    renderers.reserve(count);
+  }
+
+  if (_components & kComponentType_Camera) {
+    cameras.reserve(count);
+  }
+}
+
+uint32_t RR::Archetype::Add(Entity entity) {
+  entities.push_back(entity);
+
+  if (_components & kComponentType_LocalTransform) {
+    local_transforms.emplace_back();
+  }
+
+  if (_components & kComponentType_WorldTransform) {
+    world_transforms.emplace_back();
+  }
+
+  if (_components & kComponentType_Renderer) {
+    renderers.emplace_back();
+  }
+
+  if (_components & kComponentType_Camera) {
+    cameras.emplace_back();
+  }
+
+  return entities.size() - 1;
+}
+
+template <typename T>
+static void SwapRemove(std::vector<T>& components, uint32_t row) {
+  if (components.empty()) {
+    return;
+  }
+
+  if (row != components.size() - 1) {
+    components[row] = std::move(components.back());
+  }
+
+  components.pop_back();
+}
+
+RR::Entity RR::Archetype::Remove(uint32_t row) {
+  if (row >= entities.size()) {
+    return kInvalidEntity;
+  }
+
+  bool last = row == entities.size() - 1;
+
+  SwapRemove(entities, row);
+  SwapRemove(local_transforms, row);
+  SwapRemove(world_transforms, row);
+  SwapRemove(renderers, row);
+  SwapRemove(cameras, row);
+
+  return last ? kInvalidEntity : entities[row];
+}
+
+uint32_t RR::Archetype::CopyTo(uint32_t row, Archetype* destination) {
+  uint32_t new_row = destination->Add(entities[row]);
+  uint32_t shared = _components & destination->_components;
+
+  if (shared & kComponentType_LocalTransform) {
+    destination->local_transforms[new_row] = std::move(local_transforms[row]);
+  }
+
+  if (shared & kComponentType_WorldTransform) {
+    destination->world_transforms[new_row] = std::move(world_transforms[row]);
+  }
+
+  if (shared & kComponentType_Renderer) {
+    destination->renderers[new_row] = std::move(renderers[row]);
+  }
+
+  if (shared & kComponentType_Camera) {
+    destination->cameras[new_row] = std::move(cameras[row]);
+  }
+
+  return new_row;
+}
+
+RR::EntityComponent* RR::Archetype::Component(uint32_t component_type,
+                                             uint32_t row) {
+  if ((_components & component_type) == 0 || row >= entities.size()) {
+    return nullptr;
+  }
+
+  switch (component_type) {
+    case kComponentType_LocalTransform:
+      return &local_transforms[row];
+    case kComponentType_WorldTransform:
+      return &world_transforms[row];
+    case kComponentType_Renderer:
+      return &renderers[row];
+    case kComponentType_Camera:
+      return &cameras[row];
+  }
+
+  return nullptr;
+}
@@ -0,0 +1,547 @@
+#include "renderer/bounding_volume_hierarchy.h"
+
+#include <cmath>
+
+#include "renderer/frustum_culling.h"
+
+const int32_t RR::BoundingVolumeHierarchy::kNullNode;
+const float RR::BoundingVolumeHierarchy::kMargin = 0.1f;
+
+static DirectX::XMFLOAT3 Min(const DirectX::XMFLOAT3& a,
+                             const DirectX::XMFLOAT3& b) {
+  return {a.x < b.x ? a.x : b.x, a.y < b.y ? a.y : b.y,
+          a.z < b.z ? a.z : b.z};
+}
+
+static DirectX::XMFLOAT3 Max(const DirectX::XMFLOAT3& a,
+                             const DirectX::XMFLOAT3& b) {
+  return {a.x > b.x ? a.x : b.x, a.y > b.y ? a.y : b.y,
+          a.z > b.z ? a.z : b.z};
+}
+
+// Half the surface area, the insertion cost
+static float Area(const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max) {
+  float x = max.x - min.x;
+  float y = max.y - min.y;
+  float z = max.z - min.z;
+  return x * y + y * z + z * x;
+}
+
+static bool Encloses(const DirectX::XMFLOAT3& outer_min,
+                     const DirectX::XMFLOAT3& outer_max,
+                     const DirectX::XMFLOAT3& min,
+                     const DirectX::XMFLOAT3& max) {
+  return outer_min.x <= min.x && outer_min.y <= min.y &&
+         outer_min.z <= min.z && max.x <= outer_max.x &&
+         max.y <= outer_max.y && max.z <= outer_max.z;
+}
+
+bool RR::BoundingVolumeHierarchy::Update(Entity entity, const Bounds& bounds) {
+  if (IsEmpty(bounds)) {
+    bool contained = Contains(entity);
+    Remove(entity);
+    return contained;
+  }
+
+  uint32_t index = EntityIndex(entity);
+  if (index >= _leaves.size()) {
+    _leaves.resize(index + 1, kNullNode);
+  }
+
+  // The slot may still hold a destroyed entity with the same index
+  int32_t leaf = _leaves[index];
+  if (leaf != kNullNode && _nodes[leaf].entity != entity) {
+    RemoveLeaf(leaf);
+    FreeNode(leaf);
+    _leaf_count--;
+    leaf = kNullNode;
+  }
+
+  if (leaf != kNullNode) {
+    Node& node = _nodes[leaf];
+    node.tight_min = bounds.min;
+    node.tight_max = bounds.max;
+
+    if (Encloses(node.min, node.max, bounds.min, bounds.max)) {
+      return false;
+    }
+
+    RemoveLeaf(leaf);
+  } else {
+    leaf = AllocateNode();
+    _nodes[leaf].entity = entity;
+    _nodes[leaf].tight_min = bounds.min;
+    _nodes[leaf].tight_max = bounds.max;
+    _leaves[index] = leaf;
+    _leaf_count++;
+  }
+
+  Node& node = _nodes[leaf];
+  DirectX::XMFLOAT3 margin = {(bounds.max.x - bounds.min.x) * kMargin,
+                              (bounds.max.y - bounds.min.y) * kMargin,
+                              (bounds.max.z - bounds.min.z) * kMargin};
+  node.min = {bounds.min.x - margin.x, bounds.min.y - margin.y,
+              bounds.min.z - margin.z};
+  node.max = {bounds.max.x + margin.x, bounds.max.y + margin.y,
+              bounds.max.z + margin.z};
+
+  InsertLeaf(leaf);
+  return true;
+}
+
+void RR::BoundingVolumeHierarchy::Remove(Entity entity) {
+  int32_t leaf = FindLeaf(entity);
+  if (leaf == kNullNode) {
+    return;
+  }
+
+  RemoveLeaf(leaf);
+  FreeNode(leaf);
+  _leaves[EntityIndex(entity)] = kNullNode;
+  _leaf_count--;
+}
+
+void RR::BoundingVolumeHierarchy::Clear() {
+  _nodes.clear();
+  _leaves.clear();
+  _root = kNullNode;
+  _free_nodes = kNullNode;
+  _leaf_count = 0U;
+}
+
+bool RR::BoundingVolumeHierarchy::Contains(Entity entity) const {
+  return FindLeaf(entity) != kNullNode;
+}
+
+void RR::BoundingVolumeHierarchy::QueryFrustum(
+    const Frustum& frustum, std::vector<Entity>* entities) const {
+  if (_root == kNullNode) {
+    return;
+  }
+
+  // Bit p is set while plane p still has to be tested, subtrees fully
+  // inside every plane are appended without more tests
+  struct Entry {
+    int32_t node;
+    uint32_t planes;
+  };
+
+  std::vector<Entry> stack;
+  stack.push_back({_root, 0x3F});
+
+  while (!stack.empty()) {
+    Entry entry = stack.back();
+    stack.pop_back();
+
+    const Node& node = _nodes[entry.node];
+    bool leaf = node.left == kNullNode;
+    const DirectX::XMFLOAT3& min = leaf ? node.tight_min : node.min;
+    const DirectX::XMFLOAT3& max = leaf ? node.tight_max : node.max;
+
+    float center[3] = {(min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f,
+                       (min.z + max.z) * 0.5f};
+    float extent[3] = {(max.x - min.x) * 0.5f, (max.y - min.y) * 0.5f,
+                       (max.z - min.z) * 0.5f};
+
+    uint32_t planes = entry.planes;
+    bool outside = false;
+    for (uint32_t p = 0; p < 6 && !outside; p++) {
+      if ((planes & (1U << p)) == 0) {
+        continue;
+      }
+
+      const DirectX::XMFLOAT4& plane = frustum.planes[p];
+      float distance = plane.x * center[0] + plane.y * center[1] +
+                       plane.z * center[2] + plane.w;
+      float radius = std::fabs(plane.x) * extent[0] +
+                     std::fabs(plane.y) * extent[1] +
+                     std::fabs(plane.z) * extent[2];
+
+      if (distance + radius < 0.0f) {
+        outside = true;
+      } else if (distance - radius >= 0.0f) {
+        planes &= ~(1U << p);
+      }
+    }
+
+    if (outside) {
+      continue;
+    }
+
+    if (planes == 0) {
+      AppendSubtree(entry.node, entities);
+    } else if (leaf) {
+      entities->push_back(node.entity);
+    } else {
+      stack.push_back({node.left, planes});
+      stack.push_back({node.right, planes});
+    }
+  }
+}
+
+void RR::BoundingVolumeHierarchy::QueryRay(
+    const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction,
+    float max_distance, std::vector<Entity>* entities) const {
+  if (_root == kNullNode) {
+    return;
+  }
+
+  const float origin_axis[3] = {origin.x, origin.y, origin.z};
+  const float direction_axis[3] = {direction.x, direction.y, direction.z};
+
+  // Slab test, parallel axes only hit when the origin is inside the slab
+  auto hit = [&](const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max) {
+    const float min_axis[3] = {min.x, min.y, min.z};
+    const float max_axis[3] = {max.x, max.y, max.z};
+    float near_t = 0.0f;
+    float far_t = max_distance;
+
+    for (uint32_t a = 0; a < 3; a++) {
+      if (direction_axis[a] == 0.0f) {
+        if (origin_axis[a] < min_axis[a] || origin_axis[a] > max_axis[a]) {
+          return false;
+        }
+        continue;
+      }
+
+      float inverse = 1.0f / direction_axis[a];
+      float t0 = (min_axis[a] - origin_axis[a]) * inverse;
+      float t1 = (max_axis[a] - origin_axis[a]) * inverse;
+      if (t0 > t1) {
+        float t = t0;
+        t0 = t1;
+        t1 = t;
+      }
+
+      near_t = t0 > near_t ? t0 : near_t;
+      far_t = t1 < far_t ? t1 : far_t;
+      if (near_t > far_t) {
+        return false;
+      }
+    }
+
+    return true;
+  };
+
+  std::vector<int32_t> stack(1, _root);
+  while (!stack.empty()) {
+    const Node& node = _nodes[stack.back()];
+    stack.pop_back();
+
+    if (node.left == kNullNode) {
+      if (hit(node.tight_min, node.tight_max)) {
+        entities->push_back(node.entity);
+      }
+    } else if (hit(node.min, node.max)) {
+      stack.push_back(node.left);
+      stack.push_back(node.right);
+    }
+  }
+}
+
+void RR::BoundingVolumeHierarchy::QuerySphere(
+    const DirectX::XMFLOAT3& center, float radius,
+    std::vector<Entity>* entities) const {
+  if (_root == kNullNode) {
+    return;
+  }
+
+  // Distance from the center to the closest point of the box
+  auto overlaps = [&](const DirectX::XMFLOAT3& min,
+                      const DirectX::XMFLOAT3& max) {
+    DirectX::XMFLOAT3 closest = Min(Max(center, min), max);
+    float x = closest.x - center.x;
+    float y = closest.y - center.y;
+    float z = closest.z - center.z;
+    return x * x + y * y + z * z <= radius * radius;
+  };
+
+  std::vector<int32_t> stack(1, _root);
+  while (!stack.empty()) {
+    const Node& node = _nodes[stack.back()];
+    stack.pop_back();
+
+    if (node.left == kNullNode) {
+      if (overlaps(node.tight_min, node.tight_max)) {
+        entities->push_back(node.entity);
+      }
+    } else if (overlaps(node.min, node.max)) {
+      stack.push_back(node.left);
+      stack.push_back(node.right);
+    }
+  }
+}
+
+uint32_t RR::BoundingVolumeHierarchy::size() const { return _leaf_count; }
+
+uint32_t RR::BoundingVolumeHierarchy::height() const {
+  return _root != kNullNode ? _nodes[_root].height + 1 : 0U;
+}
+
+bool RR::BoundingVolumeHierarchy::Validate() const {
+  if (_root == kNullNode) {
+    return _leaf_count == 0U;
+  }
+
+  if (_nodes[_root].parent != kNullNode) {
+    return false;
+  }
+
+  uint32_t leaves = 0U;
+  std::vector<int32_t> stack(1, _root);
+  while (!stack.empty()) {
+    int32_t index = stack.back();
+    stack.pop_back();
+    const Node& node = _nodes[index];
+
+    if (node.left == kNullNode) {
+      if (node.right != kNullNode || node.height != 0 ||
+          !Encloses(node.min, node.max, node.tight_min, node.tight_max) ||
+          FindLeaf(node.entity) != index) {
+        return false;
+      }
+
+      leaves++;
+      continue;
+    }
+
+    const Node& left = _nodes[node.left];
+    const Node& right = _nodes[node.right];
+    int32_t tallest = left.height > right.height ? left.height : right.height;
+    if (left.parent != index || right.parent != index ||
+        node.height != tallest + 1 ||
+        !Encloses(node.min, node.max, left.min, left.max) ||
+        !Encloses(node.min, node.max, right.min, right.max)) {
+      return false;
+    }
+
+    stack.push_back(node.left);
+    stack.push_back(node.right);
+  }
+
+  return leaves == _leaf_count;
+}
+
+int32_t RR::BoundingVolumeHierarchy::AllocateNode() {
+  int32_t node = _free_nodes;
+  if (node == kNullNode) {
+    node = _nodes.size();
+    _nodes.push_back(Node());
+  } else {
+    _free_nodes = _nodes[node].parent;
+  }
+
+  _nodes[node] = Node();
+  _nodes[node].parent = kNullNode;
+  _nodes[node].left = kNullNode;
+  _nodes[node].right = kNullNode;
+  _nodes[node].height = 0;
+  _nodes[node].entity = kInvalidEntity;
+  return node;
+}
+
+void RR::BoundingVolumeHierarchy::FreeNode(int32_t node) {
+  _nodes[node].parent = _free_nodes;
+  _nodes[node].height = -1;
+  _free_nodes = node;
+}
+
+int32_t RR::BoundingVolumeHierarchy::FindLeaf(Entity entity) const {
+  uint32_t index = EntityIndex(entity);
+  if (entity == kInvalidEntity || index >= _leaves.size()) {
+    return kNullNode;
+  }
+
+  int32_t leaf = _leaves[index];
+  if (leaf == kNullNode || _nodes[leaf].entity != entity) {
+    return kNullNode;
+  }
+
+  return leaf;
+}
+
+void RR::BoundingVolumeHierarchy::InsertLeaf(int32_t leaf) {
+  if (_root == kNullNode) {
+    _root = leaf;
+    _nodes[leaf].parent = kNullNode;
+    return;
+  }
+
+  // Walks down to the sibling that grows the tree area the least
+  const DirectX::XMFLOAT3 leaf_min = _nodes[leaf].min;
+  const DirectX::XMFLOAT3 leaf_max = _nodes[leaf].max;
+
+  int32_t sibling = _root;
+  while (_nodes[sibling].left != kNullNode) {
+    const Node& node = _nodes[sibling];
+
+    float area = Area(node.min, node.max);
+    float combined = Area(Min(node.min, leaf_min), Max(node.max, leaf_max));
+
+    // Making a new parent here, or pushing the leaf further down which
+    // grows this node anyway
+    float cost = 2.0f * combined;
+    float inheritance = 2.0f * (combined - area);
+
+    float child_cost[2];
+    const int32_t children[2] = {node.left, node.right};
+    for (uint32_t c = 0; c < 2; c++) {
+      const Node& child = _nodes[children[c]];
+      float enlarged =
+          Area(Min(child.min, leaf_min), Max(child.max, leaf_max));
+      child_cost[c] = child.left == kNullNode
+                          ? enlarged + inheritance
+                          : enlarged - Area(child.min, child.max) + inheritance;
+    }
+
+    if (cost < child_cost[0] && cost < child_cost[1]) {
+      break;
+    }
+
+    sibling = child_cost[0] < child_cost[1] ? node.left : node.right;
+  }
+
+  int32_t old_parent = _nodes[sibling].parent;
+  int32_t parent = AllocateNode();
+  _nodes[parent].parent = old_parent;
+  _nodes[parent].min = Min(leaf_min, _nodes[sibling].min);
+  _nodes[parent].max = Max(leaf_max, _nodes[sibling].max);
+  _nodes[parent].height = _nodes[sibling].height + 1;
+  _nodes[parent].left = sibling;
+  _nodes[parent].right = leaf;
+  _nodes[sibling].parent = parent;
+  _nodes[leaf].parent = parent;
+
+  if (old_parent == kNullNode) {
+    _root = parent;
+  } else if (_nodes[old_parent].left == sibling) {
+    _nodes[old_parent].left = parent;
+  } else {
+    _nodes[old_parent].right = parent;
+  }
+
+  // The new parent is unbalanced when the sibling is a tall subtree
+  Refit(parent);
+}
+
+void RR::BoundingVolumeHierarchy::RemoveLeaf(int32_t leaf) {
+  if (leaf == _root) {
+    _root = kNullNode;
+    return;
+  }
+
+  // The sibling takes the place of the parent
+  int32_t parent = _nodes[leaf].parent;
+  int32_t grandparent = _nodes[parent].parent;
+  int32_t sibling = _nodes[parent].left == leaf ? _nodes[parent].right
+                                                : _nodes[parent].left;
+
+  FreeNode(parent);
+  _nodes[sibling].parent = grandparent;
+  _nodes[leaf].parent = kNullNode;
+
+  if (grandparent == kNullNode) {
+    _root = sibling;
+    return;
+  }
+
+  if (_nodes[grandparent].left == parent) {
+    _nodes[grandparent].left = sibling;
+  } else {
+    _nodes[grandparent].right = sibling;
+  }
+
+  Refit(grandparent);
+}
+
+void RR::BoundingVolumeHierarchy::Refit(int32_t node) {
+  while (node != kNullNode) {
+    node = Balance(node);
+
+    Node& current = _nodes[node];
+    const Node& left = _nodes[current.left];
+    const Node& right = _nodes[current.right];
+    current.min = Min(left.min, right.min);
+    current.max = Max(left.max, right.max);
+    current.height = 1 + (left.height > right.height ? left.height
+                                                     : right.height);
+
+    node = current.parent;
+  }
+}
+
+int32_t RR::BoundingVolumeHierarchy::Balance(int32_t a) {
+  // The height of a is stale here, only its children are refit
+  Node& node_a = _nodes[a];
+  if (node_a.left == kNullNode) {
+    return a;
+  }
+
+  int32_t b = node_a.left;
+  int32_t c = node_a.right;
+  int32_t balance = _nodes[c].height - _nodes[b].height;
+
+  if (balance >= -1 && balance <= 1) {
+    return a;
+  }
+
+  // The taller child is promoted, its shorter child is given to a
+  int32_t tall = balance > 0 ? c : b;
+  int32_t other = balance > 0 ? b : c;
+  Node& node_tall = _nodes[tall];
+  int32_t f = node_tall.left;
+  int32_t g = node_tall.right;
+
+  node_tall.left = a;
+  node_tall.parent = node_a.parent;
+  node_a.parent = tall;
+
+  if (node_tall.parent == kNullNode) {
+    _root = tall;
+  } else if (_nodes[node_tall.parent].left == a) {
+    _nodes[node_tall.parent].left = tall;
+  } else {
+    _nodes[node_tall.parent].right = tall;
+  }
+
+  int32_t kept = _nodes[f].height > _nodes[g].height ? f : g;
+  int32_t given = kept == f ? g : f;
+  node_tall.right = kept;
+
+  if (balance > 0) {
+    node_a.right = given;
+  } else {
+    node_a.left = given;
+  }
+  _nodes[given].parent = a;
+
+  node_a.min = Min(_nodes[other].min, _nodes[given].min);
+  node_a.max = Max(_nodes[other].max, _nodes[given].max);
+  node_a.height = 1 + (_nodes[other].height > _nodes[given].height
+                           ? _nodes[other].height
+                           : _nodes[given].height);
+
+  node_tall.min = Min(node_a.min, _nodes[kept].min);
+  node_tall.max = Max(node_a.max, _nodes[kept].max);
+  node_tall.height =
+      1 + (node_a.height > _nodes[kept].height ? node_a.height
+                                               : _nodes[kept].height);
+
+  return tall;
+}
+
+void RR::BoundingVolumeHierarchy::AppendSubtree(
+    int32_t node, std::vector<Entity>* entities) const {
+  std::vector<int32_t> stack(1, node);
+  while (!stack.empty()) {
+    const Node& current = _nodes[stack.back()];
+    stack.pop_back();
+
+    if (current.left == kNullNode) {
+      entities->push_back(current.entity);
+    } else {
+      stack.push_back(current.left);
+      stack.push_back(current.right);
+    }
+  }
+}
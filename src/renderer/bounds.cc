@@ -0,0 +1,173 @@
+#include "renderer/bounds.h"
+
+#include <cfloat>
+
+RR::Bounds RR::EmptyBounds() {
+  Bounds bounds = {};
+  bounds.min = {FLT_MAX, FLT_MAX, FLT_MAX};
+  bounds.max = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+  bounds.center = {0.0f, 0.0f, 0.0f};
+  bounds.radius = -1.0f;
+  return bounds;
+}
+
+bool RR::IsEmpty(const Bounds& bounds) { return bounds.radius < 0.0f; }
+
+RR::Bounds RR::ComputeBounds(const float* vertex_data, size_t vertex_count,
+                             uint32_t stride) {
+  if (vertex_data == nullptr || vertex_count == 0 || stride < 3) {
+    return EmptyBounds();
+  }
+
+  // Vertices with at least four floats are loaded four wide, the extra
+  // lane belongs to the next attribute and is never stored
+  auto load = [vertex_data, stride](size_t vertex) {
+    const float* position = vertex_data + vertex * stride;
+    return stride >= 4
+               ? DirectX::XMLoadFloat4((const DirectX::XMFLOAT4*)position)
+               : DirectX::XMLoadFloat3((const DirectX::XMFLOAT3*)position);
+  };
+
+  // Two accumulators so consecutive min/max don't wait on each other
+  DirectX::XMVECTOR min0 = DirectX::XMVectorReplicate(FLT_MAX);
+  DirectX::XMVECTOR max0 = DirectX::XMVectorReplicate(-FLT_MAX);
+  DirectX::XMVECTOR min1 = min0;
+  DirectX::XMVECTOR max1 = max0;
+
+  size_t i = 0;
+  for (; i + 1 < vertex_count; i += 2) {
+    DirectX::XMVECTOR p0 = load(i);
+    DirectX::XMVECTOR p1 = load(i + 1);
+    min0 = DirectX::XMVectorMin(min0, p0);
+    max0 = DirectX::XMVectorMax(max0, p0);
+    min1 = DirectX::XMVectorMin(min1, p1);
+    max1 = DirectX::XMVectorMax(max1, p1);
+  }
+
+  if (i < vertex_count) {
+    DirectX::XMVECTOR p = load(i);
+    min0 = DirectX::XMVectorMin(min0, p);
+    max0 = DirectX::XMVectorMax(max0, p);
+  }
+
+  DirectX::XMVECTOR min = DirectX::XMVectorMin(min0, min1);
+  DirectX::XMVECTOR max = DirectX::XMVectorMax(max0, max1);
+  DirectX::XMVECTOR center = DirectX::XMVectorScale(
+      DirectX::XMVectorAdd(min, max), 0.5f);
+
+  // Sphere around the box center, tighter than the box corners
+  DirectX::XMVECTOR radius0 = DirectX::XMVectorZero();
+  DirectX::XMVECTOR radius1 = DirectX::XMVectorZero();
+  for (i = 0; i + 1 < vertex_count; i += 2) {
+    radius0 = DirectX::XMVectorMax(
+        radius0,
+        DirectX::XMVector3LengthSq(DirectX::XMVectorSubtract(load(i), center)));
+    radius1 = DirectX::XMVectorMax(
+        radius1, DirectX::XMVector3LengthSq(
+                     DirectX::XMVectorSubtract(load(i + 1), center)));
+  }
+
+  if (i < vertex_count) {
+    radius0 = DirectX::XMVectorMax(
+        radius0,
+        DirectX::XMVector3LengthSq(DirectX::XMVectorSubtract(load(i), center)));
+  }
+
+  Bounds bounds = {};
+  DirectX::XMStoreFloat3(&bounds.min, min);
+  DirectX::XMStoreFloat3(&bounds.max, max);
+  DirectX::XMStoreFloat3(&bounds.center, center);
+  bounds.radius = DirectX::XMVectorGetX(
+      DirectX::XMVectorSqrt(DirectX::XMVectorMax(radius0, radius1)));
+  return bounds;
+}
+
+RR::Bounds RR::MergeBounds(const Bounds& a, const Bounds& b) {
+  if (IsEmpty(a)) {
+    return b;
+  }
+
+  if (IsEmpty(b)) {
+    return a;
+  }
+
+  Bounds bounds = {};
+  DirectX::XMStoreFloat3(
+      &bounds.min, DirectX::XMVectorMin(DirectX::XMLoadFloat3(&a.min),
+                                        DirectX::XMLoadFloat3(&b.min)));
+  DirectX::XMStoreFloat3(
+      &bounds.max, DirectX::XMVectorMax(DirectX::XMLoadFloat3(&a.max),
+                                        DirectX::XMLoadFloat3(&b.max)));
+
+  DirectX::XMVECTOR center_a = DirectX::XMLoadFloat3(&a.center);
+  DirectX::XMVECTOR offset =
+      DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&b.center), center_a);
+  float distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(offset));
+
+  // One sphere may already hold the other
+  if (distance + b.radius <= a.radius) {
+    bounds.center = a.center;
+    bounds.radius = a.radius;
+    return bounds;
+  }
+
+  if (distance + a.radius <= b.radius) {
+    bounds.center = b.center;
+    bounds.radius = b.radius;
+    return bounds;
+  }
+
+  bounds.radius = (distance + a.radius + b.radius) * 0.5f;
+  DirectX::XMStoreFloat3(
+      &bounds.center,
+      DirectX::XMVectorAdd(
+          center_a,
+          DirectX::XMVectorScale(offset, (bounds.radius - a.radius) / distance)));
+  return bounds;
+}
+
+RR::Bounds RR::TransformBounds(const Bounds& bounds,
+                               const DirectX::XMFLOAT4X4& world) {
+  if (IsEmpty(bounds)) {
+    return bounds;
+  }
+
+  DirectX::XMMATRIX matrix = DirectX::XMLoadFloat4x4(&world);
+  DirectX::XMVECTOR min = DirectX::XMLoadFloat3(&bounds.min);
+  DirectX::XMVECTOR max = DirectX::XMLoadFloat3(&bounds.max);
+  DirectX::XMVECTOR extents =
+      DirectX::XMVectorScale(DirectX::XMVectorSubtract(max, min), 0.5f);
+
+  // Box center is transformed, the extents of the rotated box are the
+  // extents projected on the absolute value of every axis
+  DirectX::XMVECTOR center = DirectX::XMVector3Transform(
+      DirectX::XMVectorScale(DirectX::XMVectorAdd(min, max), 0.5f), matrix);
+  DirectX::XMVECTOR world_extents = DirectX::XMVectorMultiply(
+      DirectX::XMVectorSplatX(extents), DirectX::XMVectorAbs(matrix.r[0]));
+  world_extents = DirectX::XMVectorMultiplyAdd(
+      DirectX::XMVectorSplatY(extents), DirectX::XMVectorAbs(matrix.r[1]),
+      world_extents);
+  world_extents = DirectX::XMVectorMultiplyAdd(
+      DirectX::XMVectorSplatZ(extents), DirectX::XMVectorAbs(matrix.r[2]),
+      world_extents);
+
+  Bounds transformed = {};
+  DirectX::XMStoreFloat3(&transformed.min,
+                         DirectX::XMVectorSubtract(center, world_extents));
+  DirectX::XMStoreFloat3(&transformed.max,
+                         DirectX::XMVectorAdd(center, world_extents));
+
+  // The sphere grows with the largest axis scale
+  DirectX::XMVECTOR scale = DirectX::XMVectorMax(
+      DirectX::XMVector3LengthSq(matrix.r[0]),
+      DirectX::XMVectorMax(DirectX::XMVector3LengthSq(matrix.r[1]),
+                           DirectX::XMVector3LengthSq(matrix.r[2])));
+  DirectX::XMStoreFloat3(
+      &transformed.center,
+      DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&bounds.center),
+                                  matrix));
+  transformed.radius =
+      bounds.radius *
+      DirectX::XMVectorGetX(DirectX::XMVectorSqrt(scale));
+  return transformed;
+}
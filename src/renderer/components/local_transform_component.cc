@@ -1,52 +1,95 @@
 #include "renderer/components/local_transform_component.h"
 
-#include "renderer/entity.h"
+#include <math.h>
+
 #include "renderer/components/entity_component.h"
 
 RR::LocalTransform::LocalTransform() {
-  level = 0;
-  parent = nullptr;
+  parent = kInvalidEntity;
 
-  position = {0.0f, 0.0f, 0.0f};
-  rotation = {0.0f, 0.0f, 0.0f};
-  scale = {1.0f, 1.0f, 1.0f};
+  _position = {0.0f, 0.0f, 0.0f};
+  _quaternion = {0.0f, 0.0f, 0.0f, 1.0f};
+  _rotation = {0.0f, 0.0f, 0.0f};
+  _scale = {1.0f, 1.0f, 1.0f};
 }
 
-void RR::LocalTransform::SetParent(std::shared_ptr<Entity> parent) {
-  if (parent == nullptr) {
-    level = 0;
-    parent = nullptr;
-    return;
-  }
+const DirectX::XMFLOAT3& RR::LocalTransform::position() const {
+  return _position;
+}
 
-  if (parent->_components.count(kComponentType_LocalTransform) == 0) {
-    return;
+const DirectX::XMFLOAT3& RR::LocalTransform::rotation() const {
+  if (!_rotation_outdated) {
+    return _rotation;
   }
 
-  std::shared_ptr<LocalTransform> parent_transform =
-      std::static_pointer_cast<LocalTransform, EntityComponent>(
-          parent->_components[kComponentType_LocalTransform]);
+  // Angles of Rx * Ry * Rz, the matrix built from the quaternion:
+  // m02 = -sin y, m01 / m00 = tan z, m12 / m22 = tan x
+  DirectX::XMFLOAT4X4 m;
+  DirectX::XMStoreFloat4x4(&m, DirectX::XMMatrixRotationQuaternion(
+                                   DirectX::XMLoadFloat4(&_quaternion)));
 
-  if (parent_transform == nullptr) {
-    return;
-  }
+  float sin_y = -m._13;
+  sin_y = sin_y > 1.0f ? 1.0f : (sin_y < -1.0f ? -1.0f : sin_y);
 
-  if (parent_transform.get() == this) {
-    return;
+  float x, z;
+  if (fabsf(sin_y) < 0.9999f) {
+    x = atan2f(m._23, m._33);
+    z = atan2f(m._12, m._11);
+  } else {
+    // Gimbal lock, only x + z or x - z is known so z is taken as 0
+    x = atan2f(m._21 * sin_y, m._22);
+    z = 0.0f;
   }
 
-  if (parent_transform->parent != nullptr) {
-    std::shared_ptr<LocalTransform> parent_parent_transform =
-        std::static_pointer_cast<LocalTransform, EntityComponent>(
-            parent_transform->parent
-                ->_components[kComponentType_LocalTransform]);
+  _rotation = {DirectX::XMConvertToDegrees(x),
+               DirectX::XMConvertToDegrees(asinf(sin_y)),
+               DirectX::XMConvertToDegrees(z)};
+  _rotation_outdated = false;
 
-    if (parent_parent_transform.get() == this) {
-      return;
-    }
-  }
-   
+  return _rotation;
+}
+
+const DirectX::XMFLOAT4& RR::LocalTransform::quaternion() const {
+  return _quaternion;
+}
+
+const DirectX::XMFLOAT3& RR::LocalTransform::scale() const { return _scale; }
 
-  level = parent_transform->level + 1;
-  this->parent = parent;
-}
\ No newline at end of file
+void RR::LocalTransform::SetPosition(const DirectX::XMFLOAT3& position) {
+  _position = position;
+  _dirty = true;
+}
+
+void RR::LocalTransform::SetRotation(const DirectX::XMFLOAT3& rotation) {
+  DirectX::XMVECTOR x = DirectX::XMQuaternionRotationNormal(
+      DirectX::XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f),
+      DirectX::XMConvertToRadians(rotation.x));
+  DirectX::XMVECTOR y = DirectX::XMQuaternionRotationNormal(
+      DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f),
+      DirectX::XMConvertToRadians(rotation.y));
+  DirectX::XMVECTOR z = DirectX::XMQuaternionRotationNormal(
+      DirectX::XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f),
+      DirectX::XMConvertToRadians(rotation.z));
+
+  // XMQuaternionMultiply(a, b) rotates by a first, same order as the
+  // rotation matrices
+  DirectX::XMStoreFloat4(
+      &_quaternion,
+      DirectX::XMQuaternionMultiply(DirectX::XMQuaternionMultiply(x, y), z));
+
+  _rotation = rotation;
+  _rotation_outdated = false;
+  _dirty = true;
+}
+
+void RR::LocalTransform::SetQuaternion(const DirectX::XMFLOAT4& quaternion) {
+  DirectX::XMStoreFloat4(&_quaternion, DirectX::XMQuaternionNormalize(
+                                           DirectX::XMLoadFloat4(&quaternion)));
+  _rotation_outdated = true;
+  _dirty = true;
+}
+
+void RR::LocalTransform::SetScale(const DirectX::XMFLOAT3& scale) {
+  _scale = scale;
+  _dirty = true;
+}
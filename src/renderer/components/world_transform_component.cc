@@ -5,6 +5,7 @@
 
 RR::WorldTransform::WorldTransform() {
   DirectX::XMStoreFloat4x4(&world, DirectX::XMMatrixIdentity());
+  bounds = EmptyBounds();
 }
 
 DirectX::XMFLOAT3 RR::WorldTransform::forward() { 
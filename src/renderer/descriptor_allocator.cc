@@ -0,0 +1,79 @@
+#include "renderer/descriptor_allocator.h"
+
+void RR::DescriptorAllocator::Init(uint32_t capacity) {
+  _capacity = capacity;
+  _allocated = 0U;
+  _free_ranges.clear();
+
+  if (capacity != 0) {
+    _free_ranges[0] = capacity;
+  }
+}
+
+uint32_t RR::DescriptorAllocator::Allocate(uint32_t count) {
+  if (count == 0) {
+    return kInvalidDescriptor;
+  }
+
+  for (std::map<uint32_t, uint32_t>::iterator it = _free_ranges.begin();
+       it != _free_ranges.end(); it++) {
+    if (it->second < count) {
+      continue;
+    }
+
+    // Taken from the front, the rest stays free
+    uint32_t first = it->first;
+    uint32_t remaining = it->second - count;
+    _free_ranges.erase(it);
+    if (remaining != 0) {
+      _free_ranges[first + count] = remaining;
+    }
+
+    _allocated += count;
+    return first;
+  }
+
+  return kInvalidDescriptor;
+}
+
+void RR::DescriptorAllocator::Free(uint32_t first, uint32_t count) {
+  if (first == kInvalidDescriptor || count == 0 ||
+      (uint64_t)first + count > _capacity) {
+    return;
+  }
+
+  uint32_t freed = count;
+  std::map<uint32_t, uint32_t>::iterator next = _free_ranges.lower_bound(first);
+
+  // Freeing slots that are already free would corrupt the ranges
+  if (next != _free_ranges.end() && next->first < first + count) {
+    return;
+  }
+
+  if (next != _free_ranges.begin()) {
+    std::map<uint32_t, uint32_t>::iterator previous = next;
+    previous--;
+
+    if (previous->first + previous->second > first) {
+      return;
+    }
+
+    if (previous->first + previous->second == first) {
+      first = previous->first;
+      count += previous->second;
+      _free_ranges.erase(previous);
+    }
+  }
+
+  if (next != _free_ranges.end() && next->first == first + count) {
+    count += next->second;
+    _free_ranges.erase(next);
+  }
+
+  _free_ranges[first] = count;
+  _allocated -= freed;
+}
+
+uint32_t RR::DescriptorAllocator::capacity() const { return _capacity; }
+
+uint32_t RR::DescriptorAllocator::allocated() const { return _allocated; }
@@ -2,8 +2,10 @@
 
 #include "Imgui/imgui.h"
 
+#include "renderer/world.h"
 #include "renderer/entity.h"
 #include "renderer/common.hpp"
+#include "renderer/occlusion_culler.h"
 #include "renderer/graphics/geometry.h"
 #include "renderer/graphics/pipeline.h"
 #include "renderer/graphics/texture.h"
@@ -12,10 +14,19 @@
 #include "renderer/components/renderer_component.h"
 #include "renderer/components/local_transform_component.h"
 
+// Depths pile up close to 1, raising them spreads the near range
+static ImU32 DepthColor(float depth) {
+  for (int i = 0; i < 5; i++) {
+    depth *= depth;
+  }
+  int gray = (int)((1.0f - depth) * 255.0f);
+  return IM_COL32(gray, gray, gray, 255);
+}
+
 static void AddHierarchyTreeNode(
-    std::map<std::shared_ptr<RR::Entity>, std::list<std::shared_ptr<RR::Entity>>>& parent_child, 
-    std::shared_ptr<RR::Entity> entity, std::shared_ptr<RR::Entity> selected_entity,
-    ImGuiTreeNodeFlags base_flags, std::shared_ptr<RR::Entity>* node_clicked, int* id) {
+    std::map<RR::Entity, std::list<RR::Entity>>& parent_child, 
+    RR::Entity entity, RR::Entity selected_entity,
+    ImGuiTreeNodeFlags base_flags, RR::Entity* node_clicked, int* id) {
 
   ImGuiTreeNodeFlags node_flags = base_flags;
   const bool is_selected = entity == selected_entity;
@@ -40,7 +51,7 @@ static void AddHierarchyTreeNode(
 
   if (node_open && ((node_flags & ImGuiTreeNodeFlags_Leaf) == 0)) {
     if (parent_child[entity].size() != 0) {
-      for (std::list<std::shared_ptr<RR::Entity>>::iterator i = parent_child[entity].begin();
+      for (std::list<RR::Entity>::iterator i = parent_child[entity].begin();
            i != parent_child[entity].end(); i++) {
         AddHierarchyTreeNode(parent_child, *i, selected_entity, base_flags, node_clicked, id);
       }      
@@ -50,41 +61,43 @@ static void AddHierarchyTreeNode(
 }
 
 void RR::Editor::ShowEditor(
-  std::list<std::shared_ptr<RR::Entity>>* entities,
+  RR::World* world,
   std::map<uint32_t, RR::GFX::Pipeline>* pipelines,
   const std::vector<RR::GFX::Geometry>* geometries,
-  const std::vector<RR::GFX::Texture>* textures) {
+  const std::vector<RR::GFX::Texture>* textures,
+  RR::OcclusionCuller* occlusion_culler) {
 
   bool editor = true;
 
   ImGui::Begin("Hierarchy", &editor);
-  std::map<std::shared_ptr<RR::Entity>, std::list<std::shared_ptr<RR::Entity>>> parent_child;
-  for (std::list<std::shared_ptr<RR::Entity>>::iterator i = entities->begin();
-    i != entities->end(); i++) {
-    
-    std::shared_ptr<RR::LocalTransform> lt = 
-      std::static_pointer_cast<RR::LocalTransform>(
-        i->get()->GetComponent(RR::ComponentTypes::kComponentType_LocalTransform));
-  
-    if (lt != nullptr && lt->parent != nullptr) {
-      parent_child[lt->parent].push_back(*i);
-    } else {
-      parent_child[*i] = std::list<std::shared_ptr<RR::Entity>>(0);
+  std::map<RR::Entity, std::list<RR::Entity>> parent_child;
+  std::vector<RR::Archetype>& archetypes = world->archetypes();
+  for (size_t i = 0; i < archetypes.size(); i++) {
+    for (uint32_t row = 0; row < archetypes[i].size(); row++) {
+      RR::Entity entity = archetypes[i].entities[row];
+      RR::LocalTransform* lt = archetypes[i].Get<RR::LocalTransform>(row);
+
+      if (lt != nullptr && world->IsValid(lt->parent)) {
+        parent_child[lt->parent].push_back(entity);
+      } else {
+        // Don't clear the children already found for this entity
+        parent_child.insert(std::make_pair(entity, std::list<RR::Entity>(0)));
+      }
     }
   }
   
   ImGuiTreeNodeFlags base_flags =
       ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_OpenOnDoubleClick |
       ImGuiTreeNodeFlags_SpanAvailWidth;
-  std::shared_ptr<RR::Entity> node_clicked = nullptr;
+  RR::Entity node_clicked = RR::kInvalidEntity;
   
   int id = 0;
-  for (std::map<std::shared_ptr<RR::Entity>, std::list<std::shared_ptr<RR::Entity>>>::iterator i = parent_child.begin();
+  for (std::map<RR::Entity, std::list<RR::Entity>>::iterator i = parent_child.begin();
        i != parent_child.end(); i++) {
     AddHierarchyTreeNode(parent_child, i->first, _selected_entity, base_flags, &node_clicked, &id);
   }
   
-  if (node_clicked != nullptr) {
+  if (node_clicked != RR::kInvalidEntity) {
     _selected_entity = node_clicked;
   }
   
@@ -92,34 +105,43 @@ void RR::Editor::ShowEditor(
 
   ImGui::Begin("Details", &editor);
 
-  if (_selected_entity != nullptr) {
+  if (world->IsValid(_selected_entity)) {
     for (uint32_t i = 0; i < RR::ComponentTypes::kComponentTYpe_Count; i++) {
       switch (i) {
         case RR::ComponentTypes::kComponentType_LocalTransform: {
-          std::shared_ptr<RR::LocalTransform> lt =
-              std::static_pointer_cast<RR::LocalTransform>(
-                  _selected_entity->GetComponent(i));
+          RR::LocalTransform* lt = world->GetComponent<RR::LocalTransform>(_selected_entity);
 
           if (lt == nullptr) {
             break;
           }
 
+          DirectX::XMFLOAT3 position = lt->position();
+          DirectX::XMFLOAT3 rotation = lt->rotation();
+          DirectX::XMFLOAT3 scale = lt->scale();
+
           ImGui::SeparatorText("Local Transform");
-          ImGui::DragFloat3("Position", &lt->position.x, .01f);
-          ImGui::DragFloat3("Rotation", &lt->rotation.x, .01f);
-          ImGui::DragFloat3("Scale", &lt->scale.x, .01f);
+          if (ImGui::DragFloat3("Position", &position.x, .01f)) {
+            lt->SetPosition(position);
+          }
+
+          if (ImGui::DragFloat3("Rotation", &rotation.x, .01f)) {
+            lt->SetRotation(rotation);
+          }
+
+          if (ImGui::DragFloat3("Scale", &scale.x, .01f)) {
+            lt->SetScale(scale);
+          }
           break;
         }
         case RR::ComponentTypes::kComponentType_Renderer: {
-          std::shared_ptr<RR::RendererComponent> rc =
-              std::static_pointer_cast<RR::RendererComponent>(
-                  _selected_entity->GetComponent(i));
+          RR::RendererComponent* rc = world->GetComponent<RR::RendererComponent>(_selected_entity);
 
           if (rc == nullptr) {
             break;
           }
 
           ImGui::SeparatorText("Renderer Component");
+          ImGui::Checkbox("Occluder", &rc->occluder);
           switch (rc->_pipeline_type) { 
             case RR::PipelineTypes::kPipelineType_PBR: {
               ImGui::Text("Pipeline: PBR");
@@ -137,9 +159,7 @@ void RR::Editor::ShowEditor(
           break;
         }
         case RR::ComponentTypes::kComponentType_Camera: {
-          std::shared_ptr<RR::Camera> camera =
-              std::static_pointer_cast<RR::Camera>(
-                  _selected_entity->GetComponent(i));
+          RR::Camera* camera = world->GetComponent<RR::Camera>(_selected_entity);
 
           if (camera == nullptr) {
             break;
@@ -170,4 +190,46 @@ void RR::Editor::ShowEditor(
                    0.01f);
 
   ImGui::End();
-}
\ No newline at end of file
+
+  ImGui::Begin("Occlusion culling", NULL);
+  ImGui::Checkbox("Enabled", &occlusion_culler->enabled);
+  const uint32_t kMinInterval = 1;
+  const uint32_t kMaxInterval = 16;
+  ImGui::SliderScalar("Retest interval", ImGuiDataType_U32,
+                      &occlusion_culler->retest_interval, &kMinInterval,
+                      &kMaxInterval);
+  ImGui::Text("Occluder triangles: %u", occlusion_culler->triangle_count());
+  ImGui::Checkbox("Show pixels", &_show_occlusion_pixels);
+
+  // Drawn 2x2 pixels per buffer pixel, or the same area per tile
+  const float kScale = 2.0f;
+  ImVec2 origin = ImGui::GetCursorScreenPos();
+  ImDrawList* draw_list = ImGui::GetWindowDrawList();
+  if (_show_occlusion_pixels) {
+    const float* depth = occlusion_culler->depth();
+    for (uint32_t y = 0; y < RR::OcclusionCuller::kHeight; y += 2) {
+      for (uint32_t x = 0; x < RR::OcclusionCuller::kWidth; x += 2) {
+        ImVec2 min(origin.x + x * kScale, origin.y + y * kScale);
+        ImVec2 max(min.x + 2.0f * kScale, min.y + 2.0f * kScale);
+        draw_list->AddRectFilled(
+            min, max,
+            DepthColor(depth[y * RR::OcclusionCuller::kWidth + x]));
+      }
+    }
+  } else {
+    const float* tile_depth = occlusion_culler->tile_depth();
+    const float tile_size = RR::OcclusionCuller::kTileSize * kScale;
+    for (uint32_t y = 0; y < RR::OcclusionCuller::kTilesY; y++) {
+      for (uint32_t x = 0; x < RR::OcclusionCuller::kTilesX; x++) {
+        ImVec2 min(origin.x + x * tile_size, origin.y + y * tile_size);
+        ImVec2 max(min.x + tile_size, min.y + tile_size);
+        draw_list->AddRectFilled(
+            min, max,
+            DepthColor(tile_depth[y * RR::OcclusionCuller::kTilesX + x]));
+      }
+    }
+  }
+  ImGui::Dummy(ImVec2(RR::OcclusionCuller::kWidth * kScale,
+                      RR::OcclusionCuller::kHeight * kScale));
+  ImGui::End();
+}
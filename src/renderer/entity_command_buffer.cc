@@ -0,0 +1,122 @@
+#include "renderer/entity_command_buffer.h"
+
+#include <algorithm>
+
+#include "Minitrace/minitrace.h"
+
+#include "renderer/logger.h"
+#include "renderer/renderer.h"
+#include "renderer/world.h"
+
+static RR::Entity Resolve(RR::Entity entity,
+                          const std::vector<RR::Entity>& created) {
+  if (entity == RR::kInvalidEntity ||
+      RR::EntityGeneration(entity) != RR::kPendingEntityGeneration) {
+    return entity;
+  }
+
+  uint32_t index = RR::EntityIndex(entity);
+  return index < created.size() ? created[index] : RR::kInvalidEntity;
+}
+
+RR::Entity RR::EntityCommandBuffer::CreateEntity(uint32_t component_types) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_pending_entities >= kMaxEntities) {
+    return kInvalidEntity;
+  }
+
+  Entity entity = MakeEntity(_pending_entities++, kPendingEntityGeneration);
+  _commands.push_back({kCommandType_Create, (uint32_t)_commands.size(),
+                       entity, component_types});
+
+  return entity;
+}
+
+void RR::EntityCommandBuffer::DestroyEntity(Entity entity) {
+  Push(kCommandType_Destroy, entity, 0U);
+}
+
+void RR::EntityCommandBuffer::AddComponents(Entity entity,
+                                            uint32_t component_types) {
+  Push(kCommandType_AddComponents, entity, component_types);
+}
+
+void RR::EntityCommandBuffer::SetParent(Entity entity, Entity parent) {
+  Push(kCommandType_SetParent, entity, parent);
+}
+
+void RR::EntityCommandBuffer::Playback(Renderer* renderer) {
+  std::vector<Command> commands;
+  uint32_t pending_entities = 0;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    commands.swap(_commands);
+    pending_entities = _pending_entities;
+    _pending_entities = 0;
+  }
+
+  if (commands.empty()) {
+    return;
+  }
+
+  MTR_BEGIN("Renderer", "Entity commands playback");
+  // Pending handles sort by creation order, everything else by entity and
+  // then by recording order for the same entity
+  std::sort(commands.begin(), commands.end(),
+            [](const Command& a, const Command& b) {
+              if (a.type != b.type) {
+                return a.type < b.type;
+              }
+
+              if (a.entity != b.entity) {
+                return a.entity < b.entity;
+              }
+
+              return a.sequence < b.sequence;
+            });
+
+  std::vector<Entity> created(pending_entities, kInvalidEntity);
+  World* world = renderer->world();
+
+  for (size_t i = 0; i < commands.size(); i++) {
+    const Command& command = commands[i];
+    Entity entity = Resolve(command.entity, created);
+
+    switch (command.type) {
+      case kCommandType_Create:
+        created[EntityIndex(command.entity)] =
+            renderer->RegisterEntity(command.argument);
+        break;
+      case kCommandType_AddComponents:
+        world->AddComponents(entity, command.argument);
+        break;
+      case kCommandType_SetParent: {
+        Entity parent = Resolve(command.argument, created);
+        if (parent == kInvalidEntity && command.argument != kInvalidEntity) {
+          LOG_WARNING("RR", "Parent was never created, skipping SetParent");
+          break;
+        }
+
+        world->SetParent(entity, parent);
+        break;
+      }
+      case kCommandType_Destroy:
+        renderer->DestroyEntity(entity);
+        break;
+    }
+  }
+
+  MTR_END("Renderer", "Entity commands playback");
+  MTR_COUNTER("Renderer", "Entity commands", commands.size());
+}
+
+uint32_t RR::EntityCommandBuffer::size() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _commands.size();
+}
+
+void RR::EntityCommandBuffer::Push(uint32_t type, Entity entity,
+                                   uint32_t argument) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _commands.push_back({type, (uint32_t)_commands.size(), entity, argument});
+}
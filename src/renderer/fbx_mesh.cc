@@ -0,0 +1,122 @@
+#include "renderer/fbx_mesh.h"
+
+#include "OpenFBX/ofbx.h"
+
+uint32_t RR::ExpandFbxGeometry(const ofbx::Geometry& geometry,
+                               std::vector<FbxSubmesh>* submeshes) {
+  const ofbx::Vec3* vertices = geometry.getVertices();
+  const ofbx::Vec3* normals = geometry.getNormals();
+  const ofbx::Vec2* uvs = geometry.getUVs();
+  const ofbx::Vec3* tangents = geometry.getTangents();
+  const int* material_indices = geometry.getMaterials();
+  int triangle_count = geometry.getIndexCount() / 3;
+
+  bool has_normals = normals != nullptr;
+  bool has_uvs = uvs != nullptr;
+  bool has_tangents = tangents != nullptr;
+
+  int normals_offset = (has_normals ? 3 : 0);
+  int tangents_offset = normals_offset + (has_tangents || has_uvs ? 3 : 0);
+  int uvs_offset = tangents_offset + (has_uvs ? 3 : 0);
+  int vertex_offset = 3 + (has_normals ? 3 : 0) +
+                      (has_tangents || has_uvs ? 3 : 0) + (has_uvs ? 2 : 0);
+
+  int first_triangle = 0;
+  while (first_triangle < triangle_count) {
+    int material =
+        material_indices == nullptr ? 0 : material_indices[first_triangle];
+    int last_triangle = first_triangle + 1;
+    while (last_triangle < triangle_count && material_indices != nullptr &&
+           material_indices[last_triangle] == material) {
+      last_triangle++;
+    }
+
+    submeshes->emplace_back();
+    FbxSubmesh& submesh = submeshes->back();
+    submesh.material = material;
+
+    // FBX vertices are already one per corner
+    int first = first_triangle * 3;
+    int count = (last_triangle - first_triangle) * 3;
+    std::vector<float>& vertex_data = submesh.data.vertex_data;
+    std::vector<uint32_t>& index_data = submesh.data.index_data;
+    vertex_data.resize(count * vertex_offset);
+    index_data.resize(count);
+
+    for (int k = 0; k < count; k++) {
+      const int source = first + k;
+      float* vertex = &vertex_data[k * vertex_offset];
+      index_data[k] = k;
+      vertex[0] = (float)vertices[source].x;
+      vertex[1] = (float)vertices[source].y;
+      vertex[2] = (float)vertices[source].z;
+
+      if (has_normals) {
+        vertex[normals_offset] = (float)normals[source].x;
+        vertex[normals_offset + 1] = (float)normals[source].y;
+        vertex[normals_offset + 2] = (float)normals[source].z;
+      }
+
+      if (has_tangents) {
+        vertex[tangents_offset] = (float)tangents[source].x;
+        vertex[tangents_offset + 1] = (float)tangents[source].y;
+        vertex[tangents_offset + 2] = (float)tangents[source].z;
+      } else if (has_uvs && (k + 1) % 3 == 0) {
+        // Last corner of a triangle, the three share its tangent
+        const ofbx::Vec3& p1 = vertices[source - 2];
+        const ofbx::Vec3& p2 = vertices[source - 1];
+        const ofbx::Vec3& p3 = vertices[source];
+
+        const ofbx::Vec2& uv1 = uvs[source - 2];
+        const ofbx::Vec2& uv2 = uvs[source - 1];
+        const ofbx::Vec2& uv3 = uvs[source];
+
+        float edge1x = (float)(p2.x - p1.x);
+        float edge1y = (float)(p2.y - p1.y);
+        float edge1z = (float)(p2.z - p1.z);
+
+        float edge2x = (float)(p3.x - p1.x);
+        float edge2y = (float)(p3.y - p1.y);
+        float edge2z = (float)(p3.z - p1.z);
+
+        float delta_uv1x = (float)(uv2.x - uv1.x);
+        float delta_uv1y = (float)(uv2.y - uv1.y);
+
+        float delta_uv2x = (float)(uv3.x - uv1.x);
+        float delta_uv2y = (float)(uv3.y - uv1.y);
+
+        float f = (delta_uv1x * delta_uv2y - delta_uv2x * delta_uv1y);
+        f = 1.0f / (f == 0.0f ? 1.0f : f);
+
+        float tangent_x = f * (delta_uv2y * edge1x - delta_uv1y * edge2x);
+        float tangent_y = f * (delta_uv2y * edge1y - delta_uv1y * edge2y);
+        float tangent_z = f * (delta_uv2y * edge1z - delta_uv1y * edge2z);
+
+        for (int corner = k - 2; corner <= k; corner++) {
+          float* tangent =
+              &vertex_data[corner * vertex_offset + tangents_offset];
+          tangent[0] = tangent_x;
+          tangent[1] = tangent_y;
+          tangent[2] = tangent_z;
+        }
+      }
+
+      if (has_uvs) {
+        vertex[uvs_offset] = (float)uvs[source].x;
+        vertex[uvs_offset + 1] = 1.0f - (float)uvs[source].y;
+      }
+    }
+
+    first_triangle = last_triangle;
+  }
+
+  if (has_normals && has_uvs) {
+    return kGeometryType_Positions_Normals_Tangents_UV;
+  }
+
+  if (has_normals) {
+    return kGeometryType_Positions_Normals;
+  }
+
+  return kGeometryType_None;
+}
@@ -0,0 +1,190 @@
+#include "renderer/frustum_culling.h"
+
+#include <cmath>
+
+#include "renderer/transform_kernel.h"
+
+// Same instruction set selection as the transform kernel, whose width
+// also tells which one the cpu supports
+#if !defined(_XM_NO_INTRINSICS_) && \
+    (defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__))
+#define RR_CULLING_SSE 1
+#include <immintrin.h>
+#endif
+
+#if defined(RR_CULLING_SSE) && (defined(_MSC_VER) || defined(__AVX2__))
+#define RR_CULLING_AVX2 1
+#endif
+
+RR::Frustum RR::ExtractFrustum(const DirectX::XMFLOAT4X4& view_projection) {
+  const float (*m)[4] = view_projection.m;
+
+  // Clip coordinates are p * m, so every plane is a combination of the
+  // columns of m: -w <= x <= w, -w <= y <= w and 0 <= z <= w
+  float planes[6][4];
+  for (uint32_t c = 0; c < 4; c++) {
+    planes[0][c] = m[c][3] + m[c][0];
+    planes[1][c] = m[c][3] - m[c][0];
+    planes[2][c] = m[c][3] + m[c][1];
+    planes[3][c] = m[c][3] - m[c][1];
+    planes[4][c] = m[c][2];
+    planes[5][c] = m[c][3] - m[c][2];
+  }
+
+  Frustum frustum = {};
+  for (uint32_t p = 0; p < 6; p++) {
+    float length = std::sqrt(planes[p][0] * planes[p][0] +
+                             planes[p][1] * planes[p][1] +
+                             planes[p][2] * planes[p][2]);
+    float scale = length > 0.0f ? 1.0f / length : 0.0f;
+    frustum.planes[p] = {planes[p][0] * scale, planes[p][1] * scale,
+                         planes[p][2] * scale, planes[p][3] * scale};
+  }
+
+  return frustum;
+}
+
+uint32_t RR::CullBoxesScalar(const Frustum& frustum, const BoxStreams& boxes,
+                             uint32_t begin, uint32_t end,
+                             uint32_t* visible) {
+  uint32_t count = 0;
+  for (uint32_t i = begin; i < end; i++) {
+    bool inside = boxes.extent_x[i] >= 0.0f;
+
+    // The box is outside when even its corner furthest along the plane
+    // normal is behind the plane
+    for (uint32_t p = 0; p < 6 && inside; p++) {
+      const DirectX::XMFLOAT4& plane = frustum.planes[p];
+      float distance = plane.x * boxes.center_x[i] +
+                       plane.y * boxes.center_y[i] +
+                       plane.z * boxes.center_z[i] + plane.w;
+      float radius = std::fabs(plane.x) * boxes.extent_x[i] +
+                     std::fabs(plane.y) * boxes.extent_y[i] +
+                     std::fabs(plane.z) * boxes.extent_z[i];
+      inside = distance + radius >= 0.0f;
+    }
+
+    // Always written, only kept when visible so there is no branch
+    visible[count] = i;
+    count += inside ? 1 : 0;
+  }
+
+  return count;
+}
+
+#ifdef RR_CULLING_SSE
+namespace {
+struct Vec4 {
+  static const uint32_t kWidth = 4;
+  __m128 v;
+
+  static Vec4 Load(const float* p) { return {_mm_loadu_ps(p)}; }
+  static Vec4 Set(float f) { return {_mm_set1_ps(f)}; }
+  // Lane i of the result is set when a[i] >= b[i]
+  static uint32_t GreaterEqual(Vec4 a, Vec4 b) {
+    return _mm_movemask_ps(_mm_cmpge_ps(a.v, b.v));
+  }
+};
+
+inline Vec4 operator+(Vec4 a, Vec4 b) { return {_mm_add_ps(a.v, b.v)}; }
+inline Vec4 operator*(Vec4 a, Vec4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+
+#ifdef RR_CULLING_AVX2
+struct Vec8 {
+  static const uint32_t kWidth = 8;
+  __m256 v;
+
+  static Vec8 Load(const float* p) { return {_mm256_loadu_ps(p)}; }
+  static Vec8 Set(float f) { return {_mm256_set1_ps(f)}; }
+  static uint32_t GreaterEqual(Vec8 a, Vec8 b) {
+    return _mm256_movemask_ps(_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ));
+  }
+};
+
+inline Vec8 operator+(Vec8 a, Vec8 b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline Vec8 operator*(Vec8 a, Vec8 b) { return {_mm256_mul_ps(a.v, b.v)}; }
+#endif
+}
+
+// Same test as CullBoxesScalar with one box per lane, every plane is
+// tested and the results are and'ed into a lane mask
+template <typename V>
+static uint32_t CullBatches(const RR::Frustum& frustum,
+                            const RR::BoxStreams& boxes, uint32_t begin,
+                            uint32_t end, uint32_t* visible) {
+  const uint32_t kAllLanes = (1U << V::kWidth) - 1U;
+
+  V plane[6][4];
+  V plane_abs[6][3];
+  for (uint32_t p = 0; p < 6; p++) {
+    const DirectX::XMFLOAT4& f = frustum.planes[p];
+    plane[p][0] = V::Set(f.x);
+    plane[p][1] = V::Set(f.y);
+    plane[p][2] = V::Set(f.z);
+    plane[p][3] = V::Set(f.w);
+    plane_abs[p][0] = V::Set(std::fabs(f.x));
+    plane_abs[p][1] = V::Set(std::fabs(f.y));
+    plane_abs[p][2] = V::Set(std::fabs(f.z));
+  }
+
+  V zero = V::Set(0.0f);
+  uint32_t count = 0;
+  uint32_t i = begin;
+  for (; i + V::kWidth <= end; i += V::kWidth) {
+    V center_x = V::Load(boxes.center_x + i);
+    V center_y = V::Load(boxes.center_y + i);
+    V center_z = V::Load(boxes.center_z + i);
+    V extent_x = V::Load(boxes.extent_x + i);
+    V extent_y = V::Load(boxes.extent_y + i);
+    V extent_z = V::Load(boxes.extent_z + i);
+
+    uint32_t inside = V::GreaterEqual(extent_x, zero);
+    for (uint32_t p = 0; p < 6 && inside != 0; p++) {
+      V distance = plane[p][0] * center_x + plane[p][1] * center_y +
+                   plane[p][2] * center_z + plane[p][3];
+      V radius = plane_abs[p][0] * extent_x + plane_abs[p][1] * extent_y +
+                 plane_abs[p][2] * extent_z;
+      inside &= V::GreaterEqual(distance + radius, zero);
+    }
+
+    if (inside == kAllLanes) {
+      for (uint32_t j = 0; j < V::kWidth; j++) {
+        visible[count + j] = i + j;
+      }
+      count += V::kWidth;
+      continue;
+    }
+
+    for (uint32_t j = 0; j < V::kWidth; j++) {
+      visible[count] = i + j;
+      count += (inside >> j) & 1U;
+    }
+  }
+
+  return count + RR::CullBoxesScalar(frustum, boxes, i, end, visible + count);
+}
+#endif
+
+uint32_t RR::CullBoxes(const Frustum& frustum, const BoxStreams& boxes,
+                       uint32_t begin, uint32_t end, uint32_t* visible) {
+  uint32_t count = 0;
+
+  switch (TransformKernelWidth()) {
+#ifdef RR_CULLING_AVX2
+    case 8:
+      count = CullBatches<Vec8>(frustum, boxes, begin, end, visible);
+      _mm256_zeroupper();
+      break;
+#endif
+#ifdef RR_CULLING_SSE
+    case 4:
+      count = CullBatches<Vec4>(frustum, boxes, begin, end, visible);
+      break;
+#endif
+    default:
+      count = CullBoxesScalar(frustum, boxes, begin, end, visible);
+      break;
+  }
+
+  return count;
+}
@@ -0,0 +1,119 @@
+#include "renderer/graphics/constant_pool.h"
+
+#include <d3d12.h>
+
+#include "renderer/logger.h"
+
+RR::GFX::ConstantPool::~ConstantPool() { Release(); }
+
+int RR::GFX::ConstantPool::Init(ID3D12Device* device, uint32_t block_size,
+                                uint32_t blocks_per_page) {
+  if (_device != nullptr || block_size == 0 || blocks_per_page == 0) {
+    return 1;
+  }
+
+  _device = device;
+  _block_size = (block_size + kAlignment - 1) & ~(kAlignment - 1);
+  _blocks_per_page = blocks_per_page;
+  return 0;
+}
+
+void RR::GFX::ConstantPool::Release() {
+  for (size_t i = 0; i < _pages.size(); i++) {
+    _pages[i].resource->Unmap(0, nullptr);
+    _pages[i].resource->Release();
+  }
+
+  _pages.clear();
+  _free_blocks.clear();
+  _allocated = 0U;
+  _device = nullptr;
+}
+
+int RR::GFX::ConstantPool::AddPage() {
+  D3D12_HEAP_PROPERTIES heap_properties = {};
+  heap_properties.Type = D3D12_HEAP_TYPE_UPLOAD;
+  heap_properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+  heap_properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+
+  D3D12_RESOURCE_DESC buffer_desc = {};
+  buffer_desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+  buffer_desc.Alignment = 0;
+  buffer_desc.Width = (uint64_t)_block_size * _blocks_per_page;
+  buffer_desc.Height = 1;
+  buffer_desc.DepthOrArraySize = 1;
+  buffer_desc.MipLevels = 1;
+  buffer_desc.Format = DXGI_FORMAT_UNKNOWN;
+  buffer_desc.SampleDesc.Count = 1;
+  buffer_desc.SampleDesc.Quality = 0;
+  buffer_desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+  buffer_desc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+  Page page = {};
+  HRESULT result = _device->CreateCommittedResource(
+      &heap_properties, D3D12_HEAP_FLAG_NONE, &buffer_desc,
+      D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
+      IID_PPV_ARGS(&page.resource));
+  if (FAILED(result)) {
+    LOG_ERROR("RR::GFX", "Couldn't create constant pool page");
+    return 1;
+  }
+
+  D3D12_RANGE read_range = {0, 0};
+  result = page.resource->Map(0, &read_range,
+                              reinterpret_cast<void**>(&page.data));
+  if (FAILED(result)) {
+    LOG_ERROR("RR::GFX", "Couldn't map constant pool page");
+    page.resource->Release();
+    return 1;
+  }
+
+  page.gpu_address = page.resource->GetGPUVirtualAddress();
+
+  // Pushed backwards so blocks are handed out in address order
+  uint32_t first_block = _pages.size() * _blocks_per_page;
+  for (uint32_t i = _blocks_per_page; i > 0; i--) {
+    _free_blocks.push_back(first_block + i - 1);
+  }
+
+  _pages.push_back(page);
+  return 0;
+}
+
+uint32_t RR::GFX::ConstantPool::Allocate() {
+  if (_device == nullptr) {
+    return kInvalidBlock;
+  }
+
+  if (_free_blocks.empty() && AddPage() != 0) {
+    return kInvalidBlock;
+  }
+
+  uint32_t block = _free_blocks.back();
+  _free_blocks.pop_back();
+  _allocated++;
+  return block;
+}
+
+void RR::GFX::ConstantPool::Free(uint32_t block) {
+  if (block == kInvalidBlock || block >= _pages.size() * _blocks_per_page) {
+    return;
+  }
+
+  _free_blocks.push_back(block);
+  _allocated--;
+}
+
+void* RR::GFX::ConstantPool::Data(uint32_t block) const {
+  const Page& page = _pages[block / _blocks_per_page];
+  return page.data + (uint64_t)(block % _blocks_per_page) * _block_size;
+}
+
+uint64_t RR::GFX::ConstantPool::GPUAddress(uint32_t block) const {
+  const Page& page = _pages[block / _blocks_per_page];
+  return page.gpu_address + (uint64_t)(block % _blocks_per_page) * _block_size;
+}
+
+uint32_t RR::GFX::ConstantPool::block_size() const { return _block_size; }
+
+uint32_t RR::GFX::ConstantPool::allocated() const { return _allocated; }
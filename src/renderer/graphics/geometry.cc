@@ -22,6 +22,8 @@ uint32_t RR::GFX::Geometry::Stride() const {
              sizeof(float) * 2;
       break;
   }
+
+  return 0;
 }
 
 uint32_t RR::GFX::Geometry::Type() const { return _type; }
@@ -34,12 +36,10 @@ const D3D12_INDEX_BUFFER_VIEW* RR::GFX::Geometry::IndexView() const {
   return _index_buffer_view.get();
 }
 
-int RR::GFX::Geometry::Init(ID3D12Device* device, uint32_t geometry_type, std::unique_ptr<RR::GeometryData>&& data) {
-  if (_initialized) {
-    return 1;
-  }
+const RR::Bounds& RR::GFX::Geometry::bounds() const { return _bounds; }
 
-  if (data == nullptr) {
+int RR::GFX::Geometry::Init(ID3D12Device* device, uint32_t geometry_type, const RR::GeometryData& data) {
+  if (_initialized) {
     return 1;
   }
 
@@ -58,7 +58,7 @@ int RR::GFX::Geometry::Init(ID3D12Device* device, uint32_t geometry_type, std::u
   D3D12_RESOURCE_DESC buffer_resource_desc = {};
   buffer_resource_desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
   buffer_resource_desc.Alignment = 0;
-  buffer_resource_desc.Width = data->vertex_data.size() * sizeof(float);
+  buffer_resource_desc.Width = data.vertex_data.size() * sizeof(float);
   buffer_resource_desc.Height = 1;
   buffer_resource_desc.DepthOrArraySize = 1;
   buffer_resource_desc.MipLevels = 1;
@@ -88,7 +88,7 @@ int RR::GFX::Geometry::Init(ID3D12Device* device, uint32_t geometry_type, std::u
     return 1;
   }
 
-  buffer_resource_desc.Width = data->index_data.size() * sizeof(uint32_t);
+  buffer_resource_desc.Width = data.index_data.size() * sizeof(uint32_t);
   result = device->CreateCommittedResource(
       &default_heap_properties, D3D12_HEAP_FLAG_NONE, &buffer_resource_desc,
       D3D12_RESOURCE_STATE_COMMON, nullptr,
@@ -111,22 +111,26 @@ int RR::GFX::Geometry::Init(ID3D12Device* device, uint32_t geometry_type, std::u
 
   _initialized = true;
   _updated = false;
-  _indices = data->index_data.size();
+  _indices = data.index_data.size();
   _type = geometry_type;
-  // FIXME: this is not safe as user could release 
-  // data->vertex_data or whatever
+
+  uint32_t stride = Stride() / sizeof(float);
+  if (stride != 0) {
+    _bounds = ComputeBounds(data.vertex_data.data(),
+                            data.vertex_data.size() / stride, stride);
+  }
   _new_data = std::make_unique<GeometryData>();
-  _new_data->index_data = data->index_data;
-  _new_data->vertex_data = data->vertex_data;
+  _new_data->index_data = data.index_data;
+  _new_data->vertex_data = data.vertex_data;
 
   _vertex_buffer_view = std::make_unique<D3D12_VERTEX_BUFFER_VIEW>();
   _vertex_buffer_view->BufferLocation = _vertex_default_buffer->GetGPUVirtualAddress();
-  _vertex_buffer_view->SizeInBytes = data->vertex_data.size() * sizeof(float);
+  _vertex_buffer_view->SizeInBytes = data.vertex_data.size() * sizeof(float);
   _vertex_buffer_view->StrideInBytes = Stride();
 
   _index_buffer_view = std::make_unique<D3D12_INDEX_BUFFER_VIEW>();
   _index_buffer_view->BufferLocation = _index_default_buffer->GetGPUVirtualAddress();
-  _index_buffer_view->SizeInBytes = data->index_data.size() * sizeof(uint32_t);
+  _index_buffer_view->SizeInBytes = data.index_data.size() * sizeof(uint32_t);
   _index_buffer_view->Format = DXGI_FORMAT_R32_UINT;
 
   return 0;
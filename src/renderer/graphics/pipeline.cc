@@ -4,6 +4,7 @@
 #include <d3d12sdklayers.h>
 #include <d3dcompiler.h>
 
+#include <climits>
 #include <vector>
 
 #include "renderer/logger.h"
@@ -33,13 +34,13 @@ int RR::GFX::Pipeline::Init(ID3D12Device* device, uint32_t type,
   std::vector<D3D12_ROOT_PARAMETER1> parameters = std::vector<D3D12_ROOT_PARAMETER1>(3);
   std::vector<D3D12_STATIC_SAMPLER_DESC> samplers = std::vector<D3D12_STATIC_SAMPLER_DESC>(0);
 
-  D3D12_ROOT_DESCRIPTOR1 mvp_cb_descriptor = {};
-  mvp_cb_descriptor.RegisterSpace = 0;
-  mvp_cb_descriptor.ShaderRegister = 0;
-  mvp_cb_descriptor.Flags = D3D12_ROOT_DESCRIPTOR_FLAG_NONE;
+  D3D12_ROOT_DESCRIPTOR1 frame_cb_descriptor = {};
+  frame_cb_descriptor.RegisterSpace = 0;
+  frame_cb_descriptor.ShaderRegister = 0;
+  frame_cb_descriptor.Flags = D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC;
 
   parameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
-  parameters[0].Descriptor = mvp_cb_descriptor;
+  parameters[0].Descriptor = frame_cb_descriptor;
   parameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
 
   D3D12_ROOT_DESCRIPTOR1 material_cb_descriptor = {};
@@ -66,11 +67,16 @@ int RR::GFX::Pipeline::Init(ID3D12Device* device, uint32_t type,
 
       parameters[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
 
+      // The whole global heap, materials carry the index of each texture.
+      // Slots are written before their first use and never change after
       D3D12_DESCRIPTOR_RANGE1 table_ranges[1] = {};
       table_ranges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
-      table_ranges[0].NumDescriptors = 5;
+      table_ranges[0].NumDescriptors = UINT_MAX;
       table_ranges[0].BaseShaderRegister = 0;
       table_ranges[0].RegisterSpace = 0;
+      table_ranges[0].Flags =
+          D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE |
+          D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE;
       table_ranges[0].OffsetInDescriptorsFromTableStart =
           D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
 
@@ -228,6 +234,13 @@ int RR::GFX::Pipeline::Init(ID3D12Device* device, uint32_t type,
       break;
   }
 
+  // Instanced draws read the world matrix rows from slot 1
+  for (UINT i = 0; i < 4; i++) {
+    input_layout.push_back({"MODEL", i, DXGI_FORMAT_R32G32B32A32_FLOAT, 1,
+                            i * 16,
+                            D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1});
+  }
+
   D3D12_INPUT_LAYOUT_DESC input_layout_desc = {};
   input_layout_desc.pInputElementDescs = &input_layout[0];
   input_layout_desc.NumElements = input_layout.size();
@@ -0,0 +1,122 @@
+#include "renderer/graphics/upload_ring.h"
+
+#include <d3d12.h>
+
+#include "renderer/logger.h"
+
+RR::GFX::UploadRing::~UploadRing() { Release(); }
+
+int RR::GFX::UploadRing::Init(ID3D12Device* device, uint64_t size) {
+  if (_buffer != nullptr) {
+    return 1;
+  }
+
+  _device = device;
+  return CreateBuffer(size);
+}
+
+int RR::GFX::UploadRing::CreateBuffer(uint64_t size) {
+  size = (size + kAlignment - 1) & ~(kAlignment - 1);
+
+  D3D12_HEAP_PROPERTIES heap_properties = {};
+  heap_properties.Type = D3D12_HEAP_TYPE_UPLOAD;
+  heap_properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+  heap_properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+
+  D3D12_RESOURCE_DESC buffer_desc = {};
+  buffer_desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+  buffer_desc.Alignment = 0;
+  buffer_desc.Width = size;
+  buffer_desc.Height = 1;
+  buffer_desc.DepthOrArraySize = 1;
+  buffer_desc.MipLevels = 1;
+  buffer_desc.Format = DXGI_FORMAT_UNKNOWN;
+  buffer_desc.SampleDesc.Count = 1;
+  buffer_desc.SampleDesc.Quality = 0;
+  buffer_desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+  buffer_desc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+  ID3D12Resource* buffer = nullptr;
+  HRESULT result = _device->CreateCommittedResource(
+      &heap_properties, D3D12_HEAP_FLAG_NONE, &buffer_desc,
+      D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&buffer));
+  if (FAILED(result)) {
+    LOG_ERROR("RR::GFX", "Couldn't create upload ring buffer");
+    return 1;
+  }
+
+  // Upload heaps can stay mapped, the CPU never reads them back
+  uint8_t* data = nullptr;
+  D3D12_RANGE read_range = {0, 0};
+  result = buffer->Map(0, &read_range, reinterpret_cast<void**>(&data));
+  if (FAILED(result)) {
+    LOG_ERROR("RR::GFX", "Couldn't map upload ring buffer");
+    buffer->Release();
+    return 1;
+  }
+
+  if (_buffer != nullptr) {
+    _retired.push_back(_buffer);
+  }
+
+  _buffer = buffer;
+  _data = data;
+  _gpu_address = buffer->GetGPUVirtualAddress();
+  _size = size;
+  _offset = 0U;
+  return 0;
+}
+
+void RR::GFX::UploadRing::Release() {
+  Reset();
+
+  if (_buffer != nullptr) {
+    _buffer->Unmap(0, nullptr);
+    _buffer->Release();
+    _buffer = nullptr;
+  }
+
+  _data = nullptr;
+  _gpu_address = 0U;
+  _size = 0U;
+}
+
+void* RR::GFX::UploadRing::Allocate(uint64_t size, uint64_t* gpu_address) {
+  uint64_t aligned_size = (size + kAlignment - 1) & ~(kAlignment - 1);
+
+  if (_offset + aligned_size > _size) {
+    if (_buffer == nullptr) {
+      LOG_WARNING("RR::GFX", "Allocating from an uninitialized upload ring");
+      return nullptr;
+    }
+
+    // Twice the larger of the ring and the request, so one growth fits it
+    uint64_t new_size = _size > aligned_size ? _size : aligned_size;
+    new_size *= 2;
+
+    if (CreateBuffer(new_size) != 0) {
+      return nullptr;
+    }
+  }
+
+  void* data = _data + _offset;
+  *gpu_address = _gpu_address + _offset;
+  _offset += aligned_size;
+  _used += aligned_size;
+  return data;
+}
+
+void RR::GFX::UploadRing::Reset() {
+  for (size_t i = 0; i < _retired.size(); i++) {
+    _retired[i]->Unmap(0, nullptr);
+    _retired[i]->Release();
+  }
+
+  _retired.clear();
+  _offset = 0U;
+  _used = 0U;
+}
+
+uint64_t RR::GFX::UploadRing::used() const { return _used; }
+
+uint64_t RR::GFX::UploadRing::size() const { return _size; }
@@ -0,0 +1,230 @@
+#include "renderer/material_registry.h"
+
+#include <string.h>
+
+#include "renderer/logger.h"
+#include "renderer/graphics/constant_pool.h"
+
+// Material parameters of pbr.frag.hlsl, the settings followed by the heap
+// index of every texture
+struct PBRMaterialConstants {
+  RR::PBRSettings settings;
+  uint32_t texture_descriptors[5];
+};
+
+// FNV-1a over the bytes of the material
+static uint64_t HashMaterial(uint32_t pipeline_type,
+                             const RR::MaterialSettings& settings,
+                             const RR::TextureSettings& texture_settings) {
+  uint64_t hash = 14695981039346656037ULL;
+  const void* parts[] = {&pipeline_type, &settings, &texture_settings};
+  const size_t sizes[] = {sizeof(pipeline_type), sizeof(settings),
+                          sizeof(texture_settings)};
+
+  for (uint32_t p = 0; p < 3; p++) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(parts[p]);
+    for (size_t i = 0; i < sizes[p]; i++) {
+      hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+  }
+
+  return hash;
+}
+
+RR::MaterialRegistry::~MaterialRegistry() { Release(); }
+
+int RR::MaterialRegistry::Init(ID3D12Device* device, uint16_t frame_count) {
+  if (_device != nullptr || frame_count == 0) {
+    return 1;
+  }
+
+  // One 256 byte copy of the constants per frame in flight
+  _constants = std::make_unique<GFX::ConstantPool>();
+  if (_constants->Init(device, GFX::ConstantPool::kAlignment * frame_count,
+                       256) != 0) {
+    _constants = nullptr;
+    return 1;
+  }
+
+  _device = device;
+  _frame_count = frame_count;
+  _frame = 0;
+  _retired = std::vector<std::vector<MaterialHandle>>(frame_count);
+  return 0;
+}
+
+void RR::MaterialRegistry::Release() {
+  if (_constants != nullptr) {
+    _constants->Release();
+    _constants = nullptr;
+  }
+
+  _materials.clear();
+  _free_handles.clear();
+  _lookup.clear();
+  _retired.clear();
+  _material_count = 0U;
+  _device = nullptr;
+}
+
+void RR::MaterialRegistry::BeginFrame(uint16_t frame) {
+  if (frame >= _retired.size()) {
+    return;
+  }
+
+  _frame = frame;
+
+  std::vector<MaterialHandle>& retired = _retired[frame];
+  for (size_t i = 0; i < retired.size(); i++) {
+    MaterialHandle handle = retired[i];
+    Material& material = _materials[handle];
+
+    // Acquired again, or released again in a later frame
+    if (material.references != 0 || material.retired_frame != frame) {
+      continue;
+    }
+
+    std::pair<std::multimap<uint64_t, MaterialHandle>::iterator,
+              std::multimap<uint64_t, MaterialHandle>::iterator>
+        range = _lookup.equal_range(material.hash);
+    for (std::multimap<uint64_t, MaterialHandle>::iterator it = range.first;
+         it != range.second; it++) {
+      if (it->second == handle) {
+        _lookup.erase(it);
+        break;
+      }
+    }
+
+    _constants->Free(material.constant_block);
+    material.constant_block = GFX::ConstantPool::kInvalidBlock;
+    material.retired_frame = -1;
+    _free_handles.push_back(handle);
+  }
+
+  retired.clear();
+}
+
+RR::MaterialHandle RR::MaterialRegistry::Acquire(
+    uint32_t pipeline_type, const MaterialSettings& settings,
+    const TextureSettings& texture_settings,
+    const std::vector<uint32_t>& texture_descriptors) {
+  if (_device == nullptr) {
+    return kInvalidMaterial;
+  }
+
+  uint64_t hash = HashMaterial(pipeline_type, settings, texture_settings);
+
+  std::pair<std::multimap<uint64_t, MaterialHandle>::iterator,
+            std::multimap<uint64_t, MaterialHandle>::iterator>
+      range = _lookup.equal_range(hash);
+  for (std::multimap<uint64_t, MaterialHandle>::iterator it = range.first;
+       it != range.second; it++) {
+    Material& material = _materials[it->second];
+    if (material.pipeline_type == pipeline_type &&
+        memcmp(&material.settings, &settings, sizeof(settings)) == 0 &&
+        memcmp(&material.texture_settings, &texture_settings,
+               sizeof(texture_settings)) == 0) {
+      if (material.references++ == 0) {
+        material.retired_frame = -1;
+        _material_count++;
+      }
+      return it->second;
+    }
+  }
+
+  MaterialHandle handle = kInvalidMaterial;
+  if (!_free_handles.empty()) {
+    handle = _free_handles.back();
+    _free_handles.pop_back();
+  } else if (_materials.size() < kMaxMaterials) {
+    handle = _materials.size();
+    _materials.push_back(Material());
+  } else {
+    LOG_ERROR("RR", "Material registry is full, %u materials", kMaxMaterials);
+    return kInvalidMaterial;
+  }
+
+  uint32_t constant_block = _constants->Allocate();
+  if (constant_block == GFX::ConstantPool::kInvalidBlock) {
+    _free_handles.push_back(handle);
+    return kInvalidMaterial;
+  }
+
+  Material& material = _materials[handle];
+  material.hash = hash;
+  material.pipeline_type = pipeline_type;
+  material.settings = settings;
+  material.texture_settings = texture_settings;
+  material.references = 1;
+  material.constant_block = constant_block;
+  material.stale_frames = (1U << _frame_count) - 1;
+  material.retired_frame = -1;
+
+  // Same order as the texture indices of pbr.frag.hlsl. Unresolved
+  // textures are never sampled, slot 0 only keeps the index in the heap
+  const PBRTextures& pbr_textures = texture_settings.pbr_textures;
+  int32_t textures[5] = {pbr_textures.base_color, pbr_textures.metallic,
+                         pbr_textures.normal, pbr_textures.roughness,
+                         pbr_textures.reflectance};
+  for (uint32_t i = 0; i < 5; i++) {
+    material.texture_descriptors[i] = 0U;
+    if (HasTextureDescriptor(textures[i], texture_descriptors)) {
+      material.texture_descriptors[i] = texture_descriptors[textures[i]];
+    }
+  }
+
+  _lookup.insert(std::make_pair(hash, handle));
+  _material_count++;
+  return handle;
+}
+
+void RR::MaterialRegistry::Release(MaterialHandle handle) {
+  if (handle >= _materials.size() || _materials[handle].references == 0) {
+    return;
+  }
+
+  Material& material = _materials[handle];
+  if (--material.references == 0) {
+    // The frames recorded up to now may still read it
+    material.retired_frame = _frame;
+    _retired[_frame].push_back(handle);
+    _material_count--;
+  }
+}
+
+void RR::MaterialRegistry::Update(MaterialHandle handle, uint16_t frame) {
+  Material& material = _materials[handle];
+  if ((material.stale_frames & (1U << frame)) == 0) {
+    return;
+  }
+
+  uint8_t* data = static_cast<uint8_t*>(
+      _constants->Data(material.constant_block));
+  data += frame * GFX::ConstantPool::kAlignment;
+
+  switch (material.pipeline_type) {
+    case RR::PipelineTypes::kPipelineType_PBR: {
+      PBRMaterialConstants* constants =
+          reinterpret_cast<PBRMaterialConstants*>(data);
+      constants->settings = material.settings.pbr_settings;
+      memcpy(constants->texture_descriptors, material.texture_descriptors,
+             sizeof(material.texture_descriptors));
+      break;
+    }
+    case RR::PipelineTypes::kPipelineType_Phong:
+      memcpy(data, &material.settings.phong_settings, sizeof(RR::PhongSettings));
+      break;
+  }
+
+  material.stale_frames &= ~(1U << frame);
+}
+
+uint64_t RR::MaterialRegistry::ConstantBufferView(MaterialHandle handle,
+                                                  uint16_t frame) const {
+  return _constants->GPUAddress(_materials[handle].constant_block) +
+         frame * GFX::ConstantPool::kAlignment;
+}
+
+uint32_t RR::MaterialRegistry::material_count() const {
+  return _material_count;
+}
@@ -0,0 +1,397 @@
+#include "renderer/occlusion_culler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "renderer/thread_pool.h"
+
+// SSE2 is always there when DirectXMath uses intrinsics, rows are
+// rasterized four pixels at a time
+#if !defined(_XM_NO_INTRINSICS_) && \
+    (defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__))
+#define RR_OCCLUSION_SSE 1
+#include <immintrin.h>
+#endif
+
+// Corners closer than this to the camera plane make the projected
+// rectangle meaningless, those bounds are never occluded
+static const float kMinW = 1e-4f;
+
+static DirectX::XMFLOAT4 TransformPoint(const DirectX::XMFLOAT4X4& m, float x,
+                                        float y, float z) {
+  return {x * m._11 + y * m._21 + z * m._31 + m._41,
+          x * m._12 + y * m._22 + z * m._32 + m._42,
+          x * m._13 + y * m._23 + z * m._33 + m._43,
+          x * m._14 + y * m._24 + z * m._34 + m._44};
+}
+
+static DirectX::XMFLOAT4 Lerp(const DirectX::XMFLOAT4& a,
+                              const DirectX::XMFLOAT4& b, float t) {
+  return {a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t,
+          a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t};
+}
+
+static int32_t Clamp(int32_t value, int32_t min, int32_t max) {
+  return value < min ? min : (value > max ? max : value);
+}
+
+RR::OcclusionCuller::OcclusionCuller()
+    : _view_projection(),
+      _depth(kWidth * kHeight, 1.0f),
+      _tile_depth(kTilesX * kTilesY, 1.0f),
+      _previous_view_projection() {}
+
+void RR::OcclusionCuller::Begin(const DirectX::XMFLOAT4X4& view_projection) {
+  _view_projection = view_projection;
+  _triangles.clear();
+  std::fill(_depth.begin(), _depth.end(), 1.0f);
+  std::fill(_tile_depth.begin(), _tile_depth.end(), 1.0f);
+}
+
+void RR::OcclusionCuller::AddOccluder(const DirectX::XMFLOAT4X4& world,
+                                      const float* vertex_data,
+                                      uint32_t stride, uint32_t vertex_count,
+                                      const uint32_t* indices,
+                                      uint32_t index_count) {
+  if (vertex_data == nullptr || indices == nullptr || stride < 3) {
+    return;
+  }
+
+  DirectX::XMFLOAT4X4 world_view_projection;
+  DirectX::XMStoreFloat4x4(
+      &world_view_projection,
+      DirectX::XMMatrixMultiply(DirectX::XMLoadFloat4x4(&world),
+                                DirectX::XMLoadFloat4x4(&_view_projection)));
+
+  // Shared vertices are transformed once
+  _clip_vertices.resize(vertex_count);
+  for (uint32_t i = 0; i < vertex_count; i++) {
+    const float* position = vertex_data + (size_t)i * stride;
+    _clip_vertices[i] = TransformPoint(world_view_projection, position[0],
+                                       position[1], position[2]);
+  }
+
+  for (uint32_t i = 0; i + 2 < index_count; i += 3) {
+    if (indices[i] >= vertex_count || indices[i + 1] >= vertex_count ||
+        indices[i + 2] >= vertex_count) {
+      continue;
+    }
+
+    DirectX::XMFLOAT4 clip[3] = {_clip_vertices[indices[i]],
+                                 _clip_vertices[indices[i + 1]],
+                                 _clip_vertices[indices[i + 2]]};
+    AddTriangle(clip);
+  }
+}
+
+void RR::OcclusionCuller::AddTriangle(const DirectX::XMFLOAT4 clip[3]) {
+  // Clipped against the near plane, z >= 0, in clip space. Triangles
+  // crossing it become a quad split in two
+  uint32_t inside = 0;
+  for (uint32_t i = 0; i < 3; i++) {
+    inside += clip[i].z >= 0.0f ? 1 : 0;
+  }
+
+  if (inside == 0) {
+    return;
+  }
+
+  if (inside == 3) {
+    AddScreenTriangle(clip);
+    return;
+  }
+
+  DirectX::XMFLOAT4 polygon[4];
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < 3; i++) {
+    const DirectX::XMFLOAT4& a = clip[i];
+    const DirectX::XMFLOAT4& b = clip[(i + 1) % 3];
+
+    if (a.z >= 0.0f) {
+      polygon[count++] = a;
+    }
+
+    if ((a.z >= 0.0f) != (b.z >= 0.0f)) {
+      polygon[count++] = Lerp(a, b, a.z / (a.z - b.z));
+    }
+  }
+
+  AddScreenTriangle(polygon);
+  if (count == 4) {
+    DirectX::XMFLOAT4 second[3] = {polygon[0], polygon[2], polygon[3]};
+    AddScreenTriangle(second);
+  }
+}
+
+void RR::OcclusionCuller::AddScreenTriangle(const DirectX::XMFLOAT4 clip[3]) {
+  float x[3];
+  float y[3];
+  float z[3];
+  for (uint32_t i = 0; i < 3; i++) {
+    if (clip[i].w < kMinW) {
+      return;
+    }
+
+    float inv_w = 1.0f / clip[i].w;
+    x[i] = (clip[i].x * inv_w * 0.5f + 0.5f) * kWidth;
+    y[i] = (0.5f - clip[i].y * inv_w * 0.5f) * kHeight;
+    z[i] = clip[i].z * inv_w;
+  }
+
+  Triangle triangle = {};
+  triangle.min_x = Clamp((int32_t)std::floor(fminf(x[0], fminf(x[1], x[2]))),
+                         0, kWidth - 1);
+  triangle.max_x = Clamp((int32_t)std::ceil(fmaxf(x[0], fmaxf(x[1], x[2]))), 0,
+                         kWidth - 1);
+  triangle.min_y = Clamp((int32_t)std::floor(fminf(y[0], fminf(y[1], y[2]))),
+                         0, kHeight - 1);
+  triangle.max_y = Clamp((int32_t)std::ceil(fmaxf(y[0], fmaxf(y[1], y[2]))), 0,
+                         kHeight - 1);
+
+  // Edge i goes from vertex i + 1 to vertex i + 2
+  for (uint32_t i = 0; i < 3; i++) {
+    uint32_t a = (i + 1) % 3;
+    uint32_t b = (i + 2) % 3;
+    triangle.edge_a[i] = y[a] - y[b];
+    triangle.edge_b[i] = x[b] - x[a];
+    triangle.edge_c[i] = x[a] * y[b] - y[a] * x[b];
+  }
+
+  // Twice the signed area, both windings are rasterized so the edges are
+  // flipped to be positive inside
+  float area = triangle.edge_a[0] * x[0] + triangle.edge_b[0] * y[0] +
+               triangle.edge_c[0];
+  if (std::fabs(area) < 1e-6f) {
+    return;
+  }
+
+  float inv_area = 1.0f / area;
+  float sign = area > 0.0f ? 1.0f : -1.0f;
+  triangle.depth_a = 0.0f;
+  triangle.depth_b = 0.0f;
+  triangle.depth_c = 0.0f;
+  for (uint32_t i = 0; i < 3; i++) {
+    // Barycentric i is edge i over the area
+    triangle.depth_a += triangle.edge_a[i] * inv_area * z[i];
+    triangle.depth_b += triangle.edge_b[i] * inv_area * z[i];
+    triangle.depth_c += triangle.edge_c[i] * inv_area * z[i];
+    triangle.edge_a[i] *= sign;
+    triangle.edge_b[i] *= sign;
+    triangle.edge_c[i] *= sign;
+  }
+
+  _triangles.push_back(triangle);
+}
+
+void RR::OcclusionCuller::Rasterize(ThreadPool* thread_pool) {
+  bool changed =
+      memcmp(&_view_projection, &_previous_view_projection,
+             sizeof(_view_projection)) != 0 ||
+      _triangles.size() != _previous_triangles.size() ||
+      (!_triangles.empty() &&
+       memcmp(_triangles.data(), _previous_triangles.data(),
+              sizeof(Triangle) * _triangles.size()) != 0);
+  if (changed) {
+    _previous_view_projection = _view_projection;
+    _previous_triangles = _triangles;
+    _version++;
+  }
+
+  // Every chunk is one row of tiles, so workers never share pixels and
+  // each can build its own tile depths
+  thread_pool->ParallelFor(kHeight, kTileSize,
+                           [this](uint32_t begin, uint32_t end) {
+                             RasterizeRows(begin, end);
+                           });
+}
+
+void RR::OcclusionCuller::RasterizeRows(uint32_t first_row,
+                                        uint32_t last_row) {
+  for (size_t t = 0; t < _triangles.size(); t++) {
+    const Triangle& triangle = _triangles[t];
+    int32_t min_y = triangle.min_y > (int32_t)first_row ? triangle.min_y
+                                                        : (int32_t)first_row;
+    int32_t max_y = triangle.max_y < (int32_t)last_row - 1
+                        ? triangle.max_y
+                        : (int32_t)last_row - 1;
+    if (min_y > max_y) {
+      continue;
+    }
+
+    // Rows are walked from a four aligned column, kWidth is a multiple
+    // of four so the last group never leaves the row
+    int32_t min_x = triangle.min_x & ~3;
+
+    for (int32_t y = min_y; y <= max_y; y++) {
+      float* row = _depth.data() + (size_t)y * kWidth;
+      float center_y = (float)y + 0.5f;
+
+#ifdef RR_OCCLUSION_SSE
+      __m128 edge_a[3];
+      __m128 edge_row[3];
+      for (uint32_t i = 0; i < 3; i++) {
+        edge_a[i] = _mm_set1_ps(triangle.edge_a[i]);
+        edge_row[i] = _mm_set1_ps(triangle.edge_b[i] * center_y +
+                                  triangle.edge_c[i]);
+      }
+      __m128 depth_a = _mm_set1_ps(triangle.depth_a);
+      __m128 depth_row =
+          _mm_set1_ps(triangle.depth_b * center_y + triangle.depth_c);
+      __m128 zero = _mm_setzero_ps();
+
+      for (int32_t x = min_x; x <= triangle.max_x; x += 4) {
+        __m128 center_x = _mm_add_ps(_mm_set1_ps((float)x + 0.5f),
+                                     _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+        __m128 inside = _mm_cmpge_ps(
+            _mm_add_ps(_mm_mul_ps(edge_a[0], center_x), edge_row[0]), zero);
+        inside = _mm_and_ps(
+            inside,
+            _mm_cmpge_ps(
+                _mm_add_ps(_mm_mul_ps(edge_a[1], center_x), edge_row[1]),
+                zero));
+        inside = _mm_and_ps(
+            inside,
+            _mm_cmpge_ps(
+                _mm_add_ps(_mm_mul_ps(edge_a[2], center_x), edge_row[2]),
+                zero));
+
+        if (_mm_movemask_ps(inside) == 0) {
+          continue;
+        }
+
+        __m128 depth =
+            _mm_add_ps(_mm_mul_ps(depth_a, center_x), depth_row);
+        __m128 previous = _mm_loadu_ps(row + x);
+        __m128 closer = _mm_min_ps(previous, depth);
+        _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closer),
+                                         _mm_andnot_ps(inside, previous)));
+      }
+#else
+      for (int32_t x = min_x; x <= triangle.max_x; x++) {
+        float center_x = (float)x + 0.5f;
+        bool inside = true;
+        for (uint32_t i = 0; i < 3 && inside; i++) {
+          inside = triangle.edge_a[i] * center_x +
+                       triangle.edge_b[i] * center_y + triangle.edge_c[i] >=
+                   0.0f;
+        }
+
+        float depth = triangle.depth_a * center_x +
+                      triangle.depth_b * center_y + triangle.depth_c;
+        if (inside && depth < row[x]) {
+          row[x] = depth;
+        }
+      }
+#endif
+    }
+  }
+
+  for (uint32_t tile_y = first_row / kTileSize;
+       tile_y < (last_row + kTileSize - 1) / kTileSize; tile_y++) {
+    for (uint32_t tile_x = 0; tile_x < kTilesX; tile_x++) {
+      float farthest = 0.0f;
+      for (uint32_t y = 0; y < kTileSize; y++) {
+        const float* row = _depth.data() +
+                           (size_t)(tile_y * kTileSize + y) * kWidth +
+                           tile_x * kTileSize;
+        for (uint32_t x = 0; x < kTileSize; x++) {
+          farthest = row[x] > farthest ? row[x] : farthest;
+        }
+      }
+      _tile_depth[tile_y * kTilesX + tile_x] = farthest;
+    }
+  }
+}
+
+bool RR::OcclusionCuller::IsOccluded(const Bounds& bounds,
+                                     bool coarse) const {
+  if (IsEmpty(bounds)) {
+    return false;
+  }
+
+  float min_x = (float)kWidth;
+  float max_x = 0.0f;
+  float min_y = (float)kHeight;
+  float max_y = 0.0f;
+  float min_depth = 1.0f;
+
+  for (uint32_t i = 0; i < 8; i++) {
+    DirectX::XMFLOAT4 clip = TransformPoint(
+        _view_projection, (i & 1) ? bounds.max.x : bounds.min.x,
+        (i & 2) ? bounds.max.y : bounds.min.y,
+        (i & 4) ? bounds.max.z : bounds.min.z);
+
+    // Bounds touching the near plane are treated as visible
+    if (clip.w < kMinW || clip.z < 0.0f) {
+      return false;
+    }
+
+    float inv_w = 1.0f / clip.w;
+    float x = (clip.x * inv_w * 0.5f + 0.5f) * kWidth;
+    float y = (0.5f - clip.y * inv_w * 0.5f) * kHeight;
+    float depth = clip.z * inv_w;
+    min_x = x < min_x ? x : min_x;
+    max_x = x > max_x ? x : max_x;
+    min_y = y < min_y ? y : min_y;
+    max_y = y > max_y ? y : max_y;
+    min_depth = depth < min_depth ? depth : min_depth;
+  }
+
+  // Off screen bounds are the frustum culling's business
+  if (max_x < 0.0f || max_y < 0.0f || min_x >= kWidth || min_y >= kHeight) {
+    return false;
+  }
+
+  int32_t first_x = Clamp((int32_t)std::floor(min_x), 0, kWidth - 1);
+  int32_t last_x = Clamp((int32_t)std::floor(max_x), 0, kWidth - 1);
+  int32_t first_y = Clamp((int32_t)std::floor(min_y), 0, kHeight - 1);
+  int32_t last_y = Clamp((int32_t)std::floor(max_y), 0, kHeight - 1);
+
+  const int32_t tile_size = (int32_t)kTileSize;
+  for (int32_t tile_y = first_y / tile_size; tile_y <= last_y / tile_size;
+       tile_y++) {
+    for (int32_t tile_x = first_x / tile_size; tile_x <= last_x / tile_size;
+         tile_x++) {
+      if (_tile_depth[tile_y * kTilesX + tile_x] < min_depth) {
+        continue;
+      }
+
+      if (coarse) {
+        return false;
+      }
+
+      // Something in the tile is behind the bounds, the pixels under the
+      // rectangle decide
+      int32_t x0 = tile_x * tile_size;
+      int32_t y0 = tile_y * tile_size;
+      int32_t x1 = x0 + tile_size - 1 < last_x ? x0 + tile_size - 1 : last_x;
+      int32_t y1 = y0 + tile_size - 1 < last_y ? y0 + tile_size - 1 : last_y;
+      x0 = x0 > first_x ? x0 : first_x;
+      y0 = y0 > first_y ? y0 : first_y;
+
+      for (int32_t y = y0; y <= y1; y++) {
+        const float* row = _depth.data() + (size_t)y * kWidth;
+        for (int32_t x = x0; x <= x1; x++) {
+          if (row[x] >= min_depth) {
+            return false;
+          }
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+uint32_t RR::OcclusionCuller::triangle_count() const {
+  return (uint32_t)_triangles.size();
+}
+
+uint32_t RR::OcclusionCuller::version() const { return _version; }
+
+const float* RR::OcclusionCuller::depth() const { return _depth.data(); }
+
+const float* RR::OcclusionCuller::tile_depth() const {
+  return _tile_depth.data();
+}
@@ -0,0 +1,63 @@
+#include "renderer/prefab.h"
+
+#include "renderer/logger.h"
+#include "renderer/world.h"
+#include "renderer/components/camera_component.h"
+#include "renderer/components/local_transform_component.h"
+#include "renderer/components/renderer_component.h"
+
+int RR::Prefab::Capture(World* world, Entity root) {
+  _nodes.clear();
+
+  if (!world->IsValid(root)) {
+    LOG_WARNING("RR", "Trying to capture a prefab from an invalid entity");
+    return 1;
+  }
+
+  // Breadth first so parents are always captured before their children
+  std::vector<Entity> entities(1, root);
+  std::vector<int32_t> parents(1, -1);
+
+  for (size_t i = 0; i < entities.size(); i++) {
+    Node node = {};
+    node.components = world->Components(entities[i]);
+    node.parent = parents[i];
+    node.position = {0.0f, 0.0f, 0.0f};
+    node.rotation = {0.0f, 0.0f, 0.0f, 1.0f};
+    node.scale = {1.0f, 1.0f, 1.0f};
+    node.pipeline_type = kPipelineType_None;
+
+    LocalTransform* transform = world->GetComponent<LocalTransform>(entities[i]);
+    if (transform != nullptr) {
+      node.position = transform->position();
+      node.rotation = transform->quaternion();
+      node.scale = transform->scale();
+
+      world->hierarchy().Children(entities[i], &entities);
+      parents.resize(entities.size(), (int32_t)i);
+    }
+
+    Camera* camera = world->GetComponent<Camera>(entities[i]);
+    if (camera != nullptr) {
+      node.camera = *camera;
+    }
+
+    RendererComponent* renderer =
+        world->GetComponent<RendererComponent>(entities[i]);
+    if (renderer != nullptr) {
+      node.pipeline_type = renderer->pipeline_type();
+      node.geometries = renderer->geometries();
+      node.settings = renderer->settings;
+      node.texture_settings = renderer->textureSettings;
+      node.occluder = renderer->occluder;
+    }
+
+    _nodes.push_back(std::move(node));
+  }
+
+  return 0;
+}
+
+const std::vector<RR::Prefab::Node>& RR::Prefab::nodes() const {
+  return _nodes;
+}
@@ -0,0 +1,85 @@
+#include "renderer/radix_sort.h"
+
+#include <utility>
+
+#include "renderer/thread_pool.h"
+
+void RR::RadixSorter::Sort(ThreadPool* thread_pool,
+                           std::vector<uint64_t>* keys,
+                           std::vector<uint32_t>* values) {
+  uint32_t count = keys->size();
+  if (count < 2 || values->size() != count) {
+    return;
+  }
+
+  uint32_t chunks = (count + kChunkSize - 1) / kChunkSize;
+  _scratch_keys.resize(count);
+  _scratch_values.resize(count);
+  _histograms.resize(chunks * 256);
+  _chunk_bits.resize(chunks);
+
+  // Bytes every key shares with the first one can't change the order
+  uint64_t first = (*keys)[0];
+  thread_pool->ParallelFor(
+      count, kChunkSize, [this, keys, first](uint32_t begin, uint32_t end) {
+        uint64_t bits = 0U;
+        for (uint32_t i = begin; i < end; i++) {
+          bits |= (*keys)[i] ^ first;
+        }
+        _chunk_bits[begin / kChunkSize] = bits;
+      });
+
+  uint64_t bits = 0U;
+  for (uint32_t c = 0; c < chunks; c++) {
+    bits |= _chunk_bits[c];
+  }
+
+  for (uint32_t shift = 0; shift < 64; shift += 8) {
+    if (((bits >> shift) & 0xFF) == 0) {
+      continue;
+    }
+
+    const uint64_t* source_keys = keys->data();
+    const uint32_t* source_values = values->data();
+    uint64_t* target_keys = _scratch_keys.data();
+    uint32_t* target_values = _scratch_values.data();
+
+    thread_pool->ParallelFor(
+        count, kChunkSize,
+        [this, source_keys, shift](uint32_t begin, uint32_t end) {
+          uint32_t* histogram = _histograms.data() + begin / kChunkSize * 256;
+          for (uint32_t d = 0; d < 256; d++) {
+            histogram[d] = 0;
+          }
+
+          for (uint32_t i = begin; i < end; i++) {
+            histogram[(source_keys[i] >> shift) & 0xFF]++;
+          }
+        });
+
+    // Digit major, then chunk order, so equal digits keep their order
+    uint32_t offset = 0;
+    for (uint32_t d = 0; d < 256; d++) {
+      for (uint32_t c = 0; c < chunks; c++) {
+        uint32_t digits = _histograms[c * 256 + d];
+        _histograms[c * 256 + d] = offset;
+        offset += digits;
+      }
+    }
+
+    thread_pool->ParallelFor(
+        count, kChunkSize,
+        [this, source_keys, source_values, target_keys, target_values,
+         shift](uint32_t begin, uint32_t end) {
+          uint32_t* offsets = _histograms.data() + begin / kChunkSize * 256;
+          for (uint32_t i = begin; i < end; i++) {
+            uint32_t target = offsets[(source_keys[i] >> shift) & 0xFF]++;
+            target_keys[target] = source_keys[i];
+            target_values[target] = source_values[i];
+          }
+        });
+
+    std::swap(*keys, _scratch_keys);
+    std::swap(*values, _scratch_values);
+  }
+}
@@ -9,6 +9,9 @@
 #include <time.h>
 #include <windowsx.h>
 
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 #include <chrono>
 #include <string>
 
@@ -22,10 +25,23 @@
 #include "renderer/common.hpp"
 #include "renderer/window.h"
 #include "renderer/logger.h"
+#include "renderer/world.h"
+#include "renderer/entity_command_buffer.h"
+#include "renderer/prefab.h"
+#include "renderer/world_snapshot.h"
+#include "renderer/bounds.h"
+#include "renderer/frustum_culling.h"
+#include "renderer/bounding_volume_hierarchy.h"
+#include "renderer/fbx_mesh.h"
+#include "renderer/occlusion_culler.h"
+#include "renderer/radix_sort.h"
+#include "renderer/material_registry.h"
+#include "renderer/descriptor_allocator.h"
 #include "renderer/entity.h"
 #include "renderer/editor.h"
 #include "renderer/input.h"
 #include "renderer/graphics/texture.h"
+#include "renderer/graphics/upload_ring.h"
 #include "renderer/graphics/pipeline.h"
 #include "renderer/graphics/geometry.h"
 #include "renderer/components/camera_component.h"
@@ -93,7 +109,8 @@ RR::Renderer::Renderer() {}
 
 RR::Renderer::~Renderer() {}
 
-int RR::Renderer::Init(void* user_data, void (*update)(void*)) {
+int RR::Renderer::Init(void* user_data, void (*update)(void*),
+                       uint32_t worker_threads) {
   LOG_DEBUG("RR", "Initializing renderer");
   mtr_init("trace.json");
 
@@ -112,6 +129,14 @@ int RR::Renderer::Init(void* user_data, void (*update)(void*)) {
   _window = std::make_unique<RR::Window>();
   _input = std::make_unique<RR::Input>();
   _editor = std::make_unique<RR::Editor>();
+  _world = std::make_unique<RR::World>();
+  _commands = std::make_unique<RR::EntityCommandBuffer>();
+  _thread_pool = std::make_unique<RR::ThreadPool>();
+  _spatial_index = std::make_unique<RR::BoundingVolumeHierarchy>();
+  _occlusion_culler = std::make_unique<RR::OcclusionCuller>();
+  _draw_sorter = std::make_unique<RR::RadixSorter>();
+  _thread_pool->Init(worker_threads);
+  LOG_DEBUG("RR", "Worker threads: %u", _thread_pool->thread_count());
 
   _window->Init(GetModuleHandle(NULL), "winclass", "DX12 Graduation Project",
                 WindowProc, this);
@@ -124,6 +149,10 @@ int RR::Renderer::Init(void* user_data, void (*update)(void*)) {
 
   _geometries = std::vector<GFX::Geometry>(2000);
   _textures = std::vector<GFX::Texture>(700);
+  _geometry_data.resize(_geometries.size());
+  _texture_files.resize(_textures.size());
+  _texture_descriptors = std::vector<uint32_t>(
+      _textures.size(), DescriptorAllocator::kInvalidDescriptor);
 
   HRESULT result;
 
@@ -299,6 +328,25 @@ int RR::Renderer::Init(void* user_data, void (*update)(void*)) {
 
   _fence_event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
 
+  // Create upload rings
+  LOG_DEBUG("RR", "Creating upload rings");
+
+  for (uint16_t i = 0; i < kSwapchainBufferCount; i++) {
+    _upload_rings[i] = std::make_unique<RR::GFX::UploadRing>();
+    if (_upload_rings[i]->Init(_device, kUploadRingSize) != 0) {
+      LOG_ERROR("RR", "Couldn't create upload ring");
+      Cleanup();
+      return 1;
+    }
+  }
+
+  _material_registry = std::make_unique<RR::MaterialRegistry>();
+  if (_material_registry->Init(_device, kSwapchainBufferCount) != 0) {
+    LOG_ERROR("RR", "Couldn't create material registry");
+    Cleanup();
+    return 1;
+  }
+
   LOG_DEBUG("RR", "Creating depth stencil buffer");
   // Create depth stencil descriptor heap
   D3D12_DESCRIPTOR_HEAP_DESC depth_stencil_descriptor_heap_desc = {};
@@ -365,15 +413,30 @@ int RR::Renderer::Init(void* user_data, void (*update)(void*)) {
 
   D3D12_DESCRIPTOR_HEAP_DESC desc = {};
   desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-  desc.NumDescriptors = 1;
+  desc.NumDescriptors = kDescriptorHeapSize;
   desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 
-  result = _device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&_imgui_descriptor_heap));
+  result = _device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&_srv_descriptor_heap));
   if (FAILED(result)) {
-    LOG_ERROR("RR", "Couldn't create Imgui descriptor heap");
+    LOG_ERROR("RR", "Couldn't create SRV descriptor heap");
     Cleanup();
   }
 
+  _srv_descriptor_heap->SetName(L"SRV descriptor heap");
+  _srv_descriptor_size = _device->GetDescriptorHandleIncrementSize(
+      D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+  _descriptor_allocator = std::make_unique<RR::DescriptorAllocator>();
+  _descriptor_allocator->Init(kDescriptorHeapSize);
+
+  // The font texture takes a slot like any other texture
+  uint32_t font_descriptor = _descriptor_allocator->Allocate();
+  D3D12_CPU_DESCRIPTOR_HANDLE font_cpu_handle =
+      _srv_descriptor_heap->GetCPUDescriptorHandleForHeapStart();
+  D3D12_GPU_DESCRIPTOR_HANDLE font_gpu_handle =
+      _srv_descriptor_heap->GetGPUDescriptorHandleForHeapStart();
+  font_cpu_handle.ptr += (uint64_t)font_descriptor * _srv_descriptor_size;
+  font_gpu_handle.ptr += (uint64_t)font_descriptor * _srv_descriptor_size;
+
   IMGUI_CHECKVERSION();
   ImGui::CreateContext();
   ImGuiIO& io = ImGui::GetIO();
@@ -384,9 +447,8 @@ int RR::Renderer::Init(void* user_data, void (*update)(void*)) {
 
   ImGui_ImplWin32_Init(_window->window());
   ImGui_ImplDX12_Init(_device, kSwapchainBufferCount,
-                      DXGI_FORMAT_R8G8B8A8_UNORM, _imgui_descriptor_heap,
-                      _imgui_descriptor_heap->GetCPUDescriptorHandleForHeapStart(),
-                      _imgui_descriptor_heap->GetGPUDescriptorHandleForHeapStart());
+                      DXGI_FORMAT_R8G8B8A8_UNORM, _srv_descriptor_heap,
+                      font_cpu_handle, font_gpu_handle);
 
   printf("\n");
   LOG_DEBUG("RR", "Initializing pipelines");
@@ -464,17 +526,25 @@ void RR::Renderer::Start() {
     MTR_BEGIN("Renderer", "Wait for GPU");
     WaitForPreviousFrame();
     MTR_END("Renderer", "Wait for GPU");
+
+    _material_registry->BeginFrame(_current_frame);
+    ReleaseDestroyedResources(_current_frame);
+    _upload_rings[_current_frame]->Reset();
     
     MTR_BEGIN("Renderer", "Client update");
     _update(_user_data);
     MTR_END("Renderer", "Client update");
 
+    // Sync point, nothing iterates the world here
+    _commands->Playback(this);
+
     MTR_BEGIN("Renderer", "Internal update");
     InternalUpdate();
     MTR_END("Renderer", "Internal update");
 
     MTR_BEGIN("Renderer", "Show editor");
-    _editor->ShowEditor(&_entities, &_pipelines, &_geometries, &_textures);
+    _editor->ShowEditor(_world.get(), &_pipelines, &_geometries, &_textures,
+                        _occlusion_culler.get());
     MTR_END("Renderer", "Show editor");
 
     ImGui::Render();
@@ -517,20 +587,169 @@ void RR::Renderer::Resize() {
 
 bool RR::Renderer::initialized() const { return _initialized; }
 
-std::shared_ptr<RR::Entity> RR::Renderer::MainCamera() const {
+RR::World* RR::Renderer::world() const { return _world.get(); }
+
+RR::EntityCommandBuffer* RR::Renderer::commands() const {
+  return _commands.get();
+}
+
+RR::ThreadPool* RR::Renderer::thread_pool() const {
+  return _thread_pool.get();
+}
+
+const RR::BoundingVolumeHierarchy* RR::Renderer::spatial_index() const {
+  return _spatial_index.get();
+}
+
+RR::OcclusionCuller* RR::Renderer::occlusion_culler() const {
+  return _occlusion_culler.get();
+}
+
+RR::Entity RR::Renderer::MainCamera() const {
   return _main_camera;
 }
 
-std::shared_ptr<RR::Entity> RR::Renderer::RegisterEntity(
-    uint32_t component_types) {
+RR::Entity RR::Renderer::RegisterEntity(uint32_t component_types) {
   if (component_types == RR::ComponentTypes::kComponentType_None) {
     LOG_WARNING("RR", "Trying to register empty entity");
-    return nullptr;
+    return kInvalidEntity;
+  }
+
+  return _world->CreateEntity(component_types);
+}
+
+std::vector<RR::Entity> RR::Renderer::RegisterEntities(
+    uint32_t count, uint32_t component_types, uint32_t pipeline_type,
+    const uint32_t* geometry_counts) {
+  std::vector<Entity> entities;
+  if (component_types == RR::ComponentTypes::kComponentType_None) {
+    LOG_WARNING("RR", "Trying to register empty entities");
+    return entities;
+  }
+
+  MTR_BEGIN("Renderer", "Register entities");
+  _world->CreateEntities(count, component_types, &entities);
+
+  if ((component_types & RR::ComponentTypes::kComponentType_Renderer) &&
+      pipeline_type != RR::PipelineTypes::kPipelineType_None &&
+      geometry_counts != nullptr) {
+    for (size_t i = 0; i < entities.size(); i++) {
+      RendererComponent* renderer =
+          _world->GetComponent<RendererComponent>(entities[i]);
+      renderer->Init(pipeline_type, geometry_counts[i]);
+    }
+  }
+  MTR_END("Renderer", "Register entities");
+
+  return entities;
+}
+
+std::vector<RR::Entity> RR::Renderer::Instantiate(
+    const Prefab& prefab, uint32_t count, const LocalTransform* transforms) {
+  const std::vector<Prefab::Node>& nodes = prefab.nodes();
+  if (nodes.empty() || count == 0) {
+    return std::vector<Entity>();
+  }
+
+  MTR_BEGIN("Renderer", "Instantiate prefab");
+  // Entities of node n, copy i is entities[n][i]
+  std::vector<std::vector<Entity>> entities(nodes.size());
+
+  for (size_t n = 0; n < nodes.size(); n++) {
+    const Prefab::Node& node = nodes[n];
+
+    // Copies are created straight under the copies of their parent
+    _world->CreateEntities(
+        count, node.components, &entities[n],
+        node.parent >= 0 ? entities[node.parent].data() : nullptr);
+
+    if (entities[n].size() != count) {
+      LOG_WARNING("RR", "Couldn't create every prefab instance");
+      count = entities[n].size();
+
+      // Copies past count are missing this node, drop what earlier nodes
+      // already created for them, children first
+      for (size_t m = n; m-- > 0;) {
+        for (size_t i = count; i < entities[m].size(); i++) {
+          DestroyEntity(entities[m][i]);
+        }
+        entities[m].resize(count);
+      }
+    }
+
+    if (count == 0) {
+      continue;
+    }
+
+    // The batch is a run of consecutive rows, each column gets a range
+    // copy of the node. Geometries and textures are indices, copying
+    // shares them
+    const World::EntityRecord& record =
+        _world->_records[EntityIndex(entities[n][0])];
+    Archetype& archetype = _world->_archetypes[record.archetype];
+    uint32_t first = record.row;
+
+    if (node.components & kComponentType_LocalTransform) {
+      LocalTransform transform;
+      transform.SetPosition(node.position);
+      transform.SetQuaternion(node.rotation);
+      transform.SetScale(node.scale);
+
+      std::vector<LocalTransform>& column = archetype.Column<LocalTransform>();
+      std::fill_n(column.begin() + first, count, transform);
+
+      // The copy overwrote the parents CreateEntities linked
+      for (uint32_t i = 0; node.parent >= 0 && i < count; i++) {
+        column[first + i].parent = entities[node.parent][i];
+      }
+
+      for (uint32_t i = 0; n == 0 && transforms != nullptr && i < count;
+           i++) {
+        column[first + i].SetPosition(transforms[i].position());
+        column[first + i].SetQuaternion(transforms[i].quaternion());
+        column[first + i].SetScale(transforms[i].scale());
+      }
+    }
+
+    if (node.components & kComponentType_Camera) {
+      std::fill_n(archetype.Column<Camera>().begin() + first, count,
+                  node.camera);
+    }
+
+    if ((node.components & kComponentType_Renderer) &&
+        node.pipeline_type != kPipelineType_None) {
+      RendererComponent renderer;
+      renderer.Init(node.pipeline_type, node.geometries.size());
+      for (size_t k = 0; k < node.geometries.size(); k++) {
+        renderer.SetGeometry(k, node.geometries[k]);
+      }
+      renderer.settings = node.settings;
+      renderer.textureSettings = node.texture_settings;
+      renderer.occluder = node.occluder;
+
+      std::fill_n(archetype.Column<RendererComponent>().begin() + first, count,
+                  renderer);
+    }
+  }
+  MTR_END("Renderer", "Instantiate prefab");
+
+  return entities[0];
+}
+
+void RR::Renderer::DestroyEntity(Entity entity) {
+  if (entity == _main_camera) {
+    LOG_WARNING("RR", "Trying to destroy the main camera");
+    return;
+  }
+
+  RendererComponent* renderer = _world->GetComponent<RendererComponent>(entity);
+
+  if (renderer != nullptr) {
+    _destroyed_renderers[_current_frame].push_back(std::move(*renderer));
   }
 
-  std::shared_ptr<Entity> new_entity = std::make_shared<Entity>(component_types);
-  _entities.push_back(new_entity);
-  return new_entity;
+  _spatial_index->Remove(entity);
+  _world->DestroyEntity(entity);
 }
 
 int32_t RR::Renderer::CreateGeometry(uint32_t geometry_type, std::unique_ptr<GeometryData>&& data) {
@@ -539,7 +758,13 @@ int32_t RR::Renderer::CreateGeometry(uint32_t geometry_type, std::unique_ptr<Geo
       continue;
     }
 
-    _geometries[i].Init(_device, geometry_type, std::move(data));
+    // Init copies the data, the source is kept for SaveSnapshot
+    if (data == nullptr ||
+        _geometries[i].Init(_device, geometry_type, *data) != 0) {
+      return -1;
+    }
+
+    _geometry_data[i] = std::move(data);
     return i;
   }
 
@@ -552,8 +777,27 @@ int32_t RR::Renderer::LoadTexture(const wchar_t* file_name) {
       continue;
     }
 
+    uint32_t descriptor = _descriptor_allocator->Allocate();
+    if (descriptor == DescriptorAllocator::kInvalidDescriptor) {
+      LOG_ERROR("RR", "SRV descriptor heap is full");
+      return -1;
+    }
+
     int result = _textures[i].Init(_device, file_name);
-    return result != -1 ? i : -1;
+    if (result == -1) {
+      _descriptor_allocator->Free(descriptor);
+      return -1;
+    }
+
+    // Written once, materials only store the slot
+    D3D12_CPU_DESCRIPTOR_HANDLE handle =
+        _srv_descriptor_heap->GetCPUDescriptorHandleForHeapStart();
+    handle.ptr += (uint64_t)descriptor * _srv_descriptor_size;
+    _textures[i].CreateResourceView(_device, handle);
+
+    _texture_files[i] = file_name;
+    _texture_descriptors[i] = descriptor;
+    return i;
   }
 
   return -1;
@@ -603,143 +847,27 @@ std::shared_ptr<std::vector<RR::MeshData>> RR::Renderer::LoadFBXScene(const char
     printf("\n");
     LOG_DEBUG("RR", "Mesh %i/%i: %s", i + 1, mesh_count, mesh.name);
 
-    const ofbx::Vec3* vertices = geom.getVertices();
-    const ofbx::Vec3* normals = geom.getNormals();
-    const ofbx::Vec2* uvs = geom.getUVs();
-    const ofbx::Vec3* tangents = geom.getTangents();
-    const int* material_indices = geom.getMaterials();
-
-    const char* mesh_name = mesh.name;
-    const char* geo_name = geom.name;
-
-    int index_count = geom.getIndexCount();
-    int vertex_count = geom.getVertexCount();
     int material_count = mesh.getMaterialCount();
 
-    bool has_normals = normals != nullptr;
-    bool has_uvs = uvs != nullptr;
-    bool has_tangents = tangents != nullptr;
-
     ofbx::Matrix world = mesh.getGlobalTransform();
     ofbx::Vec3 position = mesh.getLocalTranslation();
     ofbx::Vec3 rotation = mesh.getLocalRotation();
     ofbx::Vec3 scale = mesh.getLocalScaling();
 
-    std::list<std::pair<int, RR::GeometryData>> material_data(0);
-
-    int normals_offset = (has_normals ? 3 : 0);
-    int tangents_offset = normals_offset + (has_tangents || has_uvs ? 3 : 0);
-    int uvs_offset = tangents_offset + (has_uvs ? 3 : 0);
-
-    int vertex_offset = 3 + (has_normals ? 3 : 0) + (has_tangents || has_uvs ? 3 : 0) + (has_uvs ? 2 : 0);
-
-    int material_index = 0;
-    int previous_count = 0;
-    for (int j = 0; j <= index_count / 3; j++) {
-      if (material_index == (material_indices == nullptr ? 0 : material_indices[j]) && j != index_count / 3) {
-        continue;
-      }
-
-      std::pair<int, RR::GeometryData> data;
-      data.first = material_index;
-      data.second.index_data.resize((j - previous_count) * 3);
-      data.second.vertex_data.resize(((j - previous_count) * 3) * vertex_offset);
-
-      material_data.emplace_back(data);
-
-      if (material_indices != nullptr) {
-        material_index = material_indices[j];
-      }
-
-      previous_count = j;
-    }
-
-    int previous_submesh_vertex_count = 0;
-    int submesh_count = 0;
-    for (std::list<std::pair<int, RR::GeometryData>>::iterator j = material_data.begin(); j != material_data.end(); j++) {
-      RR::GeometryData* data = &j->second;
-      for (int k = 0; k < data->index_data.size(); k++) {
-        data->index_data[k] = k;
-        data->vertex_data[k * vertex_offset + 0] = (float)vertices[previous_submesh_vertex_count + k].x;
-        data->vertex_data[k * vertex_offset + 1] = (float)vertices[previous_submesh_vertex_count + k].y;
-        data->vertex_data[k * vertex_offset + 2] = (float)vertices[previous_submesh_vertex_count + k].z;
-
-        if (has_normals) {
-          data->vertex_data[k * vertex_offset + normals_offset] = (float)normals[previous_submesh_vertex_count + k].x;
-          data->vertex_data[k * vertex_offset + normals_offset + 1] = (float)normals[previous_submesh_vertex_count + k].y;
-          data->vertex_data[k * vertex_offset + normals_offset + 2] = (float)normals[previous_submesh_vertex_count + k].z;
-        }
-
-        if (has_tangents) {
-          data->vertex_data[k * vertex_offset + tangents_offset] = (float)tangents[previous_submesh_vertex_count + k].x;
-          data->vertex_data[k * vertex_offset + tangents_offset + 1] = (float)tangents[previous_submesh_vertex_count + k].y;
-          data->vertex_data[k * vertex_offset + tangents_offset + 2] = (float)tangents[previous_submesh_vertex_count + k].z;
-        } else if (has_uvs && (k + 1) % 3 == 0) {
-          const ofbx::Vec3 p1 = vertices[previous_submesh_vertex_count + k - 2];
-          const ofbx::Vec3 p2 = vertices[previous_submesh_vertex_count + k - 1];
-          const ofbx::Vec3 p3 = vertices[previous_submesh_vertex_count + k - 0];
-        
-          const ofbx::Vec2 uv1 = uvs[previous_submesh_vertex_count + k - 2];
-          const ofbx::Vec2 uv2 = uvs[previous_submesh_vertex_count + k - 1];
-          const ofbx::Vec2 uv3 = uvs[previous_submesh_vertex_count + k - 0];
-
-          float edge1x = (float)(p2.x - p1.x);
-          float edge1y = (float)(p2.y - p1.y);
-          float edge1z = (float)(p2.z - p1.z);
-
-          float edge2x = (float)(p3.x - p1.x);
-          float edge2y = (float)(p3.y - p1.y);
-          float edge2z = (float)(p3.z - p1.z);
-
-          float deltaUV1x = (float)(uv2.x - uv1.x);
-          float deltaUV1y = (float)(uv2.y - uv1.y);
+    std::vector<FbxSubmesh> submeshes;
+    uint32_t geometry_type = ExpandFbxGeometry(geom, &submeshes);
 
-          float deltaUV2x = (float)(uv3.x - uv1.x);
-          float deltaUV2y = (float)(uv3.y - uv1.y);
-
-          float f = (deltaUV1x * deltaUV2y - deltaUV2x * deltaUV1y);
-
-          f = 1.0f / (f == 0.0f ? 1.0f : f);
-
-          float tangentX = f * (deltaUV2y * edge1x - deltaUV1y * edge2x);
-          float tangentY = f * (deltaUV2y * edge1y - deltaUV1y * edge2y);
-          float tangentZ = f * (deltaUV2y * edge1z - deltaUV1y * edge2z);
-
-          data->vertex_data[k * vertex_offset + tangents_offset] = tangentX;
-          data->vertex_data[k * vertex_offset + tangents_offset + 1] = tangentY;
-          data->vertex_data[k * vertex_offset + tangents_offset + 2] = tangentZ;
-
-          data->vertex_data[(k - 1) * vertex_offset + tangents_offset] = tangentX;
-          data->vertex_data[(k - 1) * vertex_offset + tangents_offset + 1] = tangentY;
-          data->vertex_data[(k - 1) * vertex_offset + tangents_offset + 2] = tangentZ;
-
-          data->vertex_data[(k - 2) * vertex_offset + tangents_offset] = tangentX;
-          data->vertex_data[(k - 2) * vertex_offset + tangents_offset + 1] = tangentY;
-          data->vertex_data[(k - 2) * vertex_offset + tangents_offset + 2] = tangentZ;
-        }
-
-        if (has_uvs) {
-          data->vertex_data[k * vertex_offset + uvs_offset] = (float)uvs[previous_submesh_vertex_count + k].x;
-          data->vertex_data[k * vertex_offset + uvs_offset + 1] = 1.0f - (float)uvs[previous_submesh_vertex_count + k].y;
-        }
-      }
-      
-      previous_submesh_vertex_count += data->index_data.size();
-
-      uint32_t geometry_type = RR::GeometryTypes::kGeometryType_None;
-      if (has_normals && has_uvs) {
-        geometry_type = RR::GeometryTypes::kGeometryType_Positions_Normals_Tangents_UV;
-      } else if (has_normals) {
-        geometry_type = RR::GeometryTypes::kGeometryType_Positions_Normals;
-      }
-
-      meshes.get()->at(i).geometries.push_back(CreateGeometry(geometry_type, std::move(std::make_unique<RR::GeometryData>(*data))));
+    for (size_t j = 0; j < submeshes.size(); j++) {
+      FbxSubmesh& submesh = submeshes[j];
+      meshes.get()->at(i).geometries.push_back(CreateGeometry(
+          geometry_type,
+          std::make_unique<RR::GeometryData>(std::move(submesh.data))));
       
       if (material_count == 0) {
         continue;
       }
 
-      const ofbx::Material* material = mesh.getMaterial(j->first);
+      const ofbx::Material* material = mesh.getMaterial(submesh.material);
       PBRSettings settings = {};
 
       settings.metallic = 0.0f;
@@ -863,6 +991,331 @@ std::shared_ptr<std::vector<RR::MeshData>> RR::Renderer::LoadFBXScene(const char
   return meshes;
 }
 
+int RR::Renderer::SaveSnapshot(const char* filename,
+                               const char* source_filename) {
+  MTR_BEGIN("Renderer", "Save world snapshot");
+
+  // Parents first, entities sharing components and pipeline next to each
+  // other so LoadSnapshot creates them with few RegisterEntities calls
+  struct SnapshotEntry {
+    uint32_t depth;
+    uint32_t components;
+    uint32_t pipeline_type;
+    Entity entity;
+  };
+
+  std::vector<SnapshotEntry> order;
+  order.reserve(_world->EntityCount());
+  uint32_t max_index = 0;
+
+  std::vector<Archetype>& archetypes = _world->archetypes();
+  for (size_t i = 0; i < archetypes.size(); i++) {
+    for (uint32_t row = 0; row < archetypes[i].size(); row++) {
+      SnapshotEntry entry = {};
+      entry.entity = archetypes[i].entities[row];
+      entry.depth = _world->hierarchy().Depth(entry.entity);
+      entry.components = archetypes[i].components();
+      entry.pipeline_type = kPipelineType_None;
+
+      RendererComponent* renderer = archetypes[i].Get<RendererComponent>(row);
+      if (renderer != nullptr && renderer->_initialized) {
+        entry.pipeline_type = renderer->pipeline_type();
+      }
+
+      order.push_back(entry);
+      if (EntityIndex(entry.entity) > max_index) {
+        max_index = EntityIndex(entry.entity);
+      }
+    }
+  }
+
+  std::sort(order.begin(), order.end(),
+            [](const SnapshotEntry& a, const SnapshotEntry& b) {
+              if (a.depth != b.depth) {
+                return a.depth < b.depth;
+              }
+              if (a.components != b.components) {
+                return a.components < b.components;
+              }
+              if (a.pipeline_type != b.pipeline_type) {
+                return a.pipeline_type < b.pipeline_type;
+              }
+              return a.entity < b.entity;
+            });
+
+  // Handles in the world are remapped to indices in the file
+  std::vector<int32_t> records(max_index + 1, -1);
+  std::vector<int32_t> geometry_records(_geometries.size(), -1);
+  std::vector<int32_t> texture_records(_textures.size(), -1);
+
+  std::vector<uint32_t> geometry_types;
+  std::vector<const GeometryData*> geometry_data;
+  std::vector<std::wstring> texture_files;
+
+  auto remap_geometry = [&](int32_t geometry) {
+    if (geometry < 0 || (size_t)geometry >= _geometry_data.size() ||
+        _geometry_data[geometry] == nullptr) {
+      return -1;
+    }
+
+    if (geometry_records[geometry] == -1) {
+      geometry_records[geometry] = geometry_data.size();
+      geometry_types.push_back(_geometries[geometry].Type());
+      geometry_data.push_back(_geometry_data[geometry].get());
+    }
+
+    return geometry_records[geometry];
+  };
+
+  auto remap_texture = [&](int32_t texture) {
+    if (texture < 0 || (size_t)texture >= _texture_files.size() ||
+        _texture_files[texture].empty()) {
+      return -1;
+    }
+
+    if (texture_records[texture] == -1) {
+      texture_records[texture] = texture_files.size();
+      texture_files.push_back(_texture_files[texture]);
+    }
+
+    return texture_records[texture];
+  };
+
+  std::vector<WorldSnapshot::EntityRecord> entities(order.size());
+  std::vector<WorldSnapshot::SlotRecord> slots;
+
+  for (size_t i = 0; i < order.size(); i++) {
+    Entity entity = order[i].entity;
+    WorldSnapshot::EntityRecord& record = entities[i];
+
+    records[EntityIndex(entity)] = i;
+
+    record.components = order[i].components;
+    record.flags = entity == _main_camera
+                       ? WorldSnapshot::kEntityFlag_MainCamera
+                       : 0U;
+    record.pipeline_type = order[i].pipeline_type;
+    record.position = {0.0f, 0.0f, 0.0f};
+    record.rotation = {0.0f, 0.0f, 0.0f, 1.0f};
+    record.scale = {1.0f, 1.0f, 1.0f};
+
+    Entity parent = _world->hierarchy().Parent(entity);
+    record.parent =
+        parent != kInvalidEntity ? records[EntityIndex(parent)] : -1;
+
+    LocalTransform* transform = _world->GetComponent<LocalTransform>(entity);
+    if (transform != nullptr) {
+      record.position = transform->position();
+      record.rotation = transform->quaternion();
+      record.scale = transform->scale();
+    }
+
+    Camera* camera = _world->GetComponent<Camera>(entity);
+    if (camera != nullptr) {
+      record.fov = camera->fov;
+      record.near_z = camera->nearZ;
+      record.far_z = camera->farZ;
+      std::copy(camera->clear_color, camera->clear_color + 4,
+                record.clear_color);
+    }
+
+    record.first_slot = slots.size();
+    RendererComponent* renderer =
+        _world->GetComponent<RendererComponent>(entity);
+    if (renderer != nullptr && renderer->_initialized) {
+      record.flags |= renderer->occluder ? WorldSnapshot::kEntityFlag_Occluder
+                                         : 0U;
+      for (size_t j = 0; j < renderer->geometries().size(); j++) {
+        WorldSnapshot::SlotRecord slot = {};
+        slot.geometry = remap_geometry(renderer->geometries()[j]);
+        slot.settings = renderer->settings[j];
+
+        const PBRTextures& source = renderer->textureSettings[j].pbr_textures;
+        PBRTextures& textures = slot.textures.pbr_textures;
+        textures.base_color = remap_texture(source.base_color);
+        textures.normal = remap_texture(source.normal);
+        textures.metallic = remap_texture(source.metallic);
+        textures.roughness = remap_texture(source.roughness);
+        textures.reflectance = remap_texture(source.reflectance);
+
+        slots.push_back(slot);
+      }
+    }
+    record.slot_count = slots.size() - record.first_slot;
+  }
+
+  int result =
+      WorldSnapshot::Write(filename, entities, slots, geometry_types,
+                           geometry_data, texture_files, source_filename);
+
+  MTR_END("Renderer", "Save world snapshot");
+
+  if (result == 0) {
+    LOG_DEBUG("RR", "Saved snapshot %s: %i entities, %i geometries",
+              filename, entities.size(), geometry_data.size());
+  }
+
+  return result;
+}
+
+static int32_t RemapSnapshotTexture(int32_t texture,
+                                    const std::vector<int32_t>& textures) {
+  return texture != -1 ? textures[texture] : -1;
+}
+
+int RR::Renderer::LoadSnapshot(const char* filename,
+                               std::vector<Entity>* roots,
+                               const char* source_filename) {
+  std::chrono::time_point<std::chrono::steady_clock> load_start =
+      std::chrono::steady_clock::now();
+  MTR_BEGIN("Renderer", "Load world snapshot");
+
+  WorldSnapshot snapshot;
+  if (snapshot.Map(filename, source_filename) != 0) {
+    MTR_END("Renderer", "Load world snapshot");
+    return 1;
+  }
+
+  const WorldSnapshot::Header* header = snapshot.header();
+  uint32_t entity_count = header->entity_count;
+
+  // Textures already loaded, by the scene or an earlier snapshot, are
+  // shared instead of loaded again
+  std::vector<int32_t> textures(header->texture_count, -1);
+  for (uint32_t i = 0; i < header->texture_count; i++) {
+    const wchar_t* name = snapshot.textures()[i].name.data;
+    for (size_t j = 0; j < _texture_files.size() && textures[i] == -1; j++) {
+      if (_textures[j].Initialized() && _texture_files[j] == name) {
+        textures[i] = j;
+      }
+    }
+
+    if (textures[i] == -1) {
+      textures[i] = LoadTexture(name);
+    }
+  }
+
+  std::vector<int32_t> geometries(header->geometry_count);
+  for (uint32_t i = 0; i < header->geometry_count; i++) {
+    const WorldSnapshot::GeometryRecord& record = snapshot.geometries()[i];
+
+    std::unique_ptr<GeometryData> data = std::make_unique<GeometryData>();
+    data->vertex_data.assign(record.vertices.data,
+                             record.vertices.data + record.vertex_count);
+    data->index_data.assign(record.indices.data,
+                            record.indices.data + record.index_count);
+    geometries[i] = CreateGeometry(record.type, std::move(data));
+  }
+
+  UpdateGraphicResources();
+
+  // Consecutive records with the same components and pipeline are
+  // created by one RegisterEntities call
+  const WorldSnapshot::EntityRecord* records = snapshot.entities();
+  std::vector<Entity> entities(header->entity_count, kInvalidEntity);
+  std::vector<uint32_t> geometry_counts;
+
+  uint32_t first = 0;
+  while (first < header->entity_count) {
+    if (records[first].flags & WorldSnapshot::kEntityFlag_MainCamera) {
+      entities[first] = _main_camera;
+      first++;
+      continue;
+    }
+
+    uint32_t last = first + 1;
+    while (last < header->entity_count &&
+           (records[last].flags & WorldSnapshot::kEntityFlag_MainCamera) == 0 &&
+           records[last].components == records[first].components &&
+           records[last].pipeline_type == records[first].pipeline_type) {
+      last++;
+    }
+
+    geometry_counts.resize(last - first);
+    for (uint32_t i = first; i < last; i++) {
+      geometry_counts[i - first] = records[i].slot_count;
+    }
+
+    std::vector<Entity> created =
+        RegisterEntities(last - first, records[first].components,
+                         records[first].pipeline_type, geometry_counts.data());
+    std::copy(created.begin(), created.end(), entities.begin() + first);
+
+    first = last;
+  }
+
+  const WorldSnapshot::SlotRecord* slots = snapshot.slots();
+  for (uint32_t i = 0; i < header->entity_count; i++) {
+    const WorldSnapshot::EntityRecord& record = records[i];
+    Entity entity = entities[i];
+
+    if (entity == kInvalidEntity) {
+      continue;
+    }
+
+    LocalTransform* transform = _world->GetComponent<LocalTransform>(entity);
+    if (transform != nullptr) {
+      transform->SetPosition(record.position);
+      transform->SetQuaternion(record.rotation);
+      transform->SetScale(record.scale);
+    }
+
+    Camera* camera = _world->GetComponent<Camera>(entity);
+    if (camera != nullptr) {
+      camera->fov = record.fov;
+      camera->nearZ = record.near_z;
+      camera->farZ = record.far_z;
+      std::copy(record.clear_color, record.clear_color + 4,
+                camera->clear_color);
+    }
+
+    RendererComponent* renderer =
+        _world->GetComponent<RendererComponent>(entity);
+    if (renderer != nullptr && renderer->_initialized) {
+      renderer->occluder =
+          (record.flags & WorldSnapshot::kEntityFlag_Occluder) != 0;
+      size_t count = renderer->geometries().size() < record.slot_count
+                         ? renderer->geometries().size()
+                         : record.slot_count;
+      for (size_t j = 0; j < count; j++) {
+        const WorldSnapshot::SlotRecord& slot = slots[record.first_slot + j];
+        const PBRTextures& source = slot.textures.pbr_textures;
+        PBRTextures& pbr_textures = renderer->textureSettings[j].pbr_textures;
+
+        renderer->SetGeometry(
+            j, slot.geometry != -1 ? geometries[slot.geometry] : -1);
+        renderer->settings[j] = slot.settings;
+        pbr_textures.base_color =
+            RemapSnapshotTexture(source.base_color, textures);
+        pbr_textures.normal = RemapSnapshotTexture(source.normal, textures);
+        pbr_textures.metallic =
+            RemapSnapshotTexture(source.metallic, textures);
+        pbr_textures.roughness =
+            RemapSnapshotTexture(source.roughness, textures);
+        pbr_textures.reflectance =
+            RemapSnapshotTexture(source.reflectance, textures);
+      }
+    }
+
+    if (record.parent != -1 && entities[record.parent] != kInvalidEntity) {
+      _world->SetParent(entity, entities[record.parent]);
+    } else if (roots != nullptr && entity != _main_camera) {
+      roots->push_back(entity);
+    }
+  }
+
+  snapshot.Unmap();
+  MTR_END("Renderer", "Load world snapshot");
+
+  LOG_DEBUG("RR", "Loaded snapshot %s in %.2f ms: %i entities", filename,
+            std::chrono::duration<float, std::milli>(
+                std::chrono::steady_clock::now() - load_start)
+                .count(),
+            entity_count);
+
+  return 0;
+}
+
 void RR::Renderer::CaptureMouse() { 
   _window->CaptureMouse();
 
@@ -963,67 +1416,284 @@ void RR::Renderer::UpdateGraphicResources() {
   _command_queue->Signal(_fences[_current_frame], 1);
 }
 
+void RR::Renderer::ReleaseDestroyedResources(uint16_t frame) {
+  for (size_t i = 0; i < _destroyed_renderers[frame].size(); i++) {
+    _destroyed_renderers[frame][i].Release();
+  }
+
+  _destroyed_renderers[frame].clear();
+}
+
 void RR::Renderer::InternalUpdate() {
-  std::map<uint32_t, std::list<std::pair<std::shared_ptr<LocalTransform>, std::shared_ptr<WorldTransform>>>> components;
-
-  MTR_BEGIN("Renderer", "Populate local transform list");
-  // Prepare parent and child components
-  // 💀💀💀
-  uint32_t max_parent_level = 0;
-  for (uint32_t level = 0; level <= max_parent_level; level++) {
-    for (std::list<std::shared_ptr<Entity>>::iterator i = _entities.begin(); i != _entities.end(); i++) {
-      std::shared_ptr<LocalTransform> local_transform =
-          std::static_pointer_cast<LocalTransform>(
-              i->get()->GetComponent(ComponentTypes::kComponentType_LocalTransform));
-    
-      if (local_transform == nullptr) {
-        continue;
-      }
+  MTR_BEGIN("Renderer", "Update world transforms");
+  // Only changed transforms and their descendants are rebuilt, one
+  // hierarchy level at a time split across the worker threads
+  uint32_t recomputed = _world->UpdateTransforms(_thread_pool.get());
+  MTR_END("Renderer", "Update world transforms");
+  MTR_COUNTER("Renderer", "World matrices recomputed", recomputed);
 
-      if (local_transform->level > max_parent_level) {
-        max_parent_level = local_transform->level;
-      }
+  MTR_BEGIN("Renderer", "Update world bounds");
+  uint32_t bounds = UpdateBounds();
+  MTR_END("Renderer", "Update world bounds");
+  MTR_COUNTER("Renderer", "World bounds recomputed", bounds);
+}
 
-      std::shared_ptr<WorldTransform> world_transform =
-          std::static_pointer_cast<WorldTransform>(
-              i->get()->GetComponent(ComponentTypes::kComponentType_WorldTransform));
+uint32_t RR::Renderer::UpdateBounds() {
+  std::mutex changed_mutex;
+  std::vector<std::pair<Entity, Bounds>> changed;
 
-      std::pair<std::shared_ptr<LocalTransform>, std::shared_ptr<WorldTransform>> pair;
+  const std::vector<uint32_t>& drawables =
+      _world->Query(RendererComponent::kType | WorldTransform::kType);
+  std::vector<Archetype>& archetypes = _world->archetypes();
 
-      pair.first = local_transform;
-      pair.second = world_transform;
-      components[local_transform->level].push_back(pair);
-    }
+  for (size_t i = 0; i < drawables.size(); i++) {
+    Archetype& archetype = archetypes[drawables[i]];
+
+    _thread_pool->ParallelFor(
+        archetype.size(), kBoundsChunkSize,
+        [this, &archetype, &changed_mutex, &changed](
+            uint32_t begin, uint32_t end) {
+          std::vector<std::pair<Entity, Bounds>> chunk_changed;
+
+          for (uint32_t row = begin; row < end; row++) {
+            RendererComponent& renderer = archetype.renderers[row];
+            WorldTransform& world_transform = archetype.world_transforms[row];
+
+            if (!renderer._initialized ||
+                renderer._bounds_version == world_transform._version) {
+              continue;
+            }
+
+            Bounds local = EmptyBounds();
+            for (size_t k = 0; k < renderer.geometries().size(); k++) {
+              int32_t geometry = renderer.geometries()[k];
+              if (geometry >= 0 && (size_t)geometry < _geometries.size() &&
+                  _geometries[geometry].Initialized()) {
+                local = MergeBounds(local, _geometries[geometry].bounds());
+              }
+            }
+
+            world_transform.bounds =
+                TransformBounds(local, world_transform.world);
+            renderer._bounds_version = world_transform._version;
+            chunk_changed.push_back(
+                {archetype.entities[row], world_transform.bounds});
+          }
+
+          if (!chunk_changed.empty()) {
+            std::lock_guard<std::mutex> lock(changed_mutex);
+            changed.insert(changed.end(), chunk_changed.begin(),
+                           chunk_changed.end());
+          }
+        });
   }
-  MTR_END("Renderer", "Populate local transform list");
 
-  MTR_BEGIN("Renderer", "Update world transforms");
-  // Calculate world positions
-  for (uint32_t level = 0; level <= max_parent_level; level++) {
-    for (std::list<std::pair<std::shared_ptr<LocalTransform>, std::shared_ptr<WorldTransform>>>::iterator i = components[level].begin();
-         i != components[level].end(); i++) {
+  // The tree is not thread safe, it is updated once every chunk is done.
+  // Chunks finish in any order, sorting keeps the tree shape, and so the
+  // query and draw order, the same from run to run
+  std::sort(changed.begin(), changed.end(),
+            [](const std::pair<Entity, Bounds>& a,
+               const std::pair<Entity, Bounds>& b) {
+              return a.first < b.first;
+            });
+  for (size_t i = 0; i < changed.size(); i++) {
+    _spatial_index->Update(changed[i].first, changed[i].second);
+  }
+
+  return changed.size();
+}
+
+uint32_t RR::Renderer::CullArchetype(Archetype& archetype,
+                                     const Frustum& frustum,
+                                     uint32_t* culled) {
+  uint32_t rows = archetype.size();
+  uint32_t chunks = (rows + kCullingChunkSize - 1) / kCullingChunkSize;
+
+  _culling.center_x.resize(rows);
+  _culling.center_y.resize(rows);
+  _culling.center_z.resize(rows);
+  _culling.extent_x.resize(rows);
+  _culling.extent_y.resize(rows);
+  _culling.extent_z.resize(rows);
+  _culling.visible.resize(rows);
+  _culling.chunk_visible.resize(chunks);
+  _culling.chunk_skipped.resize(chunks);
+
+  BoxStreams boxes = {_culling.center_x.data(), _culling.center_y.data(),
+                      _culling.center_z.data(), _culling.extent_x.data(),
+                      _culling.extent_y.data(), _culling.extent_z.data()};
+
+  // Every chunk writes its visible rows at its own start, they are
+  // packed together afterwards
+  _thread_pool->ParallelFor(
+      rows, kCullingChunkSize,
+      [this, &archetype, &frustum, &boxes](uint32_t begin, uint32_t end) {
+        uint32_t skipped = 0U;
+        for (uint32_t row = begin; row < end; row++) {
+          const Bounds& bounds = archetype.world_transforms[row].bounds;
+
+          // Nothing to draw, negative extents are always culled
+          if (!archetype.renderers[row]._initialized || IsEmpty(bounds)) {
+            _culling.center_x[row] = 0.0f;
+            _culling.center_y[row] = 0.0f;
+            _culling.center_z[row] = 0.0f;
+            _culling.extent_x[row] = -1.0f;
+            _culling.extent_y[row] = -1.0f;
+            _culling.extent_z[row] = -1.0f;
+            skipped++;
+            continue;
+          }
+
+          _culling.center_x[row] = (bounds.min.x + bounds.max.x) * 0.5f;
+          _culling.center_y[row] = (bounds.min.y + bounds.max.y) * 0.5f;
+          _culling.center_z[row] = (bounds.min.z + bounds.max.z) * 0.5f;
+          _culling.extent_x[row] = (bounds.max.x - bounds.min.x) * 0.5f;
+          _culling.extent_y[row] = (bounds.max.y - bounds.min.y) * 0.5f;
+          _culling.extent_z[row] = (bounds.max.z - bounds.min.z) * 0.5f;
+        }
+
+        _culling.chunk_skipped[begin / kCullingChunkSize] = skipped;
+        _culling.chunk_visible[begin / kCullingChunkSize] = CullBoxes(
+            frustum, boxes, begin, end, _culling.visible.data() + begin);
+      });
+
+  uint32_t visible = 0U;
+  for (uint32_t c = 0; c < chunks; c++) {
+    uint32_t* first = _culling.visible.data() + c * kCullingChunkSize;
+    std::copy(first, first + _culling.chunk_visible[c],
+              _culling.visible.data() + visible);
+    visible += _culling.chunk_visible[c];
+    *culled += (uint32_t)(c + 1U < chunks ? kCullingChunkSize
+                                          : rows - c * kCullingChunkSize) -
+               _culling.chunk_visible[c] - _culling.chunk_skipped[c];
+  }
+
+  return visible;
+}
+
+// Draw sort key, most significant first:
+//   8 bits pipeline type
+//  16 bits material handle
+//  20 bits geometry
+//  20 bits depth, 0 to 1 from the camera to the far plane
+static uint64_t DrawKey(uint32_t pipeline_type, uint32_t material,
+                        int32_t geometry, float depth) {
+  const uint32_t kDepthBuckets = (1U << 20) - 1U;
+
+  depth = depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+
+  return ((uint64_t)(pipeline_type & 0xFF) << 56) |
+         ((uint64_t)(material & 0xFFFF) << 40) |
+         ((uint64_t)((uint32_t)geometry & 0xFFFFF) << 20) |
+         (uint64_t)(depth * kDepthBuckets);
+}
+
+uint32_t RR::Renderer::CullOccluded(
+    const DirectX::XMFLOAT4X4& view_projection) {
+  _occlusion_culler->Begin(view_projection);
 
-       DirectX::XMMATRIX world = DirectX::XMMatrixIdentity() * 
-         DirectX::XMMatrixScalingFromVector(DirectX::XMLoadFloat3(&i->first->scale))
-         * DirectX::XMMatrixRotationX(DirectX::XMConvertToRadians(i->first->rotation.x)) *
-               DirectX::XMMatrixRotationY(DirectX::XMConvertToRadians(i->first->rotation.y)) *
-               DirectX::XMMatrixRotationZ(DirectX::XMConvertToRadians(i->first->rotation.z)) * 
-         DirectX::XMMatrixTranslationFromVector(DirectX::XMLoadFloat3(&i->first->position));
+  // Only occluders that survived frustum culling are rasterized
+  for (size_t v = 0; v < _visible_renderers.size(); v++) {
+    const RendererComponent* renderer = _visible_renderers[v].renderer;
+    if (!renderer->occluder) {
+      continue;
+    }
+
+    for (size_t k = 0; k < renderer->geometries().size(); k++) {
+      int32_t geometry = renderer->geometries()[k];
+      if (geometry < 0 || geometry >= (int32_t)_geometry_data.size() ||
+          _geometry_data[geometry] == nullptr) {
+        continue;
+      }
 
+      const GeometryData* data = _geometry_data[geometry].get();
+      uint32_t stride = _geometries[geometry].Stride() / sizeof(float);
+      if (stride == 0) {
+        continue;
+      }
 
-       if (level != 0) {
-         std::shared_ptr<WorldTransform> parent_world =
-             std::static_pointer_cast<WorldTransform>(
-                 i->first->parent->GetComponent(
-                     ComponentTypes::kComponentType_WorldTransform));
+      _occlusion_culler->AddOccluder(
+          _visible_renderers[v].world_transform->world,
+          data->vertex_data.data(), stride,
+          (uint32_t)(data->vertex_data.size() / stride),
+          data->index_data.data(), (uint32_t)data->index_data.size());
+    }
+  }
+  MTR_COUNTER("Renderer", "Occluder triangles",
+              _occlusion_culler->triangle_count());
 
-         world = world * DirectX::XMLoadFloat4x4(&parent_world->world);
-       }
+  if (_occlusion_culler->triangle_count() == 0) {
+    return 0U;
+  }
 
-       DirectX::XMStoreFloat4x4(&i->second->world, world);
+  MTR_BEGIN("Renderer", "Rasterize occluders");
+  _occlusion_culler->Rasterize(_thread_pool.get());
+  MTR_END("Renderer", "Rasterize occluders");
+
+  uint32_t frame = _culling_frame;
+  uint32_t interval = _occlusion_culler->retest_interval > 0U
+                          ? _occlusion_culler->retest_interval
+                          : 1U;
+  // A new camera or occluder set invalidates every kept result
+  uint32_t version = _occlusion_culler->version();
+
+  uint32_t count = _visible_renderers.size();
+  _occluded.resize(count);
+  std::atomic<uint32_t> full_tests(0U);
+  _thread_pool->ParallelFor(
+      count, kOcclusionChunkSize,
+      [this, frame, interval, version, &full_tests](uint32_t begin,
+                                                    uint32_t end) {
+        uint32_t tests = 0U;
+        for (uint32_t i = begin; i < end; i++) {
+          RendererComponent* renderer = _visible_renderers[i].renderer;
+          const Bounds& bounds = _visible_renderers[i].world_transform->bounds;
+
+          // Occluders are never tested, they would hide themselves
+          if (renderer->occluder) {
+            _occluded[i] = 0;
+            continue;
+          }
+
+          // Entities created together get consecutive indices, so their
+          // full tests are spread evenly over the interval
+          uint32_t phase = EntityIndex(_visible_renderers[i].entity);
+          bool coherent =
+              renderer->_occlusion_frame + 1U == frame &&
+              renderer->_occlusion_bounds_version ==
+                  renderer->_bounds_version &&
+              renderer->_occlusion_culler_version == version &&
+              (frame + phase) % interval != 0U;
+          renderer->_occlusion_frame = frame;
+
+          if (coherent && renderer->_occluded) {
+            _occluded[i] = 1;
+            continue;
+          }
+
+          if (coherent) {
+            renderer->_occluded = _occlusion_culler->IsOccluded(bounds, true);
+          } else {
+            renderer->_occluded = _occlusion_culler->IsOccluded(bounds);
+            renderer->_occlusion_bounds_version = renderer->_bounds_version;
+            renderer->_occlusion_culler_version = version;
+            tests++;
+          }
+          _occluded[i] = renderer->_occluded ? 1 : 0;
+        }
+        full_tests += tests;
+      });
+  MTR_COUNTER("Renderer", "Full occlusion tests", full_tests.load());
+
+  uint32_t visible = 0U;
+  for (uint32_t i = 0; i < count; i++) {
+    if (_occluded[i] == 0) {
+      _visible_renderers[visible++] = _visible_renderers[i];
     }
   }
-  MTR_END("Renderer", "Update world transforms");
+  _visible_renderers.resize(visible);
+
+  return count - visible;
 }
 
 void RR::Renderer::UpdatePipeline() { 
@@ -1040,12 +1710,10 @@ void RR::Renderer::UpdatePipeline() {
   }
 
   MTR_BEGIN("Renderer", "Update main camera");
-  std::shared_ptr<WorldTransform> camera_world =
-      std::static_pointer_cast<WorldTransform>(_main_camera->GetComponent(
-          ComponentTypes::kComponentType_WorldTransform));
+  WorldTransform* camera_world =
+      _world->GetComponent<WorldTransform>(_main_camera);
 
-  std::shared_ptr<Camera> camera = std::static_pointer_cast<Camera>(
-      _main_camera->GetComponent(ComponentTypes::kComponentType_Camera));
+  Camera* camera = _world->GetComponent<Camera>(_main_camera);
 
   DirectX::XMMATRIX view = DirectX::XMMatrixLookToLH(
       DirectX::XMVectorSet(camera_world->world._41, camera_world->world._42,
@@ -1058,36 +1726,176 @@ void RR::Renderer::UpdatePipeline() {
   DirectX::XMMATRIX projection = DirectX::XMMatrixPerspectiveFovLH(
       camera->fov * (3.14f / 180.0f), _window->aspectRatio(), camera->nearZ,
       camera->farZ);
+
+  DirectX::XMFLOAT4X4 view_projection;
+  DirectX::XMStoreFloat4x4(&view_projection,
+                           DirectX::XMMatrixMultiply(view, projection));
+  Frustum frustum = ExtractFrustum(view_projection);
   MTR_END("Renderer", "Update main camera");
 
   MTR_BEGIN("Renderer", "Populate render list");
-  std::map<uint32_t, std::list<std::shared_ptr<RendererComponent>>> render_list;
-  for (std::list<std::shared_ptr<Entity>>::iterator i = _entities.begin();
-       i != _entities.end(); i++) {
-    std::shared_ptr<RendererComponent> renderer =
-        std::static_pointer_cast<RendererComponent>(
-            i->get()->GetComponent(ComponentTypes::kComponentType_Renderer));
-
-    std::shared_ptr<WorldTransform> world_transform =
-        std::static_pointer_cast<WorldTransform>(i->get()->GetComponent(
-            ComponentTypes::kComponentType_WorldTransform));
-
-    if (renderer == nullptr || world_transform == nullptr) {
-      continue;
+  // Only archetypes that can be drawn are visited
+  const std::vector<uint32_t>& drawables =
+      _world->Query(RendererComponent::kType | WorldTransform::kType);
+
+  uint32_t drawable_count = 0U;
+  std::vector<Archetype>& archetypes = _world->archetypes();
+  for (size_t i = 0; i < drawables.size(); i++) {
+    drawable_count += archetypes[drawables[i]].size();
+  }
+
+  _visible_renderers.clear();
+  uint32_t culled = 0U;
+  if (drawable_count >= kSpatialCullingThreshold) {
+    // Whole subtrees outside, or inside, the frustum are resolved at once
+    MTR_BEGIN("Renderer", "Spatial index culling");
+    _visible_entities.clear();
+    _spatial_index->QueryFrustum(frustum, &_visible_entities);
+    MTR_END("Renderer", "Spatial index culling");
+    // The index only holds drawables with bounds
+    culled = _spatial_index->size() - (uint32_t)_visible_entities.size();
+
+    for (size_t v = 0; v < _visible_entities.size(); v++) {
+      RendererComponent* renderer =
+          _world->GetComponent<RendererComponent>(_visible_entities[v]);
+      WorldTransform* world_transform =
+          _world->GetComponent<WorldTransform>(_visible_entities[v]);
+
+      if (renderer != nullptr && world_transform != nullptr &&
+          renderer->_initialized) {
+        _visible_renderers.push_back(
+            {_visible_entities[v], renderer, world_transform});
+      }
     }
+  } else {
+    for (size_t i = 0; i < drawables.size(); i++) {
+      Archetype& archetype = archetypes[drawables[i]];
+
+      MTR_BEGIN("Renderer", "Frustum culling");
+      uint32_t visible = CullArchetype(archetype, frustum, &culled);
+      MTR_END("Renderer", "Frustum culling");
+
+      for (uint32_t v = 0; v < visible; v++) {
+        uint32_t row = _culling.visible[v];
+        _visible_renderers.push_back({archetype.entities[row],
+                                      &archetype.renderers[row],
+                                      &archetype.world_transforms[row]});
+      }
+    }
+  }
 
-    if (!renderer->_initialized) {
-      continue;
+  _culling_frame++;
+  uint32_t occluded = 0U;
+  if (_occlusion_culler->enabled) {
+    MTR_BEGIN("Renderer", "Occlusion culling");
+    occluded = CullOccluded(view_projection);
+    MTR_END("Renderer", "Occlusion culling");
+  }
+
+  // Depth along the camera forward axis, front to back inside a state
+  // group
+  DirectX::XMVECTOR camera_position = DirectX::XMVectorSet(
+      camera_world->world._41, camera_world->world._42,
+      camera_world->world._43, 0.0f);
+  DirectX::XMVECTOR camera_forward = DirectX::XMVector3Normalize(
+      DirectX::XMVectorSet(camera_world->world._31, camera_world->world._32,
+                           camera_world->world._33, 0.0f));
+  float inverse_far = camera->farZ > 0.0f ? 1.0f / camera->farZ : 0.0f;
+
+  _draw_packets.clear();
+  _draw_keys.clear();
+  for (size_t v = 0; v < _visible_renderers.size(); v++) {
+    RendererComponent* renderer = _visible_renderers[v].renderer;
+    WorldTransform* world_transform = _visible_renderers[v].world_transform;
+
+    float depth = DirectX::XMVectorGetX(DirectX::XMVector3Dot(
+        DirectX::XMVectorSubtract(
+            DirectX::XMLoadFloat3(&world_transform->bounds.center),
+            camera_position),
+        camera_forward));
+
+    GFX::Pipeline& pipeline = _pipelines[renderer->_pipeline_type];
+    for (size_t k = 0; k < renderer->geometries().size(); k++) {
+      int32_t geometry = renderer->geometries()[k];
+      if (geometry < 0 || geometry >= (int32_t)_geometries.size()) {
+        LOG_WARNING("RR", "Renderer has invalid geometry");
+        continue;
+      }
+
+      if (pipeline.GeometryType() != _geometries[geometry].Type()) {
+        LOG_WARNING("RR", "Traying to draw geometry with incompatible pipeline");
+        continue;
+      }
+
+      // Resolves the material again only when its settings changed
+      if (renderer->Update(_material_registry.get(), _texture_descriptors,
+                           k) != 0) {
+        LOG_WARNING("RR", "Couldn't get renderer material");
+        continue;
+      }
+
+      MaterialHandle material = renderer->material(k);
+      _draw_keys.push_back(DrawKey(renderer->_pipeline_type, material,
+                                   geometry, depth * inverse_far));
+      _draw_packets.push_back({&world_transform->world,
+                               renderer->_pipeline_type, geometry, material});
     }
+  }
+
+  _draw_order.resize(_draw_packets.size());
+  for (uint32_t i = 0; i < _draw_order.size(); i++) {
+    _draw_order[i] = i;
+  }
 
-    MVPStruct mvp = {};
-    DirectX::XMStoreFloat4x4(&mvp.view, DirectX::XMMatrixTranspose(view));
-    DirectX::XMStoreFloat4x4(&mvp.projection, DirectX::XMMatrixTranspose(projection));
-    DirectX::XMStoreFloat4x4(&mvp.model, DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&world_transform->world)));
-    renderer->SetMVP(mvp);
-    render_list[renderer->_pipeline_type].push_back(renderer);
+  MTR_BEGIN("Renderer", "Sort draws");
+  _draw_sorter->Sort(_thread_pool.get(), &_draw_keys, &_draw_order);
+  MTR_END("Renderer", "Sort draws");
+
+  // Everything the GPU reads this frame is written to the ring of the
+  // frame, its fence retired before UpdatePipeline
+  GFX::UploadRing* upload_ring = _upload_rings[_current_frame].get();
+
+  uint64_t frame_address = 0U;
+  GFX::FrameConstants* frame_constants = static_cast<GFX::FrameConstants*>(
+      upload_ring->Allocate(sizeof(GFX::FrameConstants), &frame_address));
+  if (frame_constants == nullptr) {
+    _running = false;
+    return;
   }
+
+  DirectX::XMStoreFloat4x4(&frame_constants->view,
+                           DirectX::XMMatrixTranspose(view));
+  DirectX::XMStoreFloat4x4(&frame_constants->projection,
+                           DirectX::XMMatrixTranspose(projection));
+  DirectX::XMStoreFloat4x4(
+      &frame_constants->view_projection,
+      DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&view_projection)));
+  DirectX::XMStoreFloat3(&frame_constants->camera_position, camera_position);
+  frame_constants->pad0 = 0.0f;
+
+  // Instance i is the world matrix of the i-th sorted packet, so a run of
+  // packets starts at its own position in the buffer
+  uint64_t instances_address = 0U;
+  DirectX::XMFLOAT4X4* instances = nullptr;
+  if (!_draw_order.empty()) {
+    instances = static_cast<DirectX::XMFLOAT4X4*>(upload_ring->Allocate(
+        sizeof(DirectX::XMFLOAT4X4) * _draw_order.size(), &instances_address));
+    if (instances == nullptr) {
+      _running = false;
+      return;
+    }
+  }
+
+  for (size_t i = 0; i < _draw_order.size(); i++) {
+    instances[i] = *_draw_packets[_draw_order[i]].world;
+  }
+
+  uint32_t drawn = _visible_renderers.size();
   MTR_END("Renderer", "Populate render list");
+  MTR_COUNTER("Renderer", "Drawn renderers", drawn);
+  MTR_COUNTER("Renderer", "Draw packets", _draw_packets.size());
+  MTR_COUNTER("Renderer", "Occluded renderers", occluded);
+  MTR_COUNTER("Renderer", "Culled renderers", culled);
 
   D3D12_RESOURCE_BARRIER rt_render_barrier = {};
   rt_render_barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
@@ -1139,65 +1947,82 @@ void RR::Renderer::UpdatePipeline() {
   _command_list->RSSetScissorRects(1, &scissor_rect);
 
   MTR_BEGIN("Renderer", "Populate command list");
-  // CHANGE PipelineTypes values to change sorting and render order
-  for (std::map<uint32_t, std::list<std::shared_ptr<RendererComponent>>>::iterator i = render_list.begin();
-       i != render_list.end(); i++) {
-    GFX::Pipeline& pipeline = _pipelines[i->first];
-    _command_list->SetPipelineState(pipeline.PipelineState());
-    _command_list->SetGraphicsRootSignature(pipeline.RootSignature());
-
-    switch (pipeline.Type()) {
-      case RR::PipelineTypes::kPipelineType_PBR: {
-        pipeline.properties.pbr_constants.elapsed_time = elapsed_time;
-
-        pipeline.properties.pbr_constants.camera_position[0] = camera_world->world._41;
-        pipeline.properties.pbr_constants.camera_position[1] = camera_world->world._42;
-        pipeline.properties.pbr_constants.camera_position[2] = camera_world->world._43;
-
-        _command_list->SetGraphicsRoot32BitConstants(2, sizeof(RR::GFX::PBRConstants) / 4, &pipeline.properties.pbr_constants, 0);
+  // Every texture and the ImGui font live in one heap, bound once
+  _command_list->SetDescriptorHeaps(1, &_srv_descriptor_heap);
+
+  if (!_draw_order.empty()) {
+    D3D12_VERTEX_BUFFER_VIEW instance_view = {};
+    instance_view.BufferLocation = instances_address;
+    instance_view.SizeInBytes =
+        sizeof(DirectX::XMFLOAT4X4) * _draw_order.size();
+    instance_view.StrideInBytes = sizeof(DirectX::XMFLOAT4X4);
+    _command_list->IASetVertexBuffers(1, 1, &instance_view);
+  }
+
+  // Packets come grouped by pipeline, then material and geometry, so
+  // state is only set when it changes and equal neighbours are instanced
+  uint32_t bound_pipeline = kPipelineType_None;
+  int32_t bound_geometry = -1;
+  uint32_t draw_calls = 0U;
+  for (size_t i = 0; i < _draw_order.size();) {
+    const DrawPacket& packet = _draw_packets[_draw_order[i]];
+    GFX::Pipeline& pipeline = _pipelines[packet.pipeline_type];
+
+    size_t run_end = i + 1;
+    while (run_end < _draw_order.size()) {
+      const DrawPacket& next = _draw_packets[_draw_order[run_end]];
+      if (next.pipeline_type != packet.pipeline_type ||
+          next.geometry != packet.geometry ||
+          next.material != packet.material) {
         break;
-      }          
+      }
+      run_end++;
     }
-    
-    for (std::list<std::shared_ptr<RendererComponent>>::iterator j = i->second.begin(); j != i->second.end(); j++) {
-      for (size_t k = 0; k < j->get()->geometries.size(); k++) {
-        int32_t geometry = j->get()->geometries[k];
-        if (geometry < 0 || geometry > _geometries.size()) {
-          LOG_WARNING("RR", "Renderer has invalid geometry");
-          continue;
-        }
-
-        if (pipeline.GeometryType() != _geometries[geometry].Type()) {
-          LOG_WARNING("RR", "Traying to draw geometry with incompatible pipeline");
-          continue;
-        }
 
-        j->get()->Update(_device, _textures, k);
+    if (packet.pipeline_type != bound_pipeline) {
+      _command_list->SetPipelineState(pipeline.PipelineState());
+      _command_list->SetGraphicsRootSignature(pipeline.RootSignature());
+      bound_pipeline = packet.pipeline_type;
 
-        _command_list->IASetVertexBuffers(0, 1, _geometries[geometry].VertexView());
-        _command_list->IASetIndexBuffer(_geometries[geometry].IndexView());
-        _command_list->SetGraphicsRootConstantBufferView(0, j->get()->MVPConstantBufferView());
-        _command_list->SetGraphicsRootConstantBufferView(1, j->get()->MaterialConstantBufferView());
+      // Root arguments don't survive a root signature change
+      _command_list->SetGraphicsRootConstantBufferView(0, frame_address);
 
-        switch (pipeline.Type()) {
-          case RR::PipelineTypes::kPipelineType_PBR: {
-            ID3D12DescriptorHeap* descriptor_heaps[] = {
-                j->get()->SRVDescriptorHeap(k)
-            };
+      switch (pipeline.Type()) {
+        case RR::PipelineTypes::kPipelineType_PBR: {
+          pipeline.properties.pbr_constants.elapsed_time = elapsed_time;
 
-            _command_list->SetDescriptorHeaps(1, descriptor_heaps);
-            _command_list->SetGraphicsRootDescriptorTable(3, descriptor_heaps[0]->GetGPUDescriptorHandleForHeapStart());
-            break;
-          }
+          _command_list->SetGraphicsRoot32BitConstants(2, sizeof(RR::GFX::PBRConstants) / 4, &pipeline.properties.pbr_constants, 0);
+          // The whole heap, materials index it
+          _command_list->SetGraphicsRootDescriptorTable(
+              3, _srv_descriptor_heap->GetGPUDescriptorHandleForHeapStart());
+          break;
         }
+      }
+    }
+
+    // Only writes when the frame copy of the constants is stale
+    _material_registry->Update(packet.material, _current_frame);
 
-        _command_list->DrawIndexedInstanced(_geometries[geometry].Indices(), 1, 0, 0, 0);
-      } 
+    if (packet.geometry != bound_geometry) {
+      _command_list->IASetVertexBuffers(0, 1, _geometries[packet.geometry].VertexView());
+      _command_list->IASetIndexBuffer(_geometries[packet.geometry].IndexView());
+      bound_geometry = packet.geometry;
     }
+
+    _command_list->SetGraphicsRootConstantBufferView(
+        1, _material_registry->ConstantBufferView(packet.material,
+                                                  _current_frame));
+
+    _command_list->DrawIndexedInstanced(_geometries[packet.geometry].Indices(),
+                                        run_end - i, 0, 0, i);
+    draw_calls++;
+    i = run_end;
   }
+  MTR_COUNTER("Renderer", "Draw calls", draw_calls);
+  MTR_COUNTER("Renderer", "Materials", _material_registry->material_count());
+  MTR_COUNTER("Renderer", "Upload ring bytes", upload_ring->used());
   MTR_END("Renderer", "Populate command list");
 
-  _command_list->SetDescriptorHeaps(1, &_imgui_descriptor_heap);
   ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), _command_list);
 
   D3D12_RESOURCE_BARRIER rt_present_barrier = {};
@@ -1230,10 +2055,18 @@ void RR::Renderer::Render() {
 void RR::Renderer::Cleanup() {
   WaitForAllFrames();
 
+  for (uint16_t i = 0; i < kSwapchainBufferCount; i++) {
+    ReleaseDestroyedResources(i);
+  }
+
   ImGui_ImplDX12_Shutdown();
   ImGui_ImplWin32_Shutdown();
   ImGui::DestroyContext();
 
+  if (_thread_pool != nullptr) {
+    _thread_pool->Release();
+  }
+
   mtr_flush();
   mtr_shutdown();
 
@@ -1257,11 +2090,13 @@ void RR::Renderer::Cleanup() {
     _rt_descriptor_heap = nullptr;
   }
 
-  if (_imgui_descriptor_heap != nullptr) {
-    _imgui_descriptor_heap->Release();
-    _imgui_descriptor_heap = nullptr;
+  if (_srv_descriptor_heap != nullptr) {
+    _srv_descriptor_heap->Release();
+    _srv_descriptor_heap = nullptr;
   }
 
+  _descriptor_allocator = nullptr;
+
   if (_command_list != nullptr) {
     _command_list->Release();
     _command_list = nullptr;
@@ -1285,7 +2120,17 @@ void RR::Renderer::Cleanup() {
     _geometries[i].Release();
   }
 
+  if (_material_registry != nullptr) {
+    _material_registry->Release();
+    _material_registry = nullptr;
+  }
+
   for (uint16_t i = 0; i < kSwapchainBufferCount; ++i) {
+    if (_upload_rings[i] != nullptr) {
+      _upload_rings[i]->Release();
+      _upload_rings[i] = nullptr;
+    }
+
     if (_command_allocators[i] != nullptr) {
       _command_allocators[i]->Release();
       _command_allocators[i] = nullptr;
@@ -0,0 +1,103 @@
+#include "renderer/thread_pool.h"
+
+#include "Minitrace/minitrace.h"
+
+RR::ThreadPool::~ThreadPool() { Release(); }
+
+void RR::ThreadPool::Init(uint32_t thread_count) {
+  Release();
+
+  if (thread_count == kDefaultThreadCount) {
+    uint32_t hardware_threads = std::thread::hardware_concurrency();
+    thread_count = hardware_threads > 1 ? hardware_threads - 1 : 0;
+  }
+
+  _quit = false;
+  _threads.reserve(thread_count);
+  for (uint32_t i = 0; i < thread_count; i++) {
+    _threads.emplace_back(&ThreadPool::WorkerLoop, this);
+  }
+}
+
+void RR::ThreadPool::Release() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _quit = true;
+  }
+  _wake.notify_all();
+
+  for (size_t i = 0; i < _threads.size(); i++) {
+    _threads[i].join();
+  }
+  _threads.clear();
+}
+
+void RR::ThreadPool::ParallelFor(
+    uint32_t count, uint32_t chunk_size,
+    const std::function<void(uint32_t, uint32_t)>& task) {
+  if (count == 0) {
+    return;
+  }
+
+  if (chunk_size == 0) {
+    chunk_size = 1;
+  }
+
+  uint32_t chunk_count = (count + chunk_size - 1) / chunk_size;
+  if (_threads.empty() || chunk_count == 1) {
+    task(0, count);
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  _task = &task;
+  _count = count;
+  _chunk_size = chunk_size;
+  _chunk_count = chunk_count;
+  _next_chunk = 0;
+  _pending_chunks = chunk_count;
+  uint64_t generation = ++_generation;
+  _wake.notify_all();
+
+  RunChunks(lock, generation);
+  _done.wait(lock, [this]() { return _pending_chunks == 0; });
+  _task = nullptr;
+}
+
+uint32_t RR::ThreadPool::thread_count() const { return _threads.size(); }
+
+void RR::ThreadPool::WorkerLoop() {
+  MTR_META_THREAD_NAME("Worker Thread");
+  uint64_t seen = 0;
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (true) {
+    _wake.wait(lock, [this, seen]() { return _quit || _generation != seen; });
+    if (_quit) {
+      return;
+    }
+
+    seen = _generation;
+    RunChunks(lock, seen);
+  }
+}
+
+void RR::ThreadPool::RunChunks(std::unique_lock<std::mutex>& lock,
+                               uint64_t generation) {
+  // Chunks are claimed under the lock, a late worker can only pick up
+  // chunks of the job it was woken for
+  while (_generation == generation && _next_chunk < _chunk_count) {
+    uint32_t chunk = _next_chunk++;
+    const std::function<void(uint32_t, uint32_t)>* task = _task;
+    uint32_t begin = chunk * _chunk_size;
+    uint32_t end = begin + _chunk_size < _count ? begin + _chunk_size : _count;
+
+    lock.unlock();
+    (*task)(begin, end);
+    lock.lock();
+
+    if (--_pending_chunks == 0) {
+      _done.notify_all();
+    }
+  }
+}
@@ -0,0 +1,474 @@
+#include "renderer/transform_hierarchy.h"
+
+#include <string.h>
+#include <atomic>
+
+#include "renderer/thread_pool.h"
+#include "renderer/transform_kernel.h"
+
+const uint32_t RR::TransformHierarchy::kNoNode;
+
+void RR::TransformHierarchy::Reserve(uint32_t count, uint32_t depth) {
+  if (depth >= _levels.size()) {
+    _levels.resize(depth + 1);
+  }
+
+  Level& level = _levels[depth];
+  size_t size = level.entities.size() + count;
+  level.entities.reserve(size);
+  level.parents.reserve(size);
+  level.first_children.reserve(size);
+  level.next_siblings.reserve(size);
+  level.previous_siblings.reserve(size);
+  level.positions.x.reserve(size);
+  level.positions.y.reserve(size);
+  level.positions.z.reserve(size);
+  level.rotations.x.reserve(size);
+  level.rotations.y.reserve(size);
+  level.rotations.z.reserve(size);
+  level.rotations.w.reserve(size);
+  level.scales.x.reserve(size);
+  level.scales.y.reserve(size);
+  level.scales.z.reserve(size);
+  level.worlds.reserve(size);
+  level.dirty.reserve(size);
+}
+
+void RR::TransformHierarchy::Insert(Entity entity, Entity parent) {
+  if (Contains(entity)) {
+    return;
+  }
+
+  Push(entity, parent, {0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f, 1.0f},
+       {1.0f, 1.0f, 1.0f});
+}
+
+void RR::TransformHierarchy::Remove(Entity entity,
+                                    std::vector<Entity>* orphans) {
+  const Slot* slot = Find(entity);
+  if (slot == nullptr) {
+    return;
+  }
+
+  std::vector<Entity> children;
+  Children(entity, &children);
+
+  for (size_t i = 0; i < children.size(); i++) {
+    SetParent(children[i], kInvalidEntity);
+    if (orphans != nullptr) {
+      orphans->push_back(children[i]);
+    }
+  }
+
+  slot = Find(entity);
+  Erase(slot->level, slot->index);
+}
+
+bool RR::TransformHierarchy::SetParent(Entity entity, Entity parent) {
+  const Slot* slot = Find(entity);
+  if (slot == nullptr) {
+    return false;
+  }
+
+  if (parent != kInvalidEntity) {
+    if (parent == entity || !Contains(parent) || IsDescendant(parent, entity)) {
+      return false;
+    }
+  }
+
+  if (Parent(entity) == parent) {
+    return true;
+  }
+
+  struct Node {
+    Entity entity;
+    Entity parent;
+    DirectX::XMFLOAT3 position;
+    DirectX::XMFLOAT4 rotation;
+    DirectX::XMFLOAT3 scale;
+  };
+
+  // Collect the subtree breadth first, parents before children
+  std::vector<Node> subtree;
+  Level& root_level = _levels[slot->level];
+  subtree.push_back({entity, parent, root_level.positions.Get(slot->index),
+                     root_level.rotations.Get(slot->index),
+                     root_level.scales.Get(slot->index)});
+
+  for (size_t n = 0; n < subtree.size(); n++) {
+    const Slot* node = Find(subtree[n].entity);
+    uint32_t child = _levels[node->level].first_children[node->index];
+    if (child == kNoNode) {
+      continue;
+    }
+
+    Level& next = _levels[node->level + 1];
+    for (; child != kNoNode; child = next.next_siblings[child]) {
+      subtree.push_back({next.entities[child], subtree[n].entity,
+                         next.positions.Get(child), next.rotations.Get(child),
+                         next.scales.Get(child)});
+    }
+  }
+
+  // Children first so no erased node still has children stored
+  for (size_t n = subtree.size(); n-- > 0;) {
+    const Slot* node = Find(subtree[n].entity);
+    Erase(node->level, node->index);
+  }
+
+  for (size_t n = 0; n < subtree.size(); n++) {
+    Push(subtree[n].entity, subtree[n].parent, subtree[n].position,
+         subtree[n].rotation, subtree[n].scale);
+  }
+
+  return true;
+}
+
+bool RR::TransformHierarchy::IsDescendant(Entity entity,
+                                          Entity ancestor) const {
+  const Slot* slot = Find(entity);
+  if (slot == nullptr) {
+    return false;
+  }
+
+  uint32_t level = slot->level;
+  uint32_t index = slot->index;
+  while (level != 0) {
+    index = _levels[level].parents[index];
+    level--;
+
+    if (_levels[level].entities[index] == ancestor) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool RR::TransformHierarchy::Contains(Entity entity) const {
+  return Find(entity) != nullptr;
+}
+
+RR::Entity RR::TransformHierarchy::Parent(Entity entity) const {
+  const Slot* slot = Find(entity);
+  if (slot == nullptr || slot->level == 0) {
+    return kInvalidEntity;
+  }
+
+  const Level& level = _levels[slot->level];
+  return _levels[slot->level - 1].entities[level.parents[slot->index]];
+}
+
+void RR::TransformHierarchy::Children(Entity entity,
+                                      std::vector<Entity>* children) const {
+  const Slot* slot = Find(entity);
+  if (slot == nullptr) {
+    return;
+  }
+
+  uint32_t child = _levels[slot->level].first_children[slot->index];
+  if (child == kNoNode) {
+    return;
+  }
+
+  const Level& next = _levels[slot->level + 1];
+  for (; child != kNoNode; child = next.next_siblings[child]) {
+    children->push_back(next.entities[child]);
+  }
+}
+
+uint32_t RR::TransformHierarchy::Depth(Entity entity) const {
+  const Slot* slot = Find(entity);
+  return slot != nullptr ? slot->level : 0U;
+}
+
+void RR::TransformHierarchy::SetLocal(Entity entity,
+                                      const DirectX::XMFLOAT3& position,
+                                      const DirectX::XMFLOAT4& rotation,
+                                      const DirectX::XMFLOAT3& scale) {
+  const Slot* slot = Find(entity);
+  if (slot == nullptr) {
+    return;
+  }
+
+  Level& level = _levels[slot->level];
+  level.positions.Set(slot->index, position);
+  level.rotations.Set(slot->index, rotation);
+  level.scales.Set(slot->index, scale);
+  level.dirty[slot->index] = 1;
+}
+
+uint32_t RR::TransformHierarchy::Update(ThreadPool* thread_pool) {
+  std::atomic<uint32_t> rebuilt(0U);
+
+  for (size_t l = 0; l < _levels.size(); l++) {
+    Level& level = _levels[l];
+    const Level* parent_level = l != 0 ? &_levels[l - 1] : nullptr;
+
+    TransformStreams streams;
+    streams.position_x = level.positions.x.data();
+    streams.position_y = level.positions.y.data();
+    streams.position_z = level.positions.z.data();
+    streams.rotation_x = level.rotations.x.data();
+    streams.rotation_y = level.rotations.y.data();
+    streams.rotation_z = level.rotations.z.data();
+    streams.rotation_w = level.rotations.w.data();
+    streams.scale_x = level.scales.x.data();
+    streams.scale_y = level.scales.y.data();
+    streams.scale_z = level.scales.z.data();
+    streams.dirty = level.dirty.data();
+    streams.parents = parent_level != nullptr ? level.parents.data() : nullptr;
+    streams.parent_worlds =
+        parent_level != nullptr ? parent_level->worlds.data() : nullptr;
+    streams.worlds = level.worlds.data();
+
+    // Nodes of one level only read the previous one, each chunk is
+    // independent and ParallelFor returning is the barrier between levels
+    std::function<void(uint32_t, uint32_t)> task =
+        [&level, parent_level, &streams, &rebuilt](uint32_t begin,
+                                                   uint32_t end) {
+          // Parents were already visited, a rebuilt parent dirties its
+          // children
+          uint32_t dirty = 0;
+          for (uint32_t i = begin; i < end; i++) {
+            if (parent_level != nullptr &&
+                parent_level->dirty[level.parents[i]]) {
+              level.dirty[i] = 1;
+            }
+
+            dirty += level.dirty[i];
+          }
+
+          if (dirty != 0) {
+            ComputeWorldMatrices(streams, begin, end);
+            rebuilt += dirty;
+          }
+        };
+
+    uint32_t count = level.entities.size();
+    if (thread_pool != nullptr) {
+      thread_pool->ParallelFor(count, kUpdateChunkSize, task);
+    } else {
+      task(0, count);
+    }
+  }
+
+  return rebuilt;
+}
+
+void RR::TransformHierarchy::ClearDirty() {
+  for (size_t l = 0; l < _levels.size(); l++) {
+    if (!_levels[l].dirty.empty()) {
+      memset(_levels[l].dirty.data(), 0, _levels[l].dirty.size());
+    }
+  }
+}
+
+DirectX::XMFLOAT3 RR::TransformHierarchy::Float3Stream::Get(
+    size_t index) const {
+  return {x[index], y[index], z[index]};
+}
+
+void RR::TransformHierarchy::Float3Stream::Set(
+    size_t index, const DirectX::XMFLOAT3& value) {
+  x[index] = value.x;
+  y[index] = value.y;
+  z[index] = value.z;
+}
+
+void RR::TransformHierarchy::Float3Stream::Push(
+    const DirectX::XMFLOAT3& value) {
+  x.push_back(value.x);
+  y.push_back(value.y);
+  z.push_back(value.z);
+}
+
+void RR::TransformHierarchy::Float3Stream::Pop() {
+  x.pop_back();
+  y.pop_back();
+  z.pop_back();
+}
+
+DirectX::XMFLOAT4 RR::TransformHierarchy::Float4Stream::Get(
+    size_t index) const {
+  return {x[index], y[index], z[index], w[index]};
+}
+
+void RR::TransformHierarchy::Float4Stream::Set(
+    size_t index, const DirectX::XMFLOAT4& value) {
+  x[index] = value.x;
+  y[index] = value.y;
+  z[index] = value.z;
+  w[index] = value.w;
+}
+
+void RR::TransformHierarchy::Float4Stream::Push(
+    const DirectX::XMFLOAT4& value) {
+  x.push_back(value.x);
+  y.push_back(value.y);
+  z.push_back(value.z);
+  w.push_back(value.w);
+}
+
+void RR::TransformHierarchy::Float4Stream::Pop() {
+  x.pop_back();
+  y.pop_back();
+  z.pop_back();
+  w.pop_back();
+}
+
+uint32_t RR::TransformHierarchy::size() const { return _size; }
+
+std::vector<RR::TransformHierarchy::Level>& RR::TransformHierarchy::levels() {
+  return _levels;
+}
+
+const RR::TransformHierarchy::Slot* RR::TransformHierarchy::Find(
+    Entity entity) const {
+  uint32_t index = EntityIndex(entity);
+  if (entity == kInvalidEntity || index >= _slots.size()) {
+    return nullptr;
+  }
+
+  const Slot* slot = &_slots[index];
+  if (slot->level == kNoLevel ||
+      _levels[slot->level].entities[slot->index] != entity) {
+    return nullptr;
+  }
+
+  return slot;
+}
+
+void RR::TransformHierarchy::Push(Entity entity, Entity parent,
+                                  const DirectX::XMFLOAT3& position,
+                                  const DirectX::XMFLOAT4& rotation,
+                                  const DirectX::XMFLOAT3& scale) {
+  uint32_t depth = 0;
+  uint32_t parent_index = 0;
+
+  const Slot* parent_slot = Find(parent);
+  if (parent_slot != nullptr) {
+    depth = parent_slot->level + 1;
+    parent_index = parent_slot->index;
+  }
+
+  if (depth >= _levels.size()) {
+    _levels.resize(depth + 1);
+  }
+
+  DirectX::XMFLOAT4X4 identity;
+  DirectX::XMStoreFloat4x4(&identity, DirectX::XMMatrixIdentity());
+
+  Level& level = _levels[depth];
+  uint32_t index = level.entities.size();
+
+  // Linked at the front of the child list of the parent
+  uint32_t next_sibling = kNoNode;
+  if (depth != 0) {
+    uint32_t& first_child = _levels[depth - 1].first_children[parent_index];
+    next_sibling = first_child;
+    if (next_sibling != kNoNode) {
+      level.previous_siblings[next_sibling] = index;
+    }
+    first_child = index;
+  }
+
+  level.entities.push_back(entity);
+  level.parents.push_back(parent_index);
+  level.first_children.push_back(kNoNode);
+  level.next_siblings.push_back(next_sibling);
+  level.previous_siblings.push_back(kNoNode);
+  level.positions.Push(position);
+  level.rotations.Push(rotation);
+  level.scales.Push(scale);
+  level.worlds.push_back(identity);
+  level.dirty.push_back(1);
+
+  uint32_t slot = EntityIndex(entity);
+  if (slot >= _slots.size()) {
+    _slots.resize(slot + 1, {kNoLevel, 0U});
+  }
+
+  _slots[slot].level = depth;
+  _slots[slot].index = index;
+  _size++;
+}
+
+void RR::TransformHierarchy::Link(uint32_t depth, uint32_t index) {
+  Level& level = _levels[depth];
+
+  if (depth != 0) {
+    uint32_t previous = level.previous_siblings[index];
+    if (previous != kNoNode) {
+      level.next_siblings[previous] = index;
+    } else {
+      _levels[depth - 1].first_children[level.parents[index]] = index;
+    }
+
+    uint32_t next = level.next_siblings[index];
+    if (next != kNoNode) {
+      level.previous_siblings[next] = index;
+    }
+  }
+
+  uint32_t child = level.first_children[index];
+  if (child != kNoNode) {
+    Level& children = _levels[depth + 1];
+    for (; child != kNoNode; child = children.next_siblings[child]) {
+      children.parents[child] = index;
+    }
+  }
+}
+
+void RR::TransformHierarchy::Erase(uint32_t depth, uint32_t index) {
+  Level& level = _levels[depth];
+
+  // Unlinked from its siblings, the node has no children left
+  if (depth != 0) {
+    uint32_t previous = level.previous_siblings[index];
+    uint32_t next = level.next_siblings[index];
+    if (previous != kNoNode) {
+      level.next_siblings[previous] = next;
+    } else {
+      _levels[depth - 1].first_children[level.parents[index]] = next;
+    }
+
+    if (next != kNoNode) {
+      level.previous_siblings[next] = previous;
+    }
+  }
+
+  _slots[EntityIndex(level.entities[index])].level = kNoLevel;
+
+  uint32_t last = level.entities.size() - 1;
+  if (index != last) {
+    level.entities[index] = level.entities[last];
+    level.parents[index] = level.parents[last];
+    level.first_children[index] = level.first_children[last];
+    level.next_siblings[index] = level.next_siblings[last];
+    level.previous_siblings[index] = level.previous_siblings[last];
+    level.positions.Set(index, level.positions.Get(last));
+    level.rotations.Set(index, level.rotations.Get(last));
+    level.scales.Set(index, level.scales.Get(last));
+    level.worlds[index] = level.worlds[last];
+    level.dirty[index] = level.dirty[last];
+
+    _slots[EntityIndex(level.entities[index])].index = index;
+
+    // Parent, siblings and children of the moved node still point at
+    // its old row
+    Link(depth, index);
+  }
+
+  level.entities.pop_back();
+  level.parents.pop_back();
+  level.first_children.pop_back();
+  level.next_siblings.pop_back();
+  level.previous_siblings.pop_back();
+  level.positions.Pop();
+  level.rotations.Pop();
+  level.scales.Pop();
+  level.worlds.pop_back();
+  level.dirty.pop_back();
+  _size--;
+}
@@ -0,0 +1,358 @@
+#include "renderer/transform_kernel.h"
+
+#if !defined(_XM_NO_INTRINSICS_) && \
+    (defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__))
+#define RR_TRANSFORM_SSE 1
+#include <immintrin.h>
+#endif
+
+// MSVC exposes avx intrinsics without /arch:AVX2, support is checked at
+// runtime. Other compilers only get the path when building for avx2
+#if defined(RR_TRANSFORM_SSE) && (defined(_MSC_VER) || defined(__AVX2__))
+#define RR_TRANSFORM_AVX2 1
+#endif
+
+#if defined(RR_TRANSFORM_AVX2) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static void ComputeLocal(const RR::TransformStreams& s, uint32_t i,
+                         float local[4][3]) {
+  float x = s.rotation_x[i];
+  float y = s.rotation_y[i];
+  float z = s.rotation_z[i];
+  float w = s.rotation_w[i];
+
+  // Rows of XMMatrixRotationQuaternion, each one multiplied by its scale
+  float x2 = x + x;
+  float y2 = y + y;
+  float z2 = z + z;
+  float xx = x * x2;
+  float yy = y * y2;
+  float zz = z * z2;
+  float xy = x * y2;
+  float xz = x * z2;
+  float yz = y * z2;
+  float wx = w * x2;
+  float wy = w * y2;
+  float wz = w * z2;
+
+  local[0][0] = s.scale_x[i] * (1.0f - yy - zz);
+  local[0][1] = s.scale_x[i] * (xy + wz);
+  local[0][2] = s.scale_x[i] * (xz - wy);
+  local[1][0] = s.scale_y[i] * (xy - wz);
+  local[1][1] = s.scale_y[i] * (1.0f - xx - zz);
+  local[1][2] = s.scale_y[i] * (yz + wx);
+  local[2][0] = s.scale_z[i] * (xz + wy);
+  local[2][1] = s.scale_z[i] * (yz - wx);
+  local[2][2] = s.scale_z[i] * (1.0f - xx - yy);
+  local[3][0] = s.position_x[i];
+  local[3][1] = s.position_y[i];
+  local[3][2] = s.position_z[i];
+}
+
+void RR::ComputeWorldMatricesScalar(const TransformStreams& s, uint32_t begin,
+                                    uint32_t end) {
+  for (uint32_t i = begin; i < end; i++) {
+    if (!s.dirty[i]) {
+      continue;
+    }
+
+    float local[4][3];
+    ComputeLocal(s, i, local);
+
+    float (*world)[4] = s.worlds[i].m;
+    if (s.parents == nullptr) {
+      for (uint32_t r = 0; r < 4; r++) {
+        world[r][0] = local[r][0];
+        world[r][1] = local[r][1];
+        world[r][2] = local[r][2];
+      }
+    } else {
+      // Transforms are affine, the last column of the parent is 0 0 0 1
+      const float (*parent)[4] = s.parent_worlds[s.parents[i]].m;
+      for (uint32_t r = 0; r < 4; r++) {
+        float w = r == 3 ? 1.0f : 0.0f;
+        for (uint32_t c = 0; c < 3; c++) {
+          world[r][c] = local[r][0] * parent[0][c] +
+                        local[r][1] * parent[1][c] +
+                        local[r][2] * parent[2][c] + w * parent[3][c];
+        }
+      }
+    }
+
+    world[0][3] = 0.0f;
+    world[1][3] = 0.0f;
+    world[2][3] = 0.0f;
+    world[3][3] = 1.0f;
+  }
+}
+
+#ifdef RR_TRANSFORM_SSE
+namespace {
+struct Vec4 {
+  typedef __m128 Type;
+  static const uint32_t kWidth = 4;
+  __m128 v;
+
+  static Vec4 Load(const float* p) { return {_mm_loadu_ps(p)}; }
+  static Vec4 Set(float f) { return {_mm_set1_ps(f)}; }
+};
+
+inline Vec4 operator+(Vec4 a, Vec4 b) { return {_mm_add_ps(a.v, b.v)}; }
+inline Vec4 operator-(Vec4 a, Vec4 b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline Vec4 operator*(Vec4 a, Vec4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+
+#ifdef RR_TRANSFORM_AVX2
+struct Vec8 {
+  typedef __m256 Type;
+  static const uint32_t kWidth = 8;
+  __m256 v;
+
+  static Vec8 Load(const float* p) { return {_mm256_loadu_ps(p)}; }
+  static Vec8 Set(float f) { return {_mm256_set1_ps(f)}; }
+};
+
+inline Vec8 operator+(Vec8 a, Vec8 b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline Vec8 operator-(Vec8 a, Vec8 b) { return {_mm256_sub_ps(a.v, b.v)}; }
+inline Vec8 operator*(Vec8 a, Vec8 b) { return {_mm256_mul_ps(a.v, b.v)}; }
+#endif
+}
+
+// Transposes the 3x4 affine part of four parents into one vector per cell
+static void GatherParents(const RR::TransformStreams& s, uint32_t i,
+                          __m128 parent[4][3]) {
+  const float (*m0)[4] = s.parent_worlds[s.parents[i + 0]].m;
+  const float (*m1)[4] = s.parent_worlds[s.parents[i + 1]].m;
+  const float (*m2)[4] = s.parent_worlds[s.parents[i + 2]].m;
+  const float (*m3)[4] = s.parent_worlds[s.parents[i + 3]].m;
+
+  for (uint32_t r = 0; r < 4; r++) {
+    __m128 a = _mm_loadu_ps(m0[r]);
+    __m128 b = _mm_loadu_ps(m1[r]);
+    __m128 c = _mm_loadu_ps(m2[r]);
+    __m128 d = _mm_loadu_ps(m3[r]);
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+    parent[r][0] = a;
+    parent[r][1] = b;
+    parent[r][2] = c;
+  }
+}
+
+// Transposes four matrices back and writes the dirty ones
+static void StoreWorlds(const RR::TransformStreams& s, uint32_t i,
+                        const __m128 world[4][3]) {
+  __m128 rows[4][4];
+  for (uint32_t r = 0; r < 4; r++) {
+    __m128 a = world[r][0];
+    __m128 b = world[r][1];
+    __m128 c = world[r][2];
+    __m128 d = r == 3 ? _mm_set1_ps(1.0f) : _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+    rows[0][r] = a;
+    rows[1][r] = b;
+    rows[2][r] = c;
+    rows[3][r] = d;
+  }
+
+  for (uint32_t j = 0; j < 4; j++) {
+    if (!s.dirty[i + j]) {
+      continue;
+    }
+
+    float (*m)[4] = s.worlds[i + j].m;
+    _mm_storeu_ps(m[0], rows[j][0]);
+    _mm_storeu_ps(m[1], rows[j][1]);
+    _mm_storeu_ps(m[2], rows[j][2]);
+    _mm_storeu_ps(m[3], rows[j][3]);
+  }
+}
+
+static void GatherParents(const RR::TransformStreams& s, uint32_t i,
+                          Vec4 parent[4][3]) {
+  __m128 p[4][3];
+  GatherParents(s, i, p);
+  for (uint32_t r = 0; r < 4; r++) {
+    for (uint32_t c = 0; c < 3; c++) {
+      parent[r][c].v = p[r][c];
+    }
+  }
+}
+
+static void StoreWorlds(const RR::TransformStreams& s, uint32_t i,
+                        const Vec4 world[4][3]) {
+  __m128 w[4][3];
+  for (uint32_t r = 0; r < 4; r++) {
+    for (uint32_t c = 0; c < 3; c++) {
+      w[r][c] = world[r][c].v;
+    }
+  }
+  StoreWorlds(s, i, w);
+}
+
+#ifdef RR_TRANSFORM_AVX2
+static void GatherParents(const RR::TransformStreams& s, uint32_t i,
+                          Vec8 parent[4][3]) {
+  __m128 low[4][3];
+  __m128 high[4][3];
+  GatherParents(s, i, low);
+  GatherParents(s, i + 4, high);
+  for (uint32_t r = 0; r < 4; r++) {
+    for (uint32_t c = 0; c < 3; c++) {
+      parent[r][c].v = _mm256_insertf128_ps(
+          _mm256_castps128_ps256(low[r][c]), high[r][c], 1);
+    }
+  }
+}
+
+static void StoreWorlds(const RR::TransformStreams& s, uint32_t i,
+                        const Vec8 world[4][3]) {
+  __m128 low[4][3];
+  __m128 high[4][3];
+  for (uint32_t r = 0; r < 4; r++) {
+    for (uint32_t c = 0; c < 3; c++) {
+      low[r][c] = _mm256_castps256_ps128(world[r][c].v);
+      high[r][c] = _mm256_extractf128_ps(world[r][c].v, 1);
+    }
+  }
+  StoreWorlds(s, i, low);
+  StoreWorlds(s, i + 4, high);
+}
+#endif
+
+// Same math as ComputeWorldMatricesScalar with every float holding one
+// transform per lane
+template <typename V>
+static void ComputeBatch(const RR::TransformStreams& s, uint32_t i) {
+  V x = V::Load(s.rotation_x + i);
+  V y = V::Load(s.rotation_y + i);
+  V z = V::Load(s.rotation_z + i);
+  V w = V::Load(s.rotation_w + i);
+  V scale_x = V::Load(s.scale_x + i);
+  V scale_y = V::Load(s.scale_y + i);
+  V scale_z = V::Load(s.scale_z + i);
+  V one = V::Set(1.0f);
+
+  V x2 = x + x;
+  V y2 = y + y;
+  V z2 = z + z;
+  V xx = x * x2;
+  V yy = y * y2;
+  V zz = z * z2;
+  V xy = x * y2;
+  V xz = x * z2;
+  V yz = y * z2;
+  V wx = w * x2;
+  V wy = w * y2;
+  V wz = w * z2;
+
+  V local[4][3];
+  local[0][0] = scale_x * (one - yy - zz);
+  local[0][1] = scale_x * (xy + wz);
+  local[0][2] = scale_x * (xz - wy);
+  local[1][0] = scale_y * (xy - wz);
+  local[1][1] = scale_y * (one - xx - zz);
+  local[1][2] = scale_y * (yz + wx);
+  local[2][0] = scale_z * (xz + wy);
+  local[2][1] = scale_z * (yz - wx);
+  local[2][2] = scale_z * (one - xx - yy);
+  local[3][0] = V::Load(s.position_x + i);
+  local[3][1] = V::Load(s.position_y + i);
+  local[3][2] = V::Load(s.position_z + i);
+
+  if (s.parents == nullptr) {
+    StoreWorlds(s, i, local);
+    return;
+  }
+
+  V parent[4][3];
+  GatherParents(s, i, parent);
+
+  V world[4][3];
+  for (uint32_t r = 0; r < 4; r++) {
+    for (uint32_t c = 0; c < 3; c++) {
+      world[r][c] = local[r][0] * parent[0][c] + local[r][1] * parent[1][c] +
+                    local[r][2] * parent[2][c];
+    }
+  }
+
+  world[3][0] = world[3][0] + parent[3][0];
+  world[3][1] = world[3][1] + parent[3][1];
+  world[3][2] = world[3][2] + parent[3][2];
+  StoreWorlds(s, i, world);
+}
+
+template <typename V>
+static void ComputeBatches(const RR::TransformStreams& s, uint32_t begin,
+                           uint32_t end) {
+  uint32_t i = begin;
+  for (; i + V::kWidth <= end; i += V::kWidth) {
+    uint32_t dirty = 0;
+    for (uint32_t j = 0; j < V::kWidth; j++) {
+      dirty |= s.dirty[i + j];
+    }
+
+    if (dirty != 0) {
+      ComputeBatch<V>(s, i);
+    }
+  }
+
+  RR::ComputeWorldMatricesScalar(s, i, end);
+}
+#endif
+
+#ifdef RR_TRANSFORM_AVX2
+static bool CpuHasAVX2() {
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+
+  // The os has to save the ymm registers too
+  __cpuid(info, 1);
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  bool avx = (info[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+    return false;
+  }
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return true;
+#endif
+}
+#endif
+
+uint32_t RR::TransformKernelWidth() {
+#if defined(RR_TRANSFORM_AVX2)
+  static const uint32_t width = CpuHasAVX2() ? 8U : 4U;
+  return width;
+#elif defined(RR_TRANSFORM_SSE)
+  return 4U;
+#else
+  return 1U;
+#endif
+}
+
+void RR::ComputeWorldMatrices(const TransformStreams& streams, uint32_t begin,
+                              uint32_t end) {
+  switch (TransformKernelWidth()) {
+#ifdef RR_TRANSFORM_AVX2
+    case 8:
+      ComputeBatches<Vec8>(streams, begin, end);
+      _mm256_zeroupper();
+      break;
+#endif
+#ifdef RR_TRANSFORM_SSE
+    case 4:
+      ComputeBatches<Vec4>(streams, begin, end);
+      break;
+#endif
+    default:
+      ComputeWorldMatricesScalar(streams, begin, end);
+      break;
+  }
+}
@@ -0,0 +1,307 @@
+#include "renderer/world.h"
+
+#include <functional>
+
+#include "renderer/logger.h"
+#include "renderer/thread_pool.h"
+#include "renderer/common.hpp"
+#include "renderer/components/entity_component.h"
+
+RR::Entity RR::World::CreateEntity(uint32_t component_types,
+                                   Entity parent) {
+  if (component_types == kComponentType_None) {
+    return kInvalidEntity;
+  }
+
+  uint32_t index = 0;
+  if (!_free_records.empty()) {
+    index = _free_records.back();
+    _free_records.pop_back();
+  } else if (_records.size() < kMaxEntities) {
+    index = _records.size();
+    _records.push_back({kNoArchetype, 0U, 0U});
+  } else {
+    return kInvalidEntity;
+  }
+
+  EntityRecord& record = _records[index];
+  Entity entity = MakeEntity(index, record.generation);
+
+  record.archetype = FindOrCreateArchetype(component_types);
+  record.row = _archetypes[record.archetype].Add(entity);
+  _entity_count++;
+
+  if (component_types & kComponentType_LocalTransform) {
+    if (!_hierarchy.Contains(parent)) {
+      parent = kInvalidEntity;
+    }
+
+    _hierarchy.Insert(entity, parent);
+    _archetypes[record.archetype].local_transforms[record.row].parent = parent;
+  }
+
+  return entity;
+}
+
+void RR::World::CreateEntities(uint32_t count, uint32_t component_types,
+                               std::vector<Entity>* entities,
+                               const Entity* parents) {
+  if (component_types == kComponentType_None || count == 0) {
+    return;
+  }
+
+  Archetype& archetype = _archetypes[FindOrCreateArchetype(component_types)];
+  archetype.Reserve(archetype.size() + count);
+
+  if (count > _free_records.size()) {
+    _records.reserve(_records.size() + count - _free_records.size());
+  }
+
+  // Batches usually share the depth of their first parent
+  if (component_types & kComponentType_LocalTransform) {
+    uint32_t depth = 0;
+    if (parents != nullptr && _hierarchy.Contains(parents[0])) {
+      depth = _hierarchy.Depth(parents[0]) + 1;
+    }
+    _hierarchy.Reserve(count, depth);
+  }
+
+  entities->reserve(entities->size() + count);
+  for (uint32_t i = 0; i < count; i++) {
+    Entity entity = CreateEntity(
+        component_types, parents != nullptr ? parents[i] : kInvalidEntity);
+    if (entity == kInvalidEntity) {
+      LOG_WARNING("RR", "Entity limit reached, created %u of %u", i, count);
+      return;
+    }
+
+    entities->push_back(entity);
+  }
+}
+
+void RR::World::DestroyEntity(Entity entity) {
+  if (!IsValid(entity)) {
+    return;
+  }
+
+  if (Components(entity) & kComponentType_LocalTransform) {
+    // Children are kept alive as roots
+    std::vector<Entity> orphans;
+    _hierarchy.Remove(entity, &orphans);
+
+    for (size_t i = 0; i < orphans.size(); i++) {
+      LocalTransform* transform = GetComponent<LocalTransform>(orphans[i]);
+      transform->parent = kInvalidEntity;
+    }
+  }
+
+  EntityRecord& record = _records[EntityIndex(entity)];
+
+  Entity moved = _archetypes[record.archetype].Remove(record.row);
+  if (moved != kInvalidEntity) {
+    _records[EntityIndex(moved)].row = record.row;
+  }
+
+  // Bumping the generation invalidates every handle still pointing here
+  record.archetype = kNoArchetype;
+  record.row = 0U;
+  record.generation = (record.generation + 1) % kPendingEntityGeneration;
+
+  _free_records.push_back(EntityIndex(entity));
+  _entity_count--;
+}
+
+void RR::World::AddComponents(Entity entity, uint32_t component_types) {
+  if (!IsValid(entity)) {
+    return;
+  }
+
+  EntityRecord& record = _records[EntityIndex(entity)];
+  uint32_t old_components = _archetypes[record.archetype].components();
+  uint32_t new_components = old_components | component_types;
+
+  if (new_components == old_components) {
+    return;
+  }
+
+  uint32_t destination = FindOrCreateArchetype(new_components);
+  Archetype& source = _archetypes[record.archetype];
+
+  uint32_t new_row = source.CopyTo(record.row, &_archetypes[destination]);
+  Entity moved = source.Remove(record.row);
+  if (moved != kInvalidEntity) {
+    _records[EntityIndex(moved)].row = record.row;
+  }
+
+  record.archetype = destination;
+  record.row = new_row;
+
+  if ((component_types & ~old_components) & kComponentType_LocalTransform) {
+    _hierarchy.Insert(entity);
+  }
+
+  // A fresh world transform has to be built even if the local one
+  // didn't change
+  if ((component_types & ~old_components) & kComponentType_WorldTransform) {
+    LocalTransform* transform = GetComponent<LocalTransform>(entity);
+
+    if (transform != nullptr) {
+      transform->_dirty = true;
+    }
+  }
+}
+
+void RR::World::SetParent(Entity entity, Entity parent) {
+  LocalTransform* transform = GetComponent<LocalTransform>(entity);
+
+  if (transform == nullptr) {
+    return;
+  }
+
+  if (parent != kInvalidEntity &&
+      GetComponent<LocalTransform>(parent) == nullptr) {
+    return;
+  }
+
+  if (!_hierarchy.SetParent(entity, parent)) {
+    LOG_WARNING("RR", "Invalid parent, entity can't be its own ancestor");
+    return;
+  }
+
+  transform->parent = parent;
+}
+
+uint32_t RR::World::UpdateTransforms(ThreadPool* thread_pool) {
+  // Local transforms touched since last frame
+  const std::vector<uint32_t>& transformed = Query(LocalTransform::kType);
+  for (size_t i = 0; i < transformed.size(); i++) {
+    Archetype& archetype = _archetypes[transformed[i]];
+
+    std::vector<LocalTransform>& transforms =
+        archetype.Column<LocalTransform>();
+    for (size_t row = 0; row < transforms.size(); row++) {
+      if (!transforms[row]._dirty) {
+        continue;
+      }
+
+      _hierarchy.SetLocal(archetype.entities[row], transforms[row]._position,
+                          transforms[row]._quaternion, transforms[row]._scale);
+      transforms[row]._dirty = false;
+    }
+  }
+
+  uint32_t rebuilt = _hierarchy.Update(thread_pool);
+
+  if (rebuilt != 0) {
+    std::vector<TransformHierarchy::Level>& levels = _hierarchy.levels();
+    for (size_t l = 0; l < levels.size(); l++) {
+      const TransformHierarchy::Level& level = levels[l];
+
+      // Every node owns a different WorldTransform, chunks never overlap
+      std::function<void(uint32_t, uint32_t)> task = [this, &level](
+                                                         uint32_t begin,
+                                                         uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+          if (!level.dirty[i]) {
+            continue;
+          }
+
+          WorldTransform* world =
+              GetComponent<WorldTransform>(level.entities[i]);
+
+          if (world != nullptr) {
+            world->world = level.worlds[i];
+            world->_version++;
+          }
+        }
+      };
+
+      uint32_t count = level.entities.size();
+      if (thread_pool != nullptr) {
+        thread_pool->ParallelFor(count, kScatterChunkSize, task);
+      } else {
+        task(0, count);
+      }
+    }
+  }
+
+  _hierarchy.ClearDirty();
+
+  return rebuilt;
+}
+
+RR::EntityComponent* RR::World::GetComponent(Entity entity,
+                                             uint32_t component_type) {
+  if (!IsValid(entity)) {
+    return nullptr;
+  }
+
+  const EntityRecord& record = _records[EntityIndex(entity)];
+  return _archetypes[record.archetype].Component(component_type, record.row);
+}
+
+uint32_t RR::World::Components(Entity entity) const {
+  if (!IsValid(entity)) {
+    return kComponentType_None;
+  }
+
+  return _archetypes[_records[EntityIndex(entity)].archetype].components();
+}
+
+bool RR::World::IsValid(Entity entity) const {
+  uint32_t index = EntityIndex(entity);
+  if (entity == kInvalidEntity || index >= _records.size()) {
+    return false;
+  }
+
+  return _records[index].archetype != kNoArchetype &&
+         _records[index].generation == EntityGeneration(entity);
+}
+
+uint32_t RR::World::EntityCount() const { return _entity_count; }
+
+const std::vector<uint32_t>& RR::World::Query(uint32_t component_types) {
+  std::map<uint32_t, std::vector<uint32_t>>::iterator i =
+      _queries.find(component_types);
+
+  if (i != _queries.end()) {
+    return i->second;
+  }
+
+  std::vector<uint32_t>& matches = _queries[component_types];
+  for (size_t a = 0; a < _archetypes.size(); a++) {
+    if ((_archetypes[a].components() & component_types) == component_types) {
+      matches.push_back(a);
+    }
+  }
+
+  return matches;
+}
+
+std::vector<RR::Archetype>& RR::World::archetypes() { return _archetypes; }
+
+const RR::TransformHierarchy& RR::World::hierarchy() const {
+  return _hierarchy;
+}
+
+uint32_t RR::World::FindOrCreateArchetype(uint32_t component_types) {
+  std::map<uint32_t, uint32_t>::iterator i =
+      _archetype_indices.find(component_types);
+
+  if (i != _archetype_indices.end()) {
+    return i->second;
+  }
+
+  uint32_t index = _archetypes.size();
+  _archetypes.emplace_back(component_types);
+  _archetype_indices[component_types] = index;
+
+  std::map<uint32_t, std::vector<uint32_t>>::iterator query;
+  for (query = _queries.begin(); query != _queries.end(); query++) {
+    if ((component_types & query->first) == query->first) {
+      query->second.push_back(index);
+    }
+  }
+
+  return index;
+}
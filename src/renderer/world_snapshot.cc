@@ -0,0 +1,352 @@
+#include "renderer/world_snapshot.h"
+
+#include <stdio.h>
+#include <Windows.h>
+
+#include "renderer/logger.h"
+
+// Sections and blobs are 16 byte aligned so records can be read in place
+// and vertex data with aligned loads
+static uint64_t AlignBlob(uint64_t offset) { return (offset + 15) & ~15ULL; }
+
+static bool WritePadding(FILE* file, uint64_t* offset, uint64_t target) {
+  static const uint8_t kZeros[16] = {0};
+
+  if (target == *offset) {
+    return true;
+  }
+
+  size_t size = (size_t)(target - *offset);
+  *offset = target;
+  return fwrite(kZeros, 1, size, file) == size;
+}
+
+static bool WriteBlob(FILE* file, uint64_t* offset, const void* data,
+                      size_t size) {
+  *offset += size;
+  return size == 0 || fwrite(data, 1, size, file) == size;
+}
+
+// Size and last write time of filename, false when it can't be read
+static bool ReadSourceStamp(const char* filename, uint64_t* size,
+                            uint64_t* time) {
+  WIN32_FILE_ATTRIBUTE_DATA attributes = {};
+  if (!GetFileAttributesExA(filename, GetFileExInfoStandard, &attributes)) {
+    return false;
+  }
+
+  *size = (uint64_t)attributes.nFileSizeHigh << 32 |
+          attributes.nFileSizeLow;
+  *time = (uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32 |
+          attributes.ftLastWriteTime.dwLowDateTime;
+  return true;
+}
+
+RR::WorldSnapshot::~WorldSnapshot() { Unmap(); }
+
+int RR::WorldSnapshot::Write(
+    const char* filename, const std::vector<EntityRecord>& entities,
+    const std::vector<SlotRecord>& slots,
+    const std::vector<uint32_t>& geometry_types,
+    const std::vector<const GeometryData*>& geometry_data,
+    const std::vector<std::wstring>& textures, const char* source_filename) {
+  if (geometry_types.size() != geometry_data.size()) {
+    LOG_ERROR("RR", "Snapshot geometry types and data don't match");
+    return 1;
+  }
+
+  uint64_t source_size = 0;
+  uint64_t source_time = 0;
+  if (source_filename != nullptr &&
+      !ReadSourceStamp(source_filename, &source_size, &source_time)) {
+    LOG_ERROR("RR", "Couldn't read snapshot source: %s", source_filename);
+    return 1;
+  }
+
+  Header header = {};
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.entity_count = entities.size();
+  header.slot_count = slots.size();
+  header.geometry_count = geometry_data.size();
+  header.texture_count = textures.size();
+  header.source_size = source_size;
+  header.source_time = source_time;
+
+  // Records first, then the blobs they point to
+  uint64_t offset = sizeof(Header);
+  header.entities = AlignBlob(offset);
+  offset = header.entities + sizeof(EntityRecord) * entities.size();
+  header.slots = AlignBlob(offset);
+  offset = header.slots + sizeof(SlotRecord) * slots.size();
+  header.geometries = AlignBlob(offset);
+  offset = header.geometries + sizeof(GeometryRecord) * geometry_data.size();
+  header.textures = AlignBlob(offset);
+  offset = header.textures + sizeof(TextureRecord) * textures.size();
+
+  std::vector<GeometryRecord> geometry_records(geometry_data.size());
+  for (size_t i = 0; i < geometry_data.size(); i++) {
+    const GeometryData* data = geometry_data[i];
+    GeometryRecord& record = geometry_records[i];
+
+    record.type = geometry_types[i];
+    record.vertex_count = data->vertex_data.size();
+    record.index_count = data->index_data.size();
+
+    offset = AlignBlob(offset);
+    record.vertices.offset = offset;
+    offset += sizeof(float) * data->vertex_data.size();
+
+    offset = AlignBlob(offset);
+    record.indices.offset = offset;
+    offset += sizeof(uint32_t) * data->index_data.size();
+  }
+
+  std::vector<TextureRecord> texture_records(textures.size());
+  for (size_t i = 0; i < textures.size(); i++) {
+    offset = AlignBlob(offset);
+    texture_records[i].name.offset = offset;
+    offset += sizeof(wchar_t) * (textures[i].size() + 1);
+  }
+
+  header.file_size = offset;
+
+  FILE* file = fopen(filename, "wb");
+  if (!file) {
+    LOG_ERROR("RR", "Couldn't open file: %s", filename);
+    return 1;
+  }
+
+  offset = 0;
+  bool written =
+      WriteBlob(file, &offset, &header, sizeof(Header)) &&
+      WritePadding(file, &offset, header.entities) &&
+      WriteBlob(file, &offset, entities.data(),
+                sizeof(EntityRecord) * entities.size()) &&
+      WritePadding(file, &offset, header.slots) &&
+      WriteBlob(file, &offset, slots.data(),
+                sizeof(SlotRecord) * slots.size()) &&
+      WritePadding(file, &offset, header.geometries) &&
+      WriteBlob(file, &offset, geometry_records.data(),
+                sizeof(GeometryRecord) * geometry_records.size()) &&
+      WritePadding(file, &offset, header.textures) &&
+      WriteBlob(file, &offset, texture_records.data(),
+                sizeof(TextureRecord) * texture_records.size());
+
+  for (size_t i = 0; written && i < geometry_data.size(); i++) {
+    const GeometryData* data = geometry_data[i];
+
+    written =
+        WritePadding(file, &offset, geometry_records[i].vertices.offset) &&
+        WriteBlob(file, &offset, data->vertex_data.data(),
+                  sizeof(float) * data->vertex_data.size()) &&
+        WritePadding(file, &offset, geometry_records[i].indices.offset) &&
+        WriteBlob(file, &offset, data->index_data.data(),
+                  sizeof(uint32_t) * data->index_data.size());
+  }
+
+  for (size_t i = 0; written && i < textures.size(); i++) {
+    written = WritePadding(file, &offset, texture_records[i].name.offset) &&
+              WriteBlob(file, &offset, textures[i].c_str(),
+                        sizeof(wchar_t) * (textures[i].size() + 1));
+  }
+
+  fclose(file);
+
+  if (!written) {
+    LOG_ERROR("RR", "Couldn't write snapshot: %s", filename);
+    return 1;
+  }
+
+  return 0;
+}
+
+int RR::WorldSnapshot::Map(const char* filename,
+                           const char* source_filename) {
+  Unmap();
+
+  _file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                      OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (_file == INVALID_HANDLE_VALUE) {
+    _file = nullptr;
+    return 1;
+  }
+
+  LARGE_INTEGER file_size = {};
+  if (!GetFileSizeEx(_file, &file_size) ||
+      file_size.QuadPart < (LONGLONG)sizeof(Header)) {
+    LOG_WARNING("RR", "Invalid snapshot: %s", filename);
+    Unmap();
+    return 1;
+  }
+
+  // Copy on write so pointers can be patched without touching the file
+  _mapping = CreateFileMappingA(_file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+  if (_mapping != nullptr) {
+    _view = (uint8_t*)MapViewOfFile(_mapping, FILE_MAP_COPY, 0, 0, 0);
+  }
+
+  if (_view == nullptr) {
+    LOG_ERROR("RR", "Couldn't map snapshot: %s", filename);
+    Unmap();
+    return 1;
+  }
+
+  const Header* snapshot = header();
+  if (snapshot->magic != kMagic || snapshot->version != kVersion ||
+      snapshot->file_size != (uint64_t)file_size.QuadPart ||
+      !Validate(snapshot->file_size)) {
+    LOG_WARNING("RR", "Outdated or invalid snapshot: %s", filename);
+    Unmap();
+    return 1;
+  }
+
+  uint64_t source_size = 0;
+  uint64_t source_time = 0;
+  if (source_filename != nullptr &&
+      ReadSourceStamp(source_filename, &source_size, &source_time) &&
+      (snapshot->source_size != source_size ||
+       snapshot->source_time != source_time)) {
+    LOG_WARNING("RR", "Snapshot %s doesn't match its source %s", filename,
+                source_filename);
+    Unmap();
+    return 1;
+  }
+
+  GeometryRecord* geometries = (GeometryRecord*)(_view + snapshot->geometries);
+  for (uint32_t i = 0; i < snapshot->geometry_count; i++) {
+    geometries[i].vertices.data =
+        (const float*)(_view + geometries[i].vertices.offset);
+    geometries[i].indices.data =
+        (const uint32_t*)(_view + geometries[i].indices.offset);
+  }
+
+  TextureRecord* textures = (TextureRecord*)(_view + snapshot->textures);
+  for (uint32_t i = 0; i < snapshot->texture_count; i++) {
+    textures[i].name.data = (const wchar_t*)(_view + textures[i].name.offset);
+  }
+
+  return 0;
+}
+
+static bool InsideFile(uint64_t offset, uint64_t count, uint64_t size,
+                       uint64_t file_size) {
+  return offset <= file_size && count <= (file_size - offset) / size;
+}
+
+static bool ValidTexture(int32_t texture, uint32_t texture_count) {
+  return texture == -1 || (texture >= 0 && (uint32_t)texture < texture_count);
+}
+
+bool RR::WorldSnapshot::Validate(uint64_t file_size) const {
+  const Header* snapshot = header();
+
+  if (!InsideFile(snapshot->entities, snapshot->entity_count,
+                  sizeof(EntityRecord), file_size) ||
+      !InsideFile(snapshot->slots, snapshot->slot_count, sizeof(SlotRecord),
+                  file_size) ||
+      !InsideFile(snapshot->geometries, snapshot->geometry_count,
+                  sizeof(GeometryRecord), file_size) ||
+      !InsideFile(snapshot->textures, snapshot->texture_count,
+                  sizeof(TextureRecord), file_size)) {
+    return false;
+  }
+
+  // Parents are stored before their children
+  const EntityRecord* entity_records = entities();
+  for (uint32_t i = 0; i < snapshot->entity_count; i++) {
+    const EntityRecord& record = entity_records[i];
+    if (record.parent >= (int32_t)i || record.parent < -1 ||
+        record.first_slot > snapshot->slot_count ||
+        record.slot_count > snapshot->slot_count - record.first_slot) {
+      return false;
+    }
+  }
+
+  const SlotRecord* slot_records = slots();
+  for (uint32_t i = 0; i < snapshot->slot_count; i++) {
+    const SlotRecord& slot = slot_records[i];
+    const PBRTextures& textures = slot.textures.pbr_textures;
+    if (slot.geometry < -1 ||
+        (slot.geometry >= 0 &&
+         (uint32_t)slot.geometry >= snapshot->geometry_count) ||
+        !ValidTexture(textures.base_color, snapshot->texture_count) ||
+        !ValidTexture(textures.normal, snapshot->texture_count) ||
+        !ValidTexture(textures.metallic, snapshot->texture_count) ||
+        !ValidTexture(textures.roughness, snapshot->texture_count) ||
+        !ValidTexture(textures.reflectance, snapshot->texture_count)) {
+      return false;
+    }
+  }
+
+  const GeometryRecord* geometry_records = geometries();
+  for (uint32_t i = 0; i < snapshot->geometry_count; i++) {
+    const GeometryRecord& record = geometry_records[i];
+    if (!InsideFile(record.vertices.offset, record.vertex_count,
+                    sizeof(float), file_size) ||
+        !InsideFile(record.indices.offset, record.index_count,
+                    sizeof(uint32_t), file_size)) {
+      return false;
+    }
+  }
+
+  // Names must end inside the file
+  const TextureRecord* texture_records = textures();
+  for (uint32_t i = 0; i < snapshot->texture_count; i++) {
+    uint64_t offset = texture_records[i].name.offset;
+    if (!InsideFile(offset, 1, sizeof(wchar_t), file_size)) {
+      return false;
+    }
+
+    const wchar_t* name = (const wchar_t*)(_view + offset);
+    uint64_t length = (file_size - offset) / sizeof(wchar_t);
+    uint64_t k = 0;
+    while (k < length && name[k] != L'\0') {
+      k++;
+    }
+
+    if (k == length) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void RR::WorldSnapshot::Unmap() {
+  if (_view != nullptr) {
+    UnmapViewOfFile(_view);
+    _view = nullptr;
+  }
+
+  if (_mapping != nullptr) {
+    CloseHandle(_mapping);
+    _mapping = nullptr;
+  }
+
+  if (_file != nullptr) {
+    CloseHandle(_file);
+    _file = nullptr;
+  }
+}
+
+const RR::WorldSnapshot::Header* RR::WorldSnapshot::header() const {
+  return (const Header*)_view;
+}
+
+const RR::WorldSnapshot::EntityRecord* RR::WorldSnapshot::entities() const {
+  return (const EntityRecord*)(_view + header()->entities);
+}
+
+const RR::WorldSnapshot::SlotRecord* RR::WorldSnapshot::slots() const {
+  return (const SlotRecord*)(_view + header()->slots);
+}
+
+const RR::WorldSnapshot::GeometryRecord* RR::WorldSnapshot::geometries()
+    const {
+  return (const GeometryRecord*)(_view + header()->geometries);
+}
+
+const RR::WorldSnapshot::TextureRecord* RR::WorldSnapshot::textures() const {
+  return (const TextureRecord*)(_view + header()->textures);
+}
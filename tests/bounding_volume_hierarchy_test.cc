@@ -0,0 +1,301 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "test.h"
+#include "renderer/bounding_volume_hierarchy.h"
+#include "renderer/frustum_culling.h"
+
+static const uint32_t kSlots = 256;
+static const uint32_t kSteps = 4096;
+static const uint32_t kQueries = 64;
+
+// What the tree should hold, one optional box per entity index
+struct Model {
+  std::vector<RR::Entity> entities;
+  std::vector<RR::Bounds> bounds;
+  std::vector<bool> alive;
+  uint32_t count = 0;
+
+  Model() : entities(kSlots), bounds(kSlots), alive(kSlots, false) {
+    for (uint32_t i = 0; i < kSlots; i++) {
+      entities[i] = RR::MakeEntity(i, 0);
+    }
+  }
+};
+
+static RR::Bounds MakeBox(const DirectX::XMFLOAT3& center,
+                          const DirectX::XMFLOAT3& extent) {
+  RR::Bounds bounds;
+  bounds.min = {center.x - extent.x, center.y - extent.y,
+                center.z - extent.z};
+  bounds.max = {center.x + extent.x, center.y + extent.y,
+                center.z + extent.z};
+  bounds.center = center;
+  bounds.radius = std::sqrt(extent.x * extent.x + extent.y * extent.y +
+                            extent.z * extent.z);
+  return bounds;
+}
+
+static RR::Bounds RandomBox(std::mt19937* random) {
+  std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+  std::uniform_real_distribution<float> size(0.1f, 5.0f);
+  return MakeBox({position(*random), position(*random), position(*random)},
+                 {size(*random), size(*random), size(*random)});
+}
+
+// Inserts, moves and removes random entities, moves are either small
+// enough to stay inside the leaf margin or jumps across the scene. Some
+// indices come back with a new generation while the old one is still in
+// the tree, like a destroyed entity the index never heard about
+static int RandomStep(std::mt19937* random, Model* model,
+                      RR::BoundingVolumeHierarchy* tree) {
+  std::uniform_int_distribution<uint32_t> slot_distribution(0, kSlots - 1);
+  std::uniform_int_distribution<uint32_t> action_distribution(0, 9);
+  std::uniform_real_distribution<float> nudge(-0.05f, 0.05f);
+
+  uint32_t slot = slot_distribution(*random);
+  uint32_t action = action_distribution(*random);
+
+  if (!model->alive[slot] || action == 0) {
+    if (model->alive[slot]) {
+      uint32_t generation = RR::EntityGeneration(model->entities[slot]) + 1;
+      model->entities[slot] = RR::MakeEntity(slot, generation);
+      model->count--;
+    }
+
+    model->bounds[slot] = RandomBox(random);
+    model->alive[slot] = true;
+    model->count++;
+    CHECK(tree->Update(model->entities[slot], model->bounds[slot]));
+  } else if (action < 4) {
+    tree->Remove(model->entities[slot]);
+    model->alive[slot] = false;
+    model->count--;
+  } else if (action < 6) {
+    RR::Bounds empty = RR::EmptyBounds();
+    CHECK(tree->Update(model->entities[slot], empty));
+    model->alive[slot] = false;
+    model->count--;
+  } else if (action < 8) {
+    model->bounds[slot] = RandomBox(random);
+    tree->Update(model->entities[slot], model->bounds[slot]);
+  } else {
+    const RR::Bounds& old_bounds = model->bounds[slot];
+    DirectX::XMFLOAT3 extent = {
+        (old_bounds.max.x - old_bounds.min.x) * 0.5f,
+        (old_bounds.max.y - old_bounds.min.y) * 0.5f,
+        (old_bounds.max.z - old_bounds.min.z) * 0.5f};
+    DirectX::XMFLOAT3 center = {old_bounds.center.x + nudge(*random),
+                                old_bounds.center.y + nudge(*random),
+                                old_bounds.center.z + nudge(*random)};
+    model->bounds[slot] = MakeBox(center, extent);
+    tree->Update(model->entities[slot], model->bounds[slot]);
+  }
+
+  return 0;
+}
+
+static void Sort(std::vector<RR::Entity>* entities) {
+  std::sort(entities->begin(), entities->end());
+}
+
+// Brute force versions of the tree queries, same tests on every box
+
+static bool FrustumTouches(const RR::Frustum& frustum,
+                           const RR::Bounds& bounds) {
+  float center[3] = {(bounds.min.x + bounds.max.x) * 0.5f,
+                     (bounds.min.y + bounds.max.y) * 0.5f,
+                     (bounds.min.z + bounds.max.z) * 0.5f};
+  float extent[3] = {(bounds.max.x - bounds.min.x) * 0.5f,
+                     (bounds.max.y - bounds.min.y) * 0.5f,
+                     (bounds.max.z - bounds.min.z) * 0.5f};
+
+  for (uint32_t p = 0; p < 6; p++) {
+    const DirectX::XMFLOAT4& plane = frustum.planes[p];
+    float distance = plane.x * center[0] + plane.y * center[1] +
+                     plane.z * center[2] + plane.w;
+    float radius = std::fabs(plane.x) * extent[0] +
+                   std::fabs(plane.y) * extent[1] +
+                   std::fabs(plane.z) * extent[2];
+    if (distance + radius < 0.0f) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool RayHits(const DirectX::XMFLOAT3& origin,
+                    const DirectX::XMFLOAT3& direction, float max_distance,
+                    const RR::Bounds& bounds) {
+  const float origin_axis[3] = {origin.x, origin.y, origin.z};
+  const float direction_axis[3] = {direction.x, direction.y, direction.z};
+  const float min_axis[3] = {bounds.min.x, bounds.min.y, bounds.min.z};
+  const float max_axis[3] = {bounds.max.x, bounds.max.y, bounds.max.z};
+  float near_t = 0.0f;
+  float far_t = max_distance;
+
+  for (uint32_t a = 0; a < 3; a++) {
+    if (direction_axis[a] == 0.0f) {
+      if (origin_axis[a] < min_axis[a] || origin_axis[a] > max_axis[a]) {
+        return false;
+      }
+      continue;
+    }
+
+    float inverse = 1.0f / direction_axis[a];
+    float t0 = (min_axis[a] - origin_axis[a]) * inverse;
+    float t1 = (max_axis[a] - origin_axis[a]) * inverse;
+    near_t = std::max(near_t, std::min(t0, t1));
+    far_t = std::min(far_t, std::max(t0, t1));
+    if (near_t > far_t) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool SphereOverlaps(const DirectX::XMFLOAT3& center, float radius,
+                           const RR::Bounds& bounds) {
+  float x = std::min(std::max(center.x, bounds.min.x), bounds.max.x) -
+            center.x;
+  float y = std::min(std::max(center.y, bounds.min.y), bounds.max.y) -
+            center.y;
+  float z = std::min(std::max(center.z, bounds.min.z), bounds.max.z) -
+            center.z;
+  return x * x + y * y + z * z <= radius * radius;
+}
+
+int RR::Test::BoundingVolumeHierarchyInvariants() {
+  std::mt19937 random(16);
+  Model model;
+  BoundingVolumeHierarchy tree;
+  CHECK(tree.Validate());
+  CHECK(tree.height() == 0);
+
+  for (uint32_t step = 0; step < kSteps; step++) {
+    if (RandomStep(&random, &model, &tree) != 0) {
+      return 1;
+    }
+
+    CHECK(tree.Validate());
+    CHECK(tree.size() == model.count);
+  }
+
+  for (uint32_t i = 0; i < kSlots; i++) {
+    CHECK(tree.Contains(model.entities[i]) == model.alive[i]);
+    // Older generations of the index are gone
+    if (RR::EntityGeneration(model.entities[i]) > 0) {
+      uint32_t generation = RR::EntityGeneration(model.entities[i]) - 1;
+      CHECK(!tree.Contains(RR::MakeEntity(i, generation)));
+    }
+  }
+
+  // Rotations keep the height within a small factor of log2(n)
+  CHECK(model.count > 0);
+  CHECK(tree.height() <= 2 * std::log2(static_cast<float>(model.count)) + 1);
+
+  for (uint32_t i = 0; i < kSlots; i++) {
+    tree.Remove(model.entities[i]);
+  }
+  CHECK(tree.Validate());
+  CHECK(tree.size() == 0);
+  CHECK(tree.height() == 0);
+  return 0;
+}
+
+int RR::Test::BoundingVolumeHierarchyQueries() {
+  std::mt19937 random(32);
+  std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+  std::uniform_real_distribution<float> angle(-DirectX::XM_PI, DirectX::XM_PI);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  std::uniform_real_distribution<float> radius(1.0f, 40.0f);
+  std::uniform_int_distribution<uint32_t> flat_axis(0, 5);
+
+  Model model;
+  BoundingVolumeHierarchy tree;
+  std::vector<Entity> result;
+  std::vector<Entity> expected;
+
+  for (uint32_t step = 0; step < kSteps; step++) {
+    if (RandomStep(&random, &model, &tree) != 0) {
+      return 1;
+    }
+
+    if (step % (kSteps / kQueries) != 0) {
+      continue;
+    }
+
+    // Camera somewhere in the scene looking along a random heading
+    DirectX::XMMATRIX view = DirectX::XMMatrixMultiply(
+        DirectX::XMMatrixTranslation(-position(random), -position(random),
+                                     -position(random)),
+        DirectX::XMMatrixRotationY(angle(random)));
+    DirectX::XMMATRIX projection = DirectX::XMMatrixPerspectiveFovLH(
+        DirectX::XM_PIDIV4, 16.0f / 9.0f, 0.1f, 150.0f);
+    DirectX::XMFLOAT4X4 view_projection;
+    DirectX::XMStoreFloat4x4(&view_projection,
+                             DirectX::XMMatrixMultiply(view, projection));
+    Frustum frustum = ExtractFrustum(view_projection);
+
+    result.clear();
+    expected.clear();
+    tree.QueryFrustum(frustum, &result);
+    for (uint32_t i = 0; i < kSlots; i++) {
+      if (model.alive[i] && FrustumTouches(frustum, model.bounds[i])) {
+        expected.push_back(model.entities[i]);
+      }
+    }
+    Sort(&result);
+    Sort(&expected);
+    CHECK(result == expected);
+
+    // Some rays run parallel to an axis to cover the zero direction case
+    DirectX::XMFLOAT3 origin = {position(random), position(random),
+                                position(random)};
+    DirectX::XMFLOAT3 direction = {unit(random), unit(random), unit(random)};
+    uint32_t axis = flat_axis(random);
+    if (axis == 0) {
+      direction.x = 0.0f;
+    } else if (axis == 1) {
+      direction.y = 0.0f;
+      direction.z = 0.0f;
+    }
+    float max_distance = radius(random) * 4.0f;
+
+    result.clear();
+    expected.clear();
+    tree.QueryRay(origin, direction, max_distance, &result);
+    for (uint32_t i = 0; i < kSlots; i++) {
+      if (model.alive[i] &&
+          RayHits(origin, direction, max_distance, model.bounds[i])) {
+        expected.push_back(model.entities[i]);
+      }
+    }
+    Sort(&result);
+    Sort(&expected);
+    CHECK(result == expected);
+
+    DirectX::XMFLOAT3 center = {position(random), position(random),
+                                position(random)};
+    float sphere_radius = radius(random);
+
+    result.clear();
+    expected.clear();
+    tree.QuerySphere(center, sphere_radius, &result);
+    for (uint32_t i = 0; i < kSlots; i++) {
+      if (model.alive[i] &&
+          SphereOverlaps(center, sphere_radius, model.bounds[i])) {
+        expected.push_back(model.entities[i]);
+      }
+    }
+    Sort(&result);
+    Sort(&expected);
+    CHECK(result == expected);
+  }
+
+  return 0;
+}
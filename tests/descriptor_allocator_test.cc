@@ -0,0 +1,107 @@
+#include "test.h"
+#include "renderer/descriptor_allocator.h"
+
+static const uint32_t kCapacity = 16;
+
+int RR::Test::DescriptorAllocatorAllocateFree() {
+  DescriptorAllocator allocator;
+  allocator.Init(kCapacity);
+  CHECK(allocator.capacity() == kCapacity);
+  CHECK(allocator.allocated() == 0);
+
+  uint32_t a = allocator.Allocate();
+  uint32_t b = allocator.Allocate(4);
+  CHECK(a == 0);
+  CHECK(b == 1);
+  CHECK(allocator.allocated() == 5);
+
+  // The freed range is the first big enough again
+  allocator.Free(b, 4);
+  CHECK(allocator.allocated() == 1);
+  CHECK(allocator.Allocate(3) == 1);
+  CHECK(allocator.Allocate(2) == 4);
+
+  allocator.Free(a);
+  CHECK(allocator.allocated() == 5);
+  CHECK(allocator.Allocate() == 0);
+
+  CHECK(allocator.Allocate(0) == DescriptorAllocator::kInvalidDescriptor);
+  return 0;
+}
+
+int RR::Test::DescriptorAllocatorCoalesce() {
+  DescriptorAllocator allocator;
+  allocator.Init(kCapacity);
+
+  uint32_t a = allocator.Allocate(4);
+  uint32_t b = allocator.Allocate(4);
+  uint32_t c = allocator.Allocate(4);
+  uint32_t d = allocator.Allocate(4);
+  CHECK(d == 12);
+
+  // b frees between two free neighbours, the three become one range
+  allocator.Free(a, 4);
+  allocator.Free(c, 4);
+  CHECK(allocator.Allocate(12) == DescriptorAllocator::kInvalidDescriptor);
+  allocator.Free(b, 4);
+  CHECK(allocator.allocated() == 4);
+  CHECK(allocator.Allocate(12) == 0);
+
+  // And with the tail of the heap
+  allocator.Free(0, 12);
+  allocator.Free(d, 4);
+  CHECK(allocator.allocated() == 0);
+  CHECK(allocator.Allocate(kCapacity) == 0);
+  return 0;
+}
+
+int RR::Test::DescriptorAllocatorDoubleFree() {
+  DescriptorAllocator allocator;
+  allocator.Init(kCapacity);
+
+  uint32_t a = allocator.Allocate(4);
+  uint32_t b = allocator.Allocate(4);
+  allocator.Free(a, 4);
+  CHECK(allocator.allocated() == 4);
+
+  // Every overlap with a free range is ignored
+  allocator.Free(a, 4);
+  allocator.Free(a + 2, 4);
+  allocator.Free(b + 2, 4);
+  allocator.Free(b + 4);
+  CHECK(allocator.allocated() == 4);
+
+  // Out of the heap or invalid
+  allocator.Free(kCapacity - 1, 2);
+  allocator.Free(DescriptorAllocator::kInvalidDescriptor);
+  CHECK(allocator.allocated() == 4);
+
+  // Still consistent, b is the only allocation
+  CHECK(allocator.Allocate(4) == a);
+  CHECK(allocator.Allocate(8) == 8);
+  CHECK(allocator.allocated() == kCapacity);
+  return 0;
+}
+
+int RR::Test::DescriptorAllocatorExhaustion() {
+  DescriptorAllocator allocator;
+  allocator.Init(kCapacity);
+
+  for (uint32_t i = 0; i < kCapacity; i++) {
+    CHECK(allocator.Allocate() == i);
+  }
+  CHECK(allocator.Allocate() == DescriptorAllocator::kInvalidDescriptor);
+
+  // Free slots that aren't consecutive don't make a range
+  allocator.Free(3);
+  allocator.Free(5);
+  CHECK(allocator.Allocate(2) == DescriptorAllocator::kInvalidDescriptor);
+  CHECK(allocator.Allocate() == 3);
+  CHECK(allocator.Allocate() == 5);
+  CHECK(allocator.Allocate() == DescriptorAllocator::kInvalidDescriptor);
+
+  DescriptorAllocator empty;
+  empty.Init(0);
+  CHECK(empty.Allocate() == DescriptorAllocator::kInvalidDescriptor);
+  return 0;
+}
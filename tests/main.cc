@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "test.h"
+
+struct Test {
+  const char* name;
+  int (*run)();
+};
+
+static const Test kTests[] = {
+    {"bounding_volume_hierarchy_invariants",
+     RR::Test::BoundingVolumeHierarchyInvariants},
+    {"bounding_volume_hierarchy_queries",
+     RR::Test::BoundingVolumeHierarchyQueries},
+    {"descriptor_allocator_allocate_free",
+     RR::Test::DescriptorAllocatorAllocateFree},
+    {"descriptor_allocator_coalesce", RR::Test::DescriptorAllocatorCoalesce},
+    {"descriptor_allocator_double_free",
+     RR::Test::DescriptorAllocatorDoubleFree},
+    {"descriptor_allocator_exhaustion",
+     RR::Test::DescriptorAllocatorExhaustion},
+};
+
+static const size_t kTestCount = sizeof(kTests) / sizeof(kTests[0]);
+
+// Runs the tests whose name starts with one of the arguments, every test
+// without arguments. Returns 1 when any of them failed
+int main(int argc, char** argv) {
+  int failed = 0;
+  int run = 0;
+  for (size_t i = 0; i < kTestCount; i++) {
+    bool selected = argc < 2;
+    for (int a = 1; a < argc && !selected; a++) {
+      selected = strncmp(kTests[i].name, argv[a], strlen(argv[a])) == 0;
+    }
+
+    if (!selected) {
+      continue;
+    }
+
+    run++;
+    if (kTests[i].run() != 0) {
+      printf("FAIL %s\n", kTests[i].name);
+      failed++;
+    } else {
+      printf("ok   %s\n", kTests[i].name);
+    }
+  }
+
+  printf("%i of %i tests passed\n", run - failed, run);
+  return failed != 0 ? 1 : 0;
+}
@@ -0,0 +1,28 @@
+#ifndef __TEST_H__
+#define __TEST_H__ 1
+
+#include <stdio.h>
+
+// Prints the failed condition and makes the current test return 1, tests
+// are int functions that return 0 when every check passed
+#define CHECK(condition)                                              \
+  do {                                                                \
+    if (!(condition)) {                                               \
+      printf("  %s:%i: CHECK(%s) failed\n", __FILE__, __LINE__,       \
+             #condition);                                             \
+      return 1;                                                       \
+    }                                                                 \
+  } while (0)
+
+namespace RR {
+namespace Test {
+int BoundingVolumeHierarchyInvariants();
+int BoundingVolumeHierarchyQueries();
+int DescriptorAllocatorAllocateFree();
+int DescriptorAllocatorCoalesce();
+int DescriptorAllocatorDoubleFree();
+int DescriptorAllocatorExhaustion();
+}
+}
+
+#endif  // !__TEST_H__